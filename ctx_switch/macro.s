@@ -1,6 +1,26 @@
 /* Copyright(C) 2019 Hex Five Security, Inc. */
 /* 10-MAR-2019 Cesare Garlati                */
 
+# register width - the context slots follow xlen
+#if __riscv_xlen == 64
+#define LOAD     ld
+#define STORE    sd
+#define REGBYTES 8
+#else
+#define LOAD     lw
+#define STORE    sw
+#define REGBYTES 4
+#endif
+
+# private data working set of a thread in bytes (make WSET=<bytes>), 0 none
+#ifndef WSET
+#define WSET 0
+#endif
+# the walk steps 32 byte lines - a partial line would run it past the set
+#if WSET % 32
+#error "WSET must be a multiple of 32 bytes"
+#endif
+
 # -----------------------------------------------------------------------------
 .macro THREAD id:req, count=1024
 # -----------------------------------------------------------------------------
@@ -11,6 +31,14 @@
 
 1:		addi a1, a1, \id+1
 
+#if WSET
+		# walk the working set - a read and a write per 32 byte line
+		la t0, wset_base + \id*WSET
+		li t1, WSET/32
+2:		lw t2, 0(t0); addi t2, t2, 1; sw t2, 0(t0)
+		addi t0, t0, 32; addi t1, t1, -1; bnez t1, 2b
+#endif
+
 		.fill 512, 4, 0x00000013 # nop
 
 		j 1b
@@ -63,38 +91,38 @@
 
 		csrr x31, mscratch
 
-	    lw  x1,  0*4 (x31); csrw mepc, x1
-	    lw  x1,  1*4 (x31)
-	    lw  x2,  2*4 (x31)
-		lw  x3,  3*4 (x31)
-		lw  x4,  4*4 (x31)
-		lw  x5,  5*4 (x31)
-		lw  x6,  6*4 (x31)
-		lw  x7,  7*4 (x31)
-		lw  x8,  8*4 (x31)
-		lw  x9,  9*4 (x31)
-		lw x10, 10*4 (x31)
-		lw x11, 11*4 (x31)
-		lw x12, 12*4 (x31)
-		lw x13, 13*4 (x31)
-		lw x14, 14*4 (x31)
-		lw x15, 15*4 (x31)
-		lw x16, 16*4 (x31)
-		lw x17, 17*4 (x31)
-		lw x18, 18*4 (x31)
-		lw x19, 19*4 (x31)
-		lw x20, 20*4 (x31)
-		lw x21, 21*4 (x31)
-		lw x22, 22*4 (x31)
-		lw x23, 23*4 (x31)
-		lw x24, 24*4 (x31)
-		lw x25, 25*4 (x31)
-		lw x26, 26*4 (x31)
-		lw x27, 27*4 (x31)
-		lw x28, 28*4 (x31)
-		lw x29, 29*4 (x31)
-		lw x30, 30*4 (x31)
-		lw x31, 31*4 (x31)
+	    LOAD  x1,  0*REGBYTES (x31); csrw mepc, x1
+	    LOAD  x1,  1*REGBYTES (x31)
+	    LOAD  x2,  2*REGBYTES (x31)
+		LOAD  x3,  3*REGBYTES (x31)
+		LOAD  x4,  4*REGBYTES (x31)
+		LOAD  x5,  5*REGBYTES (x31)
+		LOAD  x6,  6*REGBYTES (x31)
+		LOAD  x7,  7*REGBYTES (x31)
+		LOAD  x8,  8*REGBYTES (x31)
+		LOAD  x9,  9*REGBYTES (x31)
+		LOAD x10, 10*REGBYTES (x31)
+		LOAD x11, 11*REGBYTES (x31)
+		LOAD x12, 12*REGBYTES (x31)
+		LOAD x13, 13*REGBYTES (x31)
+		LOAD x14, 14*REGBYTES (x31)
+		LOAD x15, 15*REGBYTES (x31)
+		LOAD x16, 16*REGBYTES (x31)
+		LOAD x17, 17*REGBYTES (x31)
+		LOAD x18, 18*REGBYTES (x31)
+		LOAD x19, 19*REGBYTES (x31)
+		LOAD x20, 20*REGBYTES (x31)
+		LOAD x21, 21*REGBYTES (x31)
+		LOAD x22, 22*REGBYTES (x31)
+		LOAD x23, 23*REGBYTES (x31)
+		LOAD x24, 24*REGBYTES (x31)
+		LOAD x25, 25*REGBYTES (x31)
+		LOAD x26, 26*REGBYTES (x31)
+		LOAD x27, 27*REGBYTES (x31)
+		LOAD x28, 28*REGBYTES (x31)
+		LOAD x29, 29*REGBYTES (x31)
+		LOAD x30, 30*REGBYTES (x31)
+		LOAD x31, 31*REGBYTES (x31)
 
 .endm
 
@@ -105,42 +133,42 @@
 
 		csrrw x31, mscratch, x31
 
-	    sw  x1,  1*4 (x31)
-	    sw  x2,  2*4 (x31)
-		sw  x3,  3*4 (x31)
-		sw  x4,  4*4 (x31)
-		sw  x5,  5*4 (x31)
-		sw  x6,  6*4 (x31)
-		sw  x7,  7*4 (x31)
-		sw  x8,  8*4 (x31)
-		sw  x9,  9*4 (x31)
-		sw x10, 10*4 (x31)
-		sw x11, 11*4 (x31)
-		sw x12, 12*4 (x31)
-		sw x13, 13*4 (x31)
-		sw x14, 14*4 (x31)
-		sw x15, 15*4 (x31)
-		sw x16, 16*4 (x31)
-		sw x17, 17*4 (x31)
-		sw x18, 18*4 (x31)
-		sw x19, 19*4 (x31)
-		sw x20, 20*4 (x31)
-		sw x21, 21*4 (x31)
-		sw x22, 22*4 (x31)
-		sw x23, 23*4 (x31)
-		sw x24, 24*4 (x31)
-		sw x25, 25*4 (x31)
-		sw x26, 26*4 (x31)
-		sw x27, 27*4 (x31)
-		sw x28, 28*4 (x31)
-		sw x29, 29*4 (x31)
-		sw x30, 30*4 (x31)
+	    STORE  x1,  1*REGBYTES (x31)
+	    STORE  x2,  2*REGBYTES (x31)
+		STORE  x3,  3*REGBYTES (x31)
+		STORE  x4,  4*REGBYTES (x31)
+		STORE  x5,  5*REGBYTES (x31)
+		STORE  x6,  6*REGBYTES (x31)
+		STORE  x7,  7*REGBYTES (x31)
+		STORE  x8,  8*REGBYTES (x31)
+		STORE  x9,  9*REGBYTES (x31)
+		STORE x10, 10*REGBYTES (x31)
+		STORE x11, 11*REGBYTES (x31)
+		STORE x12, 12*REGBYTES (x31)
+		STORE x13, 13*REGBYTES (x31)
+		STORE x14, 14*REGBYTES (x31)
+		STORE x15, 15*REGBYTES (x31)
+		STORE x16, 16*REGBYTES (x31)
+		STORE x17, 17*REGBYTES (x31)
+		STORE x18, 18*REGBYTES (x31)
+		STORE x19, 19*REGBYTES (x31)
+		STORE x20, 20*REGBYTES (x31)
+		STORE x21, 21*REGBYTES (x31)
+		STORE x22, 22*REGBYTES (x31)
+		STORE x23, 23*REGBYTES (x31)
+		STORE x24, 24*REGBYTES (x31)
+		STORE x25, 25*REGBYTES (x31)
+		STORE x26, 26*REGBYTES (x31)
+		STORE x27, 27*REGBYTES (x31)
+		STORE x28, 28*REGBYTES (x31)
+		STORE x29, 29*REGBYTES (x31)
+		STORE x30, 30*REGBYTES (x31)
 
 		csrrw x1, mscratch, x31
-		sw  x1, 31*4 (x31)
+		STORE  x1, 31*REGBYTES (x31)
 
 		csrr x1, mepc
-		sw  x1,  0*4 (x31)
+		STORE  x1,  0*REGBYTES (x31)
 
 .endm
 
@@ -0,0 +1,686 @@
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#elif defined(D_ARM)
+ #include "context-switch-latency-port-arm.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+#include "context-switch-latency-critical.h"
+#include "context-switch-latency-coro.h"
+
+/*
+ * Stackless task model - coroutines run one after the other on the stack
+ * of coro_run, a switch is a return to coro_run and a call at the resume
+ * point. The benchmark compares it with the stackful kernel: cycles per
+ * yield switch and RAM per task at 2 to 256 tasks, and the round trip of
+ * a semaphore, an event and a queue handoff between two tasks.
+ */
+
+#define D_CORO_MAX_TASKS       256
+/* 2, 4, ... D_CORO_MAX_TASKS tasks */
+#define D_CORO_NUM_OF_COUNTS   8
+#define D_CORO_NUM_OF_ROUNDS   8
+#define D_CORO_EVENT_BIT       0x1
+
+/* handoff primitive */
+#define D_CORO_HANDOFF_SEMAPHORE  0
+#define D_CORO_HANDOFF_EVENT      1
+#define D_CORO_HANDOFF_QUEUE      2
+
+/* yield switch cost and RAM per task of both models */
+typedef struct coroSweepResult
+{
+  /* number of tasks */
+  unsigned int num_of_tasks;
+  /* cpu cycles per switch - stackful tasks */
+  unsigned int stackful_cycles;
+  /* cpu cycles per switch - coroutines */
+  unsigned int stackless_cycles;
+  /* bytes per task - control block and stack */
+  unsigned int stackful_ram;
+  /* bytes per task - control block with the task state */
+  unsigned int stackless_ram;
+}coroSweepResult_t;
+
+/* round trip of a handoff between two tasks */
+typedef struct coroHandoffResult
+{
+  /* cpu cycles - stackful tasks */
+  unsigned int stackful_cycles;
+  /* cpu cycles - coroutines */
+  unsigned int stackless_cycles;
+}coroHandoffResult_t;
+
+/* benchmark coroutine - the state a stackful task keeps on its stack */
+typedef struct coroBenchTask
+{
+  coroCB_t      coro;
+  /* current round */
+  unsigned int  round;
+  /* queue item */
+  unsigned int  item;
+}coroBenchTask_t;
+
+/* tasks handlers functions */
+static void coro_stackful_yield_func(void);
+static void coro_stackful_ping_func(void);
+static void coro_stackful_pong_func(void);
+static unsigned int coro_yield_func(coroCB_t* p_coro);
+static unsigned int coro_ping_func(coroCB_t* p_coro);
+static unsigned int coro_pong_func(coroCB_t* p_coro);
+
+/* benchmark results */
+coroSweepResult_t g_coro_results[D_CORO_NUM_OF_COUNTS];
+coroHandoffResult_t g_coro_semaphore_result;
+coroHandoffResult_t g_coro_event_result;
+coroHandoffResult_t g_coro_queue_result;
+unsigned int g_coro_errors;
+#ifdef D_STACK_WATERMARK
+/* stack of a stackful yield task */
+stackUsage_t g_coro_stackful_stack_usage;
+/* bytes of the shared stack used below the caller of coro_run */
+unsigned int g_coro_shared_stack;
+/* main stack bounds - provided by the linker script */
+extern unsigned int _heap_end[];
+#endif /* D_STACK_WATERMARK */
+
+/* coroutines ready to run */
+static taskList_t g_coro_ready_list;
+
+/* stackful tasks and stacks */
+static taskCB_t g_coro_stackful_tasks[D_CORO_MAX_TASKS];
+unsigned int coro_stackful_stacks[D_CORO_MAX_TASKS][D_STACK_SIZE];
+/* coroutines */
+static coroBenchTask_t g_coro_tasks[D_CORO_MAX_TASKS];
+
+/* handoff objects - ping waits on the a objects, pong on the b objects */
+static semaphoreCB_t g_coro_sem_a, g_coro_sem_b;
+static eventCB_t g_coro_event_a, g_coro_event_b;
+static queueCB_t g_coro_queue_a, g_coro_queue_b;
+/* finished stackful tasks wait here forever */
+static semaphoreCB_t g_coro_park_sem;
+
+static unsigned int g_coro_handoff;
+static unsigned int g_coro_num_of_tasks;
+static unsigned int g_coro_done;
+static unsigned int g_coro_started;
+static volatile cycles_t g_coro_cycles_start, g_coro_cycles_end;
+
+/*
+ * Add a coroutine to the tail of a list
+ */
+static void
+coro_add_to_list(taskList_t* pList, coroCB_t* p_coro)
+{
+  /* is the list empty */
+  if (pList->node_count == 0)
+  {
+    pList->pNextTaskNode = &p_coro->node;
+  }
+  else
+  {
+    pList->pLastTaskNode->pNextTaskNode = &p_coro->node;
+  }
+  p_coro->node.pNextTaskNode = 0;
+  pList->pLastTaskNode = &p_coro->node;
+  pList->node_count++;
+}
+
+/*
+ * Make the head coroutine of a wait list ready, then the current one -
+ * the woken coroutine runs first, as with wake_pending_task
+ */
+static void
+coro_wake_pending(taskList_t* p_wait_list, coroCB_t* p_coro)
+{
+  coro_add_to_list(&g_coro_ready_list, remove_head_from_list(p_wait_list)->p_owner);
+  coro_add_to_list(&g_coro_ready_list, p_coro);
+}
+
+/*
+ * initialize a coroutine - it starts at the top of func
+ */
+void init_coro(coroCB_t* p_coro, coro_handler func)
+{
+  p_coro->resume_point = 0;
+  p_coro->func = func;
+  p_coro->node.p_owner = p_coro;
+  p_coro->node.pNextTaskNode = 0;
+}
+
+/*
+ * Make a coroutine ready
+ */
+void coro_start(coroCB_t* p_coro)
+{
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_TASK_CREATE);
+  coro_add_to_list(&g_coro_ready_list, p_coro);
+  M_CRITICAL_EXIT();
+}
+
+/*
+ * Run the ready coroutines until none is ready - the coroutines blocked
+ * by then stay in their wait lists
+ */
+void __attribute__ ((noinline))
+coro_run(void)
+{
+  coroCB_t* p_coro;
+
+  while (1)
+  {
+    M_CRITICAL_ENTER(D_CRITICAL_SITE_SCHEDULER);
+    if (g_coro_ready_list.node_count == 0)
+    {
+      M_CRITICAL_EXIT();
+      break;
+    }
+    p_coro = remove_head_from_list(&g_coro_ready_list)->p_owner;
+    M_CRITICAL_EXIT();
+    /* run it up to its next switch */
+    p_coro->func(p_coro);
+  }
+}
+
+/*
+ * Yield - the coroutine goes to the tail of the ready list
+ */
+void __attribute__ ((noinline))
+coro_yield(coroCB_t* p_coro)
+{
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_TASK_YIELD);
+  coro_add_to_list(&g_coro_ready_list, p_coro);
+  M_CRITICAL_EXIT();
+}
+
+/*
+ * Take a semaphore
+ * return 1 if taken, 0 if the coroutine now waits for it
+ */
+unsigned int __attribute__ ((noinline))
+coro_semaphore_take(coroCB_t* p_coro, semaphoreCB_t* p_sem)
+{
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_SEMAPHORE_TAKE);
+  /* is semaphore available */
+  if (p_sem->counter && p_sem->counter <= p_sem->max_count)
+  {
+    p_sem->counter--;
+    M_CRITICAL_EXIT();
+    return 1;
+  }
+  /* wait - the take is retried once woken */
+  coro_add_to_list(&p_sem->pending_tasks, p_coro);
+  M_CRITICAL_EXIT();
+  return 0;
+}
+
+/*
+ * Release a semaphore
+ * return 1 if a waiting coroutine was woken - the caller switches
+ */
+unsigned int __attribute__ ((noinline))
+coro_semaphore_give(coroCB_t* p_coro, semaphoreCB_t* p_sem)
+{
+  unsigned int woken = 0;
+
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_SEMAPHORE_GIVE);
+  if (p_sem->counter < p_sem->max_count)
+  {
+    p_sem->counter++;
+    if (p_sem->pending_tasks.node_count != 0)
+    {
+      coro_wake_pending(&p_sem->pending_tasks, p_coro);
+      woken = 1;
+    }
+  }
+  M_CRITICAL_EXIT();
+
+  return woken;
+}
+
+/*
+ * Read event bits - the bits got are handed over in p_coro->event_bits
+ * return 1 if the condition is met, 0 if the coroutine now waits for
+ * event_set to meet it
+ */
+unsigned int __attribute__ ((noinline))
+coro_event_get(coroCB_t* p_coro, eventCB_t *p_event, unsigned int get_bits, unsigned int bits_condition)
+{
+  unsigned int bits;
+
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_EVENT_GET);
+  bits = p_event->expected_bits & get_bits;
+  /* if all/some bits are set */
+  if ((bits_condition & D_AND && bits == get_bits) || ((bits_condition & D_OR && bits)))
+  {
+    if (bits_condition & D_CLEAR_BITS)
+    {
+      p_event->expected_bits &= ~bits;
+    }
+    p_coro->event_bits = bits;
+    M_CRITICAL_EXIT();
+    return 1;
+  }
+  /* record what we are waiting for - coro_event_set evaluates it */
+  p_coro->event_bits = get_bits;
+  p_coro->event_condition = bits_condition;
+  coro_add_to_list(&p_event->pending_tasks, p_coro);
+  M_CRITICAL_EXIT();
+  return 0;
+}
+
+/*
+ * Set event bits - release every waiting coroutine whose condition is met
+ * return 1 if any was released - the caller switches
+ */
+unsigned int __attribute__ ((noinline))
+coro_event_set(coroCB_t* p_coro, eventCB_t *p_event, unsigned int set_bits)
+{
+  taskNode_t *p_node, *p_prev = 0, *p_next;
+  coroCB_t *p_waiter;
+  unsigned int bits, clear_bits = 0, woken = 0;
+
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_EVENT_SET);
+  p_event->expected_bits |= set_bits;
+
+  /* evaluate each waiting coroutine against the new bits */
+  for (p_node = p_event->pending_tasks.pNextTaskNode ; p_node != 0 ; p_node = p_next)
+  {
+    p_next = p_node->pNextTaskNode;
+    p_waiter = p_node->p_owner;
+    bits = p_event->expected_bits & p_waiter->event_bits;
+    if ((p_waiter->event_condition & D_AND && bits == p_waiter->event_bits) ||
+        ((p_waiter->event_condition & D_OR && bits)))
+    {
+      if (p_waiter->event_condition & D_CLEAR_BITS)
+      {
+        clear_bits |= bits;
+      }
+      /* hand over the bits and make the coroutine ready */
+      p_waiter->event_bits = bits;
+      remove_node_from_list(&p_event->pending_tasks, p_prev, p_node);
+      coro_add_to_list(&g_coro_ready_list, p_waiter);
+      woken = 1;
+    }
+    else
+    {
+      p_prev = p_node;
+    }
+  }
+
+  if (woken != 0)
+  {
+    p_event->expected_bits &= ~clear_bits;
+    coro_add_to_list(&g_coro_ready_list, p_coro);
+  }
+  M_CRITICAL_EXIT();
+
+  return woken;
+}
+
+/*
+ * Read an item from a queue
+ * return 1 if an item was read, 0 if the coroutine now waits for one
+ */
+unsigned int __attribute__ ((noinline))
+coro_queue_receive(coroCB_t* p_coro, queueCB_t* p_queue, unsigned int *p_item)
+{
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_QUEUE_RECEIVE);
+  if (p_queue->num_of_items != 0)
+  {
+    *p_item = p_queue->queue[p_queue->pop_index];
+    p_queue->pop_index = (p_queue->pop_index + 1) % D_MAX_QUEUE_SIZE;
+    p_queue->num_of_items--;
+    M_CRITICAL_EXIT();
+    return 1;
+  }
+  /* wait - the receive is retried once woken */
+  coro_add_to_list(&p_queue->pending_tasks, p_coro);
+  M_CRITICAL_EXIT();
+  return 0;
+}
+
+/*
+ * Write an item to a queue - a full queue drops it, as queue_send fails
+ * return 1 if a waiting coroutine was woken - the caller switches
+ */
+unsigned int __attribute__ ((noinline))
+coro_queue_send(coroCB_t* p_coro, queueCB_t* p_queue, unsigned int *p_item)
+{
+  unsigned int woken = 0;
+
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_QUEUE_SEND);
+  if (p_queue->num_of_items != D_MAX_QUEUE_SIZE)
+  {
+    p_queue->queue[p_queue->push_index] = *p_item;
+    p_queue->push_index = (p_queue->push_index + 1) % D_MAX_QUEUE_SIZE;
+    p_queue->num_of_items++;
+    if (p_queue->pending_tasks.node_count != 0)
+    {
+      coro_wake_pending(&p_queue->pending_tasks, p_coro);
+      woken = 1;
+    }
+  }
+  M_CRITICAL_EXIT();
+
+  return woken;
+}
+
+/*
+ * Yield sweep - stackful task, D_CORO_NUM_OF_ROUNDS yields
+ */
+void coro_stackful_yield_func(void)
+{
+  unsigned int round;
+
+  /* the first task to run starts the measurement */
+  if (g_coro_started == 0)
+  {
+    g_coro_started = 1;
+    M_READ_CYCLE_COUNTER(g_coro_cycles_start);
+  }
+  for (round = 0 ; round < D_CORO_NUM_OF_ROUNDS ; round++)
+  {
+    task_yield();
+  }
+  /* the last task to finish ends it */
+  if (++g_coro_done == g_coro_num_of_tasks)
+  {
+    M_READ_CYCLE_COUNTER(g_coro_cycles_end);
+    return_to_main();
+  }
+  semaphore_take(&g_coro_park_sem, D_WAIT_FOREVER);
+}
+
+/*
+ * Yield sweep - coroutine, D_CORO_NUM_OF_ROUNDS yields
+ */
+unsigned int coro_yield_func(coroCB_t* p_coro)
+{
+  coroBenchTask_t* p_task = (coroBenchTask_t*)p_coro;
+
+  M_CORO_BEGIN(p_coro);
+  if (g_coro_started == 0)
+  {
+    g_coro_started = 1;
+    M_READ_CYCLE_COUNTER(g_coro_cycles_start);
+  }
+  for (p_task->round = 0 ; p_task->round < D_CORO_NUM_OF_ROUNDS ; p_task->round++)
+  {
+    M_CORO_YIELD(p_coro);
+  }
+  if (++g_coro_done == g_coro_num_of_tasks)
+  {
+    M_READ_CYCLE_COUNTER(g_coro_cycles_end);
+  }
+  M_CORO_END(p_coro);
+}
+
+/*
+ * Handoff - stackful task starting each round trip
+ */
+void coro_stackful_ping_func(void)
+{
+  unsigned int round, item;
+
+  M_READ_CYCLE_COUNTER(g_coro_cycles_start);
+  for (round = 0 ; round < D_CORO_NUM_OF_ROUNDS ; round++)
+  {
+    if (g_coro_handoff == D_CORO_HANDOFF_SEMAPHORE)
+    {
+      semaphore_give(&g_coro_sem_b);
+      semaphore_take(&g_coro_sem_a, D_WAIT_FOREVER);
+    }
+    else if (g_coro_handoff == D_CORO_HANDOFF_EVENT)
+    {
+      event_set(&g_coro_event_b, D_CORO_EVENT_BIT);
+      event_get(&g_coro_event_a, D_CORO_EVENT_BIT, D_OR | D_CLEAR_BITS, D_WAIT_FOREVER);
+    }
+    else
+    {
+      item = round;
+      queue_send(&g_coro_queue_b, &item);
+      queue_receive(&g_coro_queue_a, &item, D_WAIT_FOREVER);
+      g_coro_errors += (item != round);
+    }
+  }
+  M_READ_CYCLE_COUNTER(g_coro_cycles_end);
+  return_to_main();
+}
+
+/*
+ * Handoff - stackful task answering each round trip
+ */
+void coro_stackful_pong_func(void)
+{
+  unsigned int round, item;
+
+  for (round = 0 ; round < D_CORO_NUM_OF_ROUNDS ; round++)
+  {
+    if (g_coro_handoff == D_CORO_HANDOFF_SEMAPHORE)
+    {
+      semaphore_take(&g_coro_sem_b, D_WAIT_FOREVER);
+      semaphore_give(&g_coro_sem_a);
+    }
+    else if (g_coro_handoff == D_CORO_HANDOFF_EVENT)
+    {
+      event_get(&g_coro_event_b, D_CORO_EVENT_BIT, D_OR | D_CLEAR_BITS, D_WAIT_FOREVER);
+      event_set(&g_coro_event_a, D_CORO_EVENT_BIT);
+    }
+    else
+    {
+      queue_receive(&g_coro_queue_b, &item, D_WAIT_FOREVER);
+      queue_send(&g_coro_queue_a, &item);
+    }
+  }
+  /* the last give/set/send switched to ping, which ends the measurement */
+  g_coro_errors++;
+  return_to_main();
+}
+
+/*
+ * Handoff - coroutine starting each round trip
+ */
+unsigned int coro_ping_func(coroCB_t* p_coro)
+{
+  coroBenchTask_t* p_task = (coroBenchTask_t*)p_coro;
+
+  M_CORO_BEGIN(p_coro);
+  M_READ_CYCLE_COUNTER(g_coro_cycles_start);
+  for (p_task->round = 0 ; p_task->round < D_CORO_NUM_OF_ROUNDS ; p_task->round++)
+  {
+    if (g_coro_handoff == D_CORO_HANDOFF_SEMAPHORE)
+    {
+      M_CORO_SEMAPHORE_GIVE(p_coro, &g_coro_sem_b);
+      M_CORO_SEMAPHORE_TAKE(p_coro, &g_coro_sem_a);
+    }
+    else if (g_coro_handoff == D_CORO_HANDOFF_EVENT)
+    {
+      M_CORO_EVENT_SET(p_coro, &g_coro_event_b, D_CORO_EVENT_BIT);
+      M_CORO_EVENT_GET(p_coro, &g_coro_event_a, D_CORO_EVENT_BIT, D_OR | D_CLEAR_BITS);
+    }
+    else
+    {
+      p_task->item = p_task->round;
+      M_CORO_QUEUE_SEND(p_coro, &g_coro_queue_b, &p_task->item);
+      M_CORO_QUEUE_RECEIVE(p_coro, &g_coro_queue_a, &p_task->item);
+      g_coro_errors += (p_task->item != p_task->round);
+    }
+  }
+  M_READ_CYCLE_COUNTER(g_coro_cycles_end);
+  M_CORO_END(p_coro);
+}
+
+/*
+ * Handoff - coroutine answering each round trip
+ */
+unsigned int coro_pong_func(coroCB_t* p_coro)
+{
+  coroBenchTask_t* p_task = (coroBenchTask_t*)p_coro;
+
+  M_CORO_BEGIN(p_coro);
+  for (p_task->round = 0 ; p_task->round < D_CORO_NUM_OF_ROUNDS ; p_task->round++)
+  {
+    if (g_coro_handoff == D_CORO_HANDOFF_SEMAPHORE)
+    {
+      M_CORO_SEMAPHORE_TAKE(p_coro, &g_coro_sem_b);
+      M_CORO_SEMAPHORE_GIVE(p_coro, &g_coro_sem_a);
+    }
+    else if (g_coro_handoff == D_CORO_HANDOFF_EVENT)
+    {
+      M_CORO_EVENT_GET(p_coro, &g_coro_event_b, D_CORO_EVENT_BIT, D_OR | D_CLEAR_BITS);
+      M_CORO_EVENT_SET(p_coro, &g_coro_event_a, D_CORO_EVENT_BIT);
+    }
+    else
+    {
+      M_CORO_QUEUE_RECEIVE(p_coro, &g_coro_queue_b, &p_task->item);
+      M_CORO_QUEUE_SEND(p_coro, &g_coro_queue_a, &p_task->item);
+    }
+  }
+  M_CORO_END(p_coro);
+}
+
+/*
+ * Yield switch cost of num_of_tasks stackful tasks
+ * return cpu cycles per switch
+ */
+static unsigned int
+coro_stackful_sweep(unsigned int num_of_tasks)
+{
+  unsigned int i;
+
+  g_coro_num_of_tasks = num_of_tasks;
+  g_coro_done = 0;
+  g_coro_started = 0;
+  init_semaphore(&g_coro_park_sem);
+  init_scheduler();
+  for (i = 0 ; i < num_of_tasks ; i++)
+  {
+    init_task(&g_coro_stackful_tasks[i], coro_stackful_yield_func, coro_stackful_stacks[i], D_STACK_SIZE);
+    add_task_to_list(&ready_tasks_list, &g_coro_stackful_tasks[i]);
+  }
+  invoke_first_task();
+
+  g_coro_errors += (g_coro_done != num_of_tasks);
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(&g_coro_stackful_tasks[0], &g_coro_stackful_stack_usage);
+#endif /* D_STACK_WATERMARK */
+
+  return (g_coro_cycles_end - g_coro_cycles_start)/(num_of_tasks*D_CORO_NUM_OF_ROUNDS);
+}
+
+/*
+ * Yield switch cost of num_of_tasks coroutines
+ * return cpu cycles per switch
+ */
+static unsigned int
+coro_stackless_sweep(unsigned int num_of_tasks)
+{
+  unsigned int i;
+#ifdef D_STACK_WATERMARK
+  unsigned int *p_sp, *p_word, used;
+#endif /* D_STACK_WATERMARK */
+
+  g_coro_num_of_tasks = num_of_tasks;
+  g_coro_done = 0;
+  g_coro_started = 0;
+  for (i = 0 ; i < num_of_tasks ; i++)
+  {
+    init_coro(&g_coro_tasks[i].coro, coro_yield_func);
+    coro_start(&g_coro_tasks[i].coro);
+  }
+#ifdef D_STACK_WATERMARK
+  /* keep the main stack high-water mark so far, then paint again - the
+     coroutines use the stack below this point */
+  update_main_stack_usage(&g_stack_usage_main);
+  M_READ_STACK_POINTER(p_sp);
+  paint_main_stack();
+#endif /* D_STACK_WATERMARK */
+  coro_run();
+#ifdef D_STACK_WATERMARK
+  for (p_word = _heap_end ; p_word < p_sp && *p_word == D_STACK_PAINT ; p_word++);
+  used = (p_sp - p_word)*sizeof(unsigned int);
+  if (used > g_coro_shared_stack)
+  {
+    g_coro_shared_stack = used;
+  }
+#endif /* D_STACK_WATERMARK */
+
+  g_coro_errors += (g_coro_done != num_of_tasks);
+
+  return (g_coro_cycles_end - g_coro_cycles_start)/(num_of_tasks*D_CORO_NUM_OF_ROUNDS);
+}
+
+/*
+ * Round trip of a handoff in both models
+ * handoff - D_CORO_HANDOFF_*
+ * p_result - measured cycles
+ */
+static void
+coro_handoff(unsigned int handoff, coroHandoffResult_t* p_result)
+{
+  g_coro_handoff = handoff;
+
+  /* stackful tasks */
+  init_semaphore(&g_coro_sem_a);
+  init_semaphore(&g_coro_sem_b);
+  init_event(&g_coro_event_a);
+  init_event(&g_coro_event_b);
+  init_queue(&g_coro_queue_a);
+  init_queue(&g_coro_queue_b);
+  init_scheduler();
+  init_task(&g_coro_stackful_tasks[0], coro_stackful_ping_func, coro_stackful_stacks[0], D_STACK_SIZE);
+  init_task(&g_coro_stackful_tasks[1], coro_stackful_pong_func, coro_stackful_stacks[1], D_STACK_SIZE);
+  add_task_to_list(&ready_tasks_list, &g_coro_stackful_tasks[0]);
+  add_task_to_list(&ready_tasks_list, &g_coro_stackful_tasks[1]);
+  invoke_first_task();
+  p_result->stackful_cycles = (g_coro_cycles_end - g_coro_cycles_start)/D_CORO_NUM_OF_ROUNDS;
+
+  /* coroutines */
+  init_semaphore(&g_coro_sem_a);
+  init_semaphore(&g_coro_sem_b);
+  init_event(&g_coro_event_a);
+  init_event(&g_coro_event_b);
+  init_queue(&g_coro_queue_a);
+  init_queue(&g_coro_queue_b);
+  init_coro(&g_coro_tasks[0].coro, coro_ping_func);
+  init_coro(&g_coro_tasks[1].coro, coro_pong_func);
+  coro_start(&g_coro_tasks[0].coro);
+  coro_start(&g_coro_tasks[1].coro);
+  coro_run();
+  p_result->stackless_cycles = (g_coro_cycles_end - g_coro_cycles_start)/D_CORO_NUM_OF_ROUNDS;
+
+  /* both coroutines ran to their end */
+  g_coro_errors += (g_coro_tasks[0].coro.resume_point != 0 || g_coro_tasks[1].coro.resume_point != 0);
+  g_coro_errors += (g_coro_tasks[0].round != D_CORO_NUM_OF_ROUNDS || g_coro_tasks[1].round != D_CORO_NUM_OF_ROUNDS);
+}
+
+void
+coro_benchmark(void)
+{
+  unsigned int i, num_of_tasks;
+
+  g_coro_errors = 0;
+
+  for (i = 0 ; i < D_CORO_NUM_OF_COUNTS ; i++)
+  {
+    num_of_tasks = 2 << i;
+    g_coro_results[i].num_of_tasks = num_of_tasks;
+    g_coro_results[i].stackful_cycles = coro_stackful_sweep(num_of_tasks);
+    g_coro_results[i].stackless_cycles = coro_stackless_sweep(num_of_tasks);
+    g_coro_results[i].stackful_ram = sizeof(taskCB_t) + D_STACK_SIZE*sizeof(unsigned int);
+    g_coro_results[i].stackless_ram = sizeof(coroBenchTask_t);
+  }
+
+  coro_handoff(D_CORO_HANDOFF_SEMAPHORE, &g_coro_semaphore_result);
+  coro_handoff(D_CORO_HANDOFF_EVENT, &g_coro_event_result);
+  coro_handoff(D_CORO_HANDOFF_QUEUE, &g_coro_queue_result);
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,89 @@
+#ifndef __CONTEXT_SWITCH_LATENCY_CORO_H__
+#define __CONTEXT_SWITCH_LATENCY_CORO_H__
+
+/*
+ * Stackless tasks - coroutines sharing the stack of coro_run. A coroutine
+ * function returns to coro_run on every switch and is called again at the
+ * point it left (a switch on the source line). Its locals don't survive a
+ * switch; state it keeps lives in its control block - embed coroCB_t as
+ * the first member of a larger struct. The primitives keep the semantics
+ * of the stackful kernel on the same kernel objects, but an object serves
+ * one model at a time. One switching macro per source line, and none
+ * inside a switch statement of the coroutine body.
+ */
+
+/* coroutine function return */
+#define D_CORO_SWITCHED  0
+#define D_CORO_EXITED    1
+
+struct coroCB;
+
+/* coroutine function definition */
+typedef unsigned int (*coro_handler)(struct coroCB* p_coro);
+
+/* coroutine control block */
+typedef struct coroCB
+{
+  /* resume point - source line of the last switch, 0 at start */
+  unsigned int  resume_point;
+  /* coroutine function */
+  coro_handler  func;
+  /* ready list or object wait list node */
+  taskNode_t    node;
+  /* event bits waited for - the received bits once released */
+  unsigned int  event_bits;
+  /* event wait condition - D_AND/D_OR and D_CLEAR_BITS */
+  unsigned int  event_condition;
+}coroCB_t;
+
+/* functions implemented in context-switch-latency-coro.c */
+void init_coro(coroCB_t* p_coro, coro_handler func);
+void coro_start(coroCB_t* p_coro);
+void coro_run(void);
+void coro_yield(coroCB_t* p_coro);
+unsigned int coro_semaphore_take(coroCB_t* p_coro, semaphoreCB_t* p_sem);
+unsigned int coro_semaphore_give(coroCB_t* p_coro, semaphoreCB_t* p_sem);
+unsigned int coro_event_get(coroCB_t* p_coro, eventCB_t *p_event, unsigned int get_bits, unsigned int bits_condition);
+unsigned int coro_event_set(coroCB_t* p_coro, eventCB_t *p_event, unsigned int set_bits);
+unsigned int coro_queue_receive(coroCB_t* p_coro, queueCB_t* p_queue, unsigned int *p_item);
+unsigned int coro_queue_send(coroCB_t* p_coro, queueCB_t* p_queue, unsigned int *p_item);
+
+/* coroutine body - resume where the last switch left */
+#define M_CORO_BEGIN(p_coro)  switch ((p_coro)->resume_point) { case 0:
+/* end of the body - the coroutine is done */
+#define M_CORO_END(p_coro)    } (p_coro)->resume_point = 0; return D_CORO_EXITED;
+
+/* return to coro_run, resume at the next statement */
+#define M_CORO_SWITCH(p_coro)  (p_coro)->resume_point = __LINE__; return D_CORO_SWITCHED; case __LINE__:
+
+/* yield to the other ready coroutines */
+#define M_CORO_YIELD(p_coro) \
+  do { coro_yield(p_coro); M_CORO_SWITCH(p_coro); } while (0)
+
+/* take a semaphore, wait forever - retried when woken, as semaphore_take */
+#define M_CORO_SEMAPHORE_TAKE(p_coro, p_sem) \
+  do { (p_coro)->resume_point = __LINE__; case __LINE__: \
+       if (coro_semaphore_take(p_coro, p_sem) == 0) return D_CORO_SWITCHED; } while (0)
+
+/* give a semaphore, switch to the woken coroutine */
+#define M_CORO_SEMAPHORE_GIVE(p_coro, p_sem) \
+  do { if (coro_semaphore_give(p_coro, p_sem) != 0) { M_CORO_SWITCH(p_coro); } } while (0)
+
+/* wait forever for event bits - the bits got are in p_coro->event_bits */
+#define M_CORO_EVENT_GET(p_coro, p_event, get_bits, bits_condition) \
+  do { if (coro_event_get(p_coro, p_event, get_bits, bits_condition) == 0) { M_CORO_SWITCH(p_coro); } } while (0)
+
+/* set event bits, switch if waiting coroutines were released */
+#define M_CORO_EVENT_SET(p_coro, p_event, set_bits) \
+  do { if (coro_event_set(p_coro, p_event, set_bits) != 0) { M_CORO_SWITCH(p_coro); } } while (0)
+
+/* receive a queue item, wait forever - p_item must outlive the switch */
+#define M_CORO_QUEUE_RECEIVE(p_coro, p_queue, p_item) \
+  do { (p_coro)->resume_point = __LINE__; case __LINE__: \
+       if (coro_queue_receive(p_coro, p_queue, p_item) == 0) return D_CORO_SWITCHED; } while (0)
+
+/* send a queue item, switch to a woken receiver */
+#define M_CORO_QUEUE_SEND(p_coro, p_queue, p_item) \
+  do { if (coro_queue_send(p_coro, p_queue, p_item) != 0) { M_CORO_SWITCH(p_coro); } } while (0)
+
+#endif /* __CONTEXT_SWITCH_LATENCY_CORO_H__ */
@@ -0,0 +1,93 @@
+
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#elif defined(D_ARM)
+ #include "context-switch-latency-port-arm.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+#include "context-switch-latency-critical.h"
+
+/*
+ * Interrupt masked windows - every outermost critical section is timed
+ * from masking to unmasking and accounted to its call site and to the
+ * benchmark running. The worst window adds as is to the worst case
+ * interrupt latency.
+ */
+
+/* per call site - D_CRITICAL_SITE_* */
+criticalStats_t g_critical_stats[D_CRITICAL_NUM_OF_SITES];
+/* per benchmark - D_CRITICAL_BENCH_* */
+criticalWorst_t g_critical_worst[D_CRITICAL_NUM_OF_BENCHMARKS];
+
+/* window being timed and the benchmark it counts for */
+unsigned int g_critical_site;
+cycles_t g_critical_start;
+unsigned int g_critical_benchmark;
+
+/*
+ * Clear the statistics
+ */
+void
+critical_init(void)
+{
+  unsigned int i, j;
+
+  for (i = 0 ; i < D_CRITICAL_NUM_OF_SITES ; i++)
+  {
+    g_critical_stats[i].num_of_windows = 0;
+    g_critical_stats[i].max_cycles = 0;
+    g_critical_stats[i].total_cycles = 0;
+    for (j = 0 ; j < D_CRITICAL_NUM_OF_BINS ; j++)
+    {
+      g_critical_stats[i].histogram[j] = 0;
+    }
+  }
+  for (i = 0 ; i < D_CRITICAL_NUM_OF_BENCHMARKS ; i++)
+  {
+    g_critical_worst[i].cycles = 0;
+    g_critical_worst[i].site = 0;
+  }
+  g_critical_benchmark = D_CRITICAL_BENCH_MAIN;
+}
+
+/*
+ * Account a masked window - called once the interrupts are restored
+ * site - D_CRITICAL_SITE_*
+ * cycles - window length
+ */
+void __attribute__ ((noinline))
+critical_record(unsigned int site, unsigned int cycles)
+{
+  criticalStats_t* p_stats = &g_critical_stats[site];
+  criticalWorst_t* p_worst = &g_critical_worst[g_critical_benchmark];
+  unsigned int bin = 0, length = cycles >> D_CRITICAL_FIRST_BIN_SHIFT;
+
+  /* bin i holds windows shorter than 16 << i cycles, the last one the rest */
+  while (length != 0 && bin < D_CRITICAL_NUM_OF_BINS - 1)
+  {
+    length >>= 1;
+    bin++;
+  }
+
+  p_stats->num_of_windows++;
+  p_stats->total_cycles += cycles;
+  p_stats->histogram[bin]++;
+  if (cycles > p_stats->max_cycles)
+  {
+    p_stats->max_cycles = cycles;
+  }
+  if (cycles > p_worst->cycles)
+  {
+    p_worst->cycles = cycles;
+    p_worst->site = site;
+  }
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,145 @@
+#ifndef __CONTEXT_SWITCH_LATENCY_CRITICAL_H__
+#define __CONTEXT_SWITCH_LATENCY_CRITICAL_H__
+
+/*
+ * Kernel critical sections - interrupts are masked while kernel objects
+ * and task lists are changed. Sections nest; the outermost one masks and
+ * restores the interrupts and owns the call site. A section is always
+ * left before context_switch - the scheduler has a section of its own.
+ * The sections mask only with D_CRITICAL_SECTIONS - set once isrs call
+ * the kernel (D_ISR_DEFER) or by request; without it they are empty, as
+ * nothing else interrupts the kernel. D_CRITICAL_STATS times every masked
+ * window per call site and per benchmark.
+ */
+
+#if defined(D_CRITICAL_STATS) && !defined(D_CRITICAL_SECTIONS)
+#error "D_CRITICAL_STATS times the windows of D_CRITICAL_SECTIONS"
+#endif /* D_CRITICAL_STATS */
+
+/* call sites */
+#define D_CRITICAL_SITE_EVENT_GET         0
+#define D_CRITICAL_SITE_EVENT_SET         1
+#define D_CRITICAL_SITE_SEMAPHORE_TAKE    2
+#define D_CRITICAL_SITE_SEMAPHORE_GIVE    3
+#define D_CRITICAL_SITE_QUEUE_RECEIVE     4
+#define D_CRITICAL_SITE_QUEUE_SEND        5
+#define D_CRITICAL_SITE_QUEUE_SEND_BATCH  6
+#define D_CRITICAL_SITE_TASK_YIELD        7
+#define D_CRITICAL_SITE_TASK_CREATE       8
+#define D_CRITICAL_SITE_TASK_DELETE       9
+#define D_CRITICAL_SITE_POOL              10
+#define D_CRITICAL_SITE_SCHEDULER         11
+#define D_CRITICAL_NUM_OF_SITES           12
+
+/* benchmarks - the worst window of each */
+#define D_CRITICAL_BENCH_MAIN             0
+#define D_CRITICAL_BENCH_MSG              1
+#define D_CRITICAL_BENCH_EVENT            2
+#define D_CRITICAL_BENCH_TASK             3
+#define D_CRITICAL_BENCH_SYSCALL          4
+#define D_CRITICAL_BENCH_PMP              5
+#define D_CRITICAL_BENCH_CORO             6
+#define D_CRITICAL_BENCH_WSET             7
+#define D_CRITICAL_BENCH_SMP              8
+#define D_CRITICAL_BENCH_ISR              9
+#define D_CRITICAL_BENCH_EDF              10
+#define D_CRITICAL_NUM_OF_BENCHMARKS      11
+
+/* window length histogram - <16, <32, ... <1024 and >=1024 cycles */
+#define D_CRITICAL_NUM_OF_BINS            8
+#define D_CRITICAL_FIRST_BIN_SHIFT        4
+
+/* masked windows of a call site */
+typedef struct criticalStats
+{
+  /* number of windows */
+  unsigned int  num_of_windows;
+  /* longest window in cpu cycles */
+  unsigned int  max_cycles;
+  /* cpu cycles of all windows */
+  unsigned int  total_cycles;
+  /* number of windows per length bin */
+  unsigned int  histogram[D_CRITICAL_NUM_OF_BINS];
+}criticalStats_t;
+
+/* worst masked window of a benchmark */
+typedef struct criticalWorst
+{
+  /* cpu cycles */
+  unsigned int  cycles;
+  /* D_CRITICAL_SITE_* of the window */
+  unsigned int  site;
+}criticalWorst_t;
+
+#ifdef D_CRITICAL_SECTIONS
+/* section state - defined in context-switch-latency.c */
+extern unsigned int g_critical_nesting;
+extern unsigned int g_critical_int_state;
+#endif /* D_CRITICAL_SECTIONS */
+#ifdef D_CRITICAL_STATS
+extern unsigned int g_critical_site;
+extern cycles_t g_critical_start;
+extern unsigned int g_critical_benchmark;
+
+void critical_record(unsigned int site, unsigned int cycles);
+void critical_init(void);
+#endif /* D_CRITICAL_STATS */
+
+#ifdef D_CRITICAL_SECTIONS
+/*
+ * Enter a critical section
+ * site - D_CRITICAL_SITE_*, kept by the outermost section
+ */
+static inline void
+critical_enter(unsigned int site __attribute__ ((unused)))
+{
+  unsigned int int_state;
+
+  M_DISABLE_INTERRUPTS(int_state);
+  if (g_critical_nesting++ == 0)
+  {
+    g_critical_int_state = int_state;
+#ifdef D_CRITICAL_STATS
+    g_critical_site = site;
+    M_READ_CYCLE_COUNTER(g_critical_start);
+#endif /* D_CRITICAL_STATS */
+  }
+}
+
+/*
+ * Leave a critical section - the outermost one restores the interrupts
+ */
+static inline void
+critical_exit(void)
+{
+#ifdef D_CRITICAL_STATS
+  cycles_t end;
+#endif /* D_CRITICAL_STATS */
+
+  if (--g_critical_nesting == 0)
+  {
+#ifdef D_CRITICAL_STATS
+    M_READ_CYCLE_COUNTER(end);
+#endif /* D_CRITICAL_STATS */
+    M_RESTORE_INTERRUPTS(g_critical_int_state);
+#ifdef D_CRITICAL_STATS
+    critical_record(g_critical_site, end - g_critical_start);
+#endif /* D_CRITICAL_STATS */
+  }
+}
+
+  #define M_CRITICAL_ENTER(site)  critical_enter(site)
+  #define M_CRITICAL_EXIT()       critical_exit()
+#else
+  #define M_CRITICAL_ENTER(site)
+  #define M_CRITICAL_EXIT()
+#endif /* D_CRITICAL_SECTIONS */
+
+#ifdef D_CRITICAL_STATS
+  /* windows from here on count for benchmark id */
+  #define M_CRITICAL_BENCHMARK(id)  g_critical_benchmark = (id)
+#else
+  #define M_CRITICAL_BENCHMARK(id)
+#endif /* D_CRITICAL_STATS */
+
+#endif /* __CONTEXT_SWITCH_LATENCY_CRITICAL_H__ */
@@ -0,0 +1,552 @@
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+#include "context-switch-latency-isr.h"
+
+/*
+ * EDF benchmark - periodic tasks with implicit deadlines, released by the
+ * machine timer isr, in two scheduling modes:
+ *   fixed-priority - rate monotonic priorities, a ready list per priority
+ *                    and a bitmap of the non-empty lists
+ *   EDF            - a binary min-heap of the ready tasks on their
+ *                    absolute deadlines
+ * D_EDF_NUM_OF_SETS synthetic task sets are swept from 50% to 100%
+ * utilization - each set keeps its periods and weights, the execution
+ * times are scaled to the utilization. Times are in mtime ticks, the jobs
+ * run a loop calibrated against mtime. Per mode and utilization it reports
+ * the cycles of a ready insertion and of a selection, the cycles of a
+ * release interrupt and the deadline-miss ratio.
+ */
+
+#define D_EDF_NUM_OF_TASKS     8
+#define D_EDF_NUM_OF_SETS      4
+/* 50%, 60%, ... 100% utilization */
+#define D_EDF_MIN_UTIL         50
+#define D_EDF_UTIL_STEP        10
+#define D_EDF_NUM_OF_UTILS     6
+/* task periods and run length in mtime ticks */
+#ifndef D_EDF_PERIOD_MIN
+#define D_EDF_PERIOD_MIN       1000
+#endif /* D_EDF_PERIOD_MIN */
+#ifndef D_EDF_PERIOD_MAX
+#define D_EDF_PERIOD_MAX       10000
+#endif /* D_EDF_PERIOD_MAX */
+#ifndef D_EDF_RUN_TICKS
+#define D_EDF_RUN_TICKS        100000
+#endif /* D_EDF_RUN_TICKS */
+/* first release - the tasks wait for it */
+#define D_EDF_START_TICKS      100
+/* deadline and priority of the task ending a run - after every job */
+#define D_EDF_LAST_DEADLINE    0x40000000
+#define D_EDF_LAST_PRIORITY    D_EDF_NUM_OF_TASKS
+/* job loop calibration */
+#define D_EDF_CALIB_LOOPS      100000
+/* task stack in words - an isr frame and a switch on top of the task */
+#define D_EDF_STACK_SIZE       (4*D_STACK_SIZE)
+
+/* scheduling modes - D_SCHED_POLICY_FP + mode */
+#define D_EDF_MODE_FP          0
+#define D_EDF_MODE_EDF         1
+#define D_EDF_NUM_OF_MODES     2
+
+/* ready structure - the job tasks and the task ending a run */
+#define D_SCHED_MAX_READY      (D_EDF_NUM_OF_TASKS + 1)
+/* fixed-priority levels - one bit each in the bitmap */
+#define D_SCHED_NUM_OF_PRIORITIES 32
+
+/* CLINT mtime */
+#ifndef D_EDF_CLINT_MTIME
+#define D_EDF_CLINT_MTIME      0x0200BFF8
+#endif /* D_EDF_CLINT_MTIME */
+#define D_EDF_TIMECMP_NEVER    0xFFFFFFFFFFFFFFFFULL
+/* mie.MTIE, mstatus.MIE */
+#define D_EDF_MIE_MTIE         0x80
+#define D_EDF_MSTATUS_MIE      0x8
+
+/* is the deadline of task a earlier than the deadline of task b */
+#define M_EDF_EARLIER(p_a, p_b) ((int)((p_a)->deadline - (p_b)->deadline) < 0)
+
+/* a utilization in one mode - over D_EDF_NUM_OF_SETS task sets */
+typedef struct edfResult
+{
+  /* utilization in percent */
+  unsigned int utilization;
+  /* jobs run and jobs which finished after their deadline */
+  unsigned int jobs;
+  unsigned int misses;
+  /* misses per 1000 jobs */
+  unsigned int miss_permille;
+  /* cpu cycles to insert a task into the ready structure */
+  unsigned int insert_cycles;
+  /* cpu cycles to select the next task */
+  unsigned int select_cycles;
+  /* cpu cycles of a release interrupt, the wake ups included */
+  unsigned int release_cycles;
+}edfResult_t;
+
+/* periodic task state */
+typedef struct edfTask
+{
+  /* period and relative deadline, in ticks */
+  unsigned int period;
+  /* job loop iterations */
+  unsigned int loops;
+  /* next release time */
+  unsigned int next_release;
+  /* jobs released and done */
+  volatile unsigned int released;
+  unsigned int done;
+}edfTask_t;
+
+/* tasks handlers functions */
+static void edf_task_func(void);
+static void edf_last_task_func(void);
+
+/* benchmark results - [mode][utilization] */
+edfResult_t g_edf_results[D_EDF_NUM_OF_MODES][D_EDF_NUM_OF_UTILS];
+unsigned int g_edf_errors;
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_edf_stack_usage;
+#endif /* D_STACK_WATERMARK */
+
+/* periodic tasks and the task ending a run */
+static taskCB_t g_edf_tasks[D_EDF_NUM_OF_TASKS];
+static taskCB_t g_edf_last_task;
+unsigned int edf_task_stacks[D_EDF_NUM_OF_TASKS][D_EDF_STACK_SIZE];
+unsigned int edf_last_stack[D_EDF_STACK_SIZE];
+static edfTask_t g_edf_task_state[D_EDF_NUM_OF_TASKS];
+/* a semaphore per task, given on its releases */
+static semaphoreCB_t g_edf_sems[D_EDF_NUM_OF_TASKS];
+static semaphoreCB_t g_edf_done_sem;
+
+/* ready structures */
+static unsigned int g_sched_num_of_ready;
+static taskCB_t* g_sched_heap[D_SCHED_MAX_READY];
+static taskList_t g_sched_fp_lists[D_SCHED_NUM_OF_PRIORITIES];
+static unsigned int g_sched_fp_bitmap;
+
+static unsigned long long g_edf_base;
+static unsigned int g_edf_loops_per_ktick;
+static unsigned int g_edf_next_id;
+static unsigned int g_edf_jobs, g_edf_misses;
+static unsigned int g_edf_insert_sum, g_edf_inserts;
+static unsigned int g_edf_select_sum, g_edf_selects;
+static unsigned int g_edf_release_sum, g_edf_release_irqs;
+
+/*
+ * Select the scheduling mode and empty the ready structures - after
+ * init_scheduler
+ * policy - D_SCHED_POLICY_*
+ */
+void
+sched_init(unsigned int policy)
+{
+  unsigned int i;
+
+  g_sched_policy = policy;
+  g_sched_num_of_ready = 0;
+  g_sched_fp_bitmap = 0;
+  for (i = 0 ; i < D_SCHED_NUM_OF_PRIORITIES ; i++)
+  {
+    g_sched_fp_lists[i].node_count = 0;
+  }
+}
+
+/*
+ * Insert a ready task - behind the tasks of its priority, or into the
+ * heap on its deadline; called in a critical section
+ */
+void
+sched_add_ready(taskCB_t* p_task)
+{
+  cycles_t start, end;
+  unsigned int i, parent;
+
+  M_READ_CYCLE_COUNTER(start);
+  if (g_sched_num_of_ready == D_SCHED_MAX_READY)
+  {
+    g_edf_errors++;
+    return;
+  }
+  if (g_sched_policy == D_SCHED_POLICY_EDF)
+  {
+    /* sift up from the new leaf */
+    for (i = g_sched_num_of_ready ; i > 0 ; i = parent)
+    {
+      parent = (i - 1)/2;
+      if (!M_EDF_EARLIER(p_task, g_sched_heap[parent]))
+      {
+        break;
+      }
+      g_sched_heap[i] = g_sched_heap[parent];
+    }
+    g_sched_heap[i] = p_task;
+  }
+  else
+  {
+    add_task_to_list(&g_sched_fp_lists[p_task->priority], p_task);
+    g_sched_fp_bitmap |= 1U << p_task->priority;
+  }
+  g_sched_num_of_ready++;
+  M_READ_CYCLE_COUNTER_END(end);
+
+  g_edf_insert_sum += end - start;
+  g_edf_inserts++;
+}
+
+/*
+ * Remove the next task to run - the head of the highest priority list,
+ * or the root of the heap; called in a critical section with a task ready
+ */
+taskCB_t*
+sched_take_ready(void)
+{
+  cycles_t start, end;
+  taskCB_t *p_task, *p_last;
+  unsigned int i, child, priority;
+
+  M_READ_CYCLE_COUNTER(start);
+  g_sched_num_of_ready--;
+  if (g_sched_policy == D_SCHED_POLICY_EDF)
+  {
+    p_task = g_sched_heap[0];
+    /* sift the last leaf down from the root */
+    p_last = g_sched_heap[g_sched_num_of_ready];
+    for (i = 0 ; (child = 2*i + 1) < g_sched_num_of_ready ; i = child)
+    {
+      if (child + 1 < g_sched_num_of_ready && M_EDF_EARLIER(g_sched_heap[child + 1], g_sched_heap[child]))
+      {
+        child++;
+      }
+      if (!M_EDF_EARLIER(g_sched_heap[child], p_last))
+      {
+        break;
+      }
+      g_sched_heap[i] = g_sched_heap[child];
+    }
+    g_sched_heap[i] = p_last;
+  }
+  else
+  {
+    /* priority 0 is the lowest bit */
+    priority = __builtin_ctz(g_sched_fp_bitmap);
+    p_task = (taskCB_t*)remove_head_from_list(&g_sched_fp_lists[priority])->p_owner;
+    if (g_sched_fp_lists[priority].node_count == 0)
+    {
+      g_sched_fp_bitmap &= ~(1U << priority);
+    }
+  }
+  M_READ_CYCLE_COUNTER_END(end);
+
+  g_edf_select_sum += end - start;
+  g_edf_selects++;
+
+  return p_task;
+}
+
+/*
+ * Number of ready tasks
+ */
+unsigned int
+sched_num_of_ready(void)
+{
+  return g_sched_num_of_ready;
+}
+
+/*
+ * Read mtime - the high word again until it didn't change
+ */
+static unsigned long long
+edf_read_mtime(void)
+{
+  volatile unsigned int *p_mtime = (volatile unsigned int*)D_EDF_CLINT_MTIME;
+  unsigned int high, low;
+
+  do
+  {
+    high = p_mtime[1];
+    low = p_mtime[0];
+  } while (high != p_mtime[1]);
+
+  return ((unsigned long long)high << 32) | low;
+}
+
+/*
+ * Ticks since the start of the run
+ */
+static unsigned int
+edf_time(void)
+{
+  volatile unsigned int *p_mtime = (volatile unsigned int*)D_EDF_CLINT_MTIME;
+
+  return p_mtime[0] - (unsigned int)g_edf_base;
+}
+
+/*
+ * Job body - loops iterations of a busy loop
+ */
+static void __attribute__ ((noinline))
+edf_work(unsigned int loops)
+{
+  volatile unsigned int count;
+
+  for (count = loops ; count != 0 ; count--)
+  {
+  }
+}
+
+/*
+ * Timer interrupt - release the tasks whose release time has come and set
+ * the timer to the next release; the last one ends the run
+ */
+static void
+edf_release_handler(void)
+{
+  cycles_t start, end;
+  unsigned int i, now, next = 0;
+  edfTask_t* p_state;
+
+  M_READ_CYCLE_COUNTER(start);
+  now = edf_time();
+  for (i = 0 ; i < D_EDF_NUM_OF_TASKS ; i++)
+  {
+    p_state = &g_edf_task_state[i];
+    if ((int)(now - p_state->next_release) >= 0)
+    {
+      p_state->released++;
+      p_state->next_release += p_state->period;
+      /* from an isr - marks the reschedule only */
+      semaphore_give(&g_edf_sems[i]);
+    }
+    if (i == 0 || (int)(p_state->next_release - next) < 0)
+    {
+      next = p_state->next_release;
+    }
+  }
+  if ((int)(next - D_EDF_RUN_TICKS) >= 0)
+  {
+    /* no more releases - the last task ends the run once the jobs are done */
+    isr_write_timecmp(D_EDF_TIMECMP_NEVER);
+    semaphore_give(&g_edf_done_sem);
+  }
+  else
+  {
+    isr_write_timecmp(g_edf_base + next);
+  }
+  M_READ_CYCLE_COUNTER_END(end);
+
+  g_edf_release_sum += end - start;
+  g_edf_release_irqs++;
+}
+
+/*
+ * Periodic task - runs every job released since it last waited; a job
+ * finishing after its deadline is a miss
+ */
+void edf_task_func(void)
+{
+  unsigned int id;
+  taskCB_t* p_task;
+  edfTask_t* p_state;
+
+  /* the switch that first runs a task has interrupts masked */
+  M_ENABLE_INTERRUPTS();
+  /* the tasks start in creation order */
+  id = g_edf_next_id++;
+  p_task = &g_edf_tasks[id];
+  p_state = &g_edf_task_state[id];
+  while (1)
+  {
+    semaphore_take(&g_edf_sems[id], D_WAIT_FOREVER);
+    /* late jobs run back to back */
+    while (p_state->done != p_state->released)
+    {
+      edf_work(p_state->loops);
+      g_edf_misses += ((int)(edf_time() - p_task->deadline) > 0);
+      g_edf_jobs++;
+      p_state->done++;
+      /* deadline of the next job - the running task is in no ready
+         structure, its key may change */
+      p_task->deadline += p_state->period;
+    }
+  }
+}
+
+/*
+ * Last task - the lowest priority and the latest deadline, runs once the
+ * releases stopped and every job is done
+ */
+void edf_last_task_func(void)
+{
+  M_ENABLE_INTERRUPTS();
+  semaphore_take(&g_edf_done_sem, D_WAIT_FOREVER);
+  /* no more interrupts - back to the benchmark */
+  M_WRITE_CSR(mie, 0);
+  return_to_main();
+}
+
+/*
+ * Measure the job loop against mtime
+ */
+static void
+edf_calibrate(void)
+{
+  unsigned long long start, ticks;
+
+  start = edf_read_mtime();
+  edf_work(D_EDF_CALIB_LOOPS);
+  ticks = edf_read_mtime() - start;
+  if (ticks == 0)
+  {
+    g_edf_errors++;
+    ticks = 1;
+  }
+  g_edf_loops_per_ktick = (unsigned int)((D_EDF_CALIB_LOOPS*1000ULL)/ticks);
+}
+
+/*
+ * Run task set set at utilization util percent in a mode
+ */
+static void
+edf_run(unsigned int mode, unsigned int util, unsigned int set)
+{
+  unsigned int i, j, seed = set + 1, weight_sum = 0, priority;
+  unsigned int weights[D_EDF_NUM_OF_TASKS];
+  unsigned long long wcet;
+  edfTask_t* p_state;
+
+  init_scheduler();
+  sched_init(D_SCHED_POLICY_FP + mode);
+  g_edf_next_id = 0;
+
+  /* periods and weights of the set - lcg, same set on every run */
+  for (i = 0 ; i < D_EDF_NUM_OF_TASKS ; i++)
+  {
+    seed = seed*1664525 + 1013904223;
+    g_edf_task_state[i].period = D_EDF_PERIOD_MIN + (seed >> 8) % (D_EDF_PERIOD_MAX - D_EDF_PERIOD_MIN + 1);
+    seed = seed*1664525 + 1013904223;
+    weights[i] = 1 + (seed >> 8) % 16;
+    weight_sum += weights[i];
+  }
+
+  for (i = 0 ; i < D_EDF_NUM_OF_TASKS ; i++)
+  {
+    p_state = &g_edf_task_state[i];
+    /* execution time - the task share of the utilization */
+    wcet = ((unsigned long long)util*p_state->period*weights[i])/(100*weight_sum);
+    p_state->loops = (unsigned int)((wcet*g_edf_loops_per_ktick)/1000);
+    p_state->next_release = D_EDF_START_TICKS;
+    p_state->released = 0;
+    p_state->done = 0;
+    /* rate monotonic - the shorter the period the higher the priority */
+    priority = 0;
+    for (j = 0 ; j < D_EDF_NUM_OF_TASKS ; j++)
+    {
+      if (g_edf_task_state[j].period < p_state->period ||
+          (g_edf_task_state[j].period == p_state->period && j < i))
+      {
+        priority++;
+      }
+    }
+    init_semaphore(&g_edf_sems[i]);
+    init_task(&g_edf_tasks[i], edf_task_func, edf_task_stacks[i], D_EDF_STACK_SIZE);
+    g_edf_tasks[i].deadline = D_EDF_START_TICKS + p_state->period;
+    g_edf_tasks[i].priority = priority;
+    sched_add_ready(&g_edf_tasks[i]);
+  }
+  init_semaphore(&g_edf_done_sem);
+  init_task(&g_edf_last_task, edf_last_task_func, edf_last_stack, D_EDF_STACK_SIZE);
+  g_edf_last_task.deadline = D_EDF_LAST_DEADLINE;
+  g_edf_last_task.priority = D_EDF_LAST_PRIORITY;
+  sched_add_ready(&g_edf_last_task);
+
+  g_edf_jobs = 0;
+  g_edf_misses = 0;
+  g_edf_insert_sum = 0;
+  g_edf_inserts = 0;
+  g_edf_select_sum = 0;
+  g_edf_selects = 0;
+  g_edf_release_sum = 0;
+  g_edf_release_irqs = 0;
+  g_isr_nesting = 0;
+  g_isr_reschedule = 0;
+  g_switch_committed = 0;
+  /* the tasks wait for the first release */
+  g_edf_base = edf_read_mtime();
+  isr_write_timecmp(g_edf_base + D_EDF_START_TICKS);
+  M_WRITE_CSR(mie, D_EDF_MIE_MTIE);
+  invoke_first_task();
+
+  for (i = 0 ; i < D_EDF_NUM_OF_TASKS ; i++)
+  {
+    g_edf_errors += (g_edf_task_state[i].done != g_edf_task_state[i].released);
+  }
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(&g_edf_tasks[0], &g_edf_stack_usage);
+#endif /* D_STACK_WATERMARK */
+}
+
+/*
+ * EDF benchmark - both modes, every utilization, every task set
+ */
+void
+edf_benchmark(void)
+{
+  unsigned int mode, i, set;
+  unsigned long mtvec, mstatus;
+  unsigned int jobs, misses, insert_sum, inserts, select_sum, selects, release_sum, release_irqs;
+  edfResult_t* p_result;
+
+  g_edf_errors = 0;
+  g_isr_timer_handler = edf_release_handler;
+  M_READ_CSR(mtvec, mtvec);
+  M_READ_CSR(mstatus, mstatus);
+  M_WRITE_CSR(mtvec, isr_trap_handler);
+  /* the first task starts with the interrupts of main */
+  M_WRITE_CSR(mstatus, mstatus | D_EDF_MSTATUS_MIE);
+  edf_calibrate();
+
+  for (mode = 0 ; mode < D_EDF_NUM_OF_MODES ; mode++)
+  {
+    for (i = 0 ; i < D_EDF_NUM_OF_UTILS ; i++)
+    {
+      jobs = misses = insert_sum = inserts = select_sum = selects = release_sum = release_irqs = 0;
+      for (set = 0 ; set < D_EDF_NUM_OF_SETS ; set++)
+      {
+        edf_run(mode, D_EDF_MIN_UTIL + i*D_EDF_UTIL_STEP, set);
+        jobs += g_edf_jobs;
+        misses += g_edf_misses;
+        insert_sum += g_edf_insert_sum;
+        inserts += g_edf_inserts;
+        select_sum += g_edf_select_sum;
+        selects += g_edf_selects;
+        release_sum += g_edf_release_sum;
+        release_irqs += g_edf_release_irqs;
+      }
+      g_edf_errors += (jobs == 0 || inserts == 0 || selects == 0 || release_irqs == 0);
+      p_result = &g_edf_results[mode][i];
+      p_result->utilization = D_EDF_MIN_UTIL + i*D_EDF_UTIL_STEP;
+      p_result->jobs = jobs;
+      p_result->misses = misses;
+      p_result->miss_permille = jobs ? (misses*1000)/jobs : 0;
+      p_result->insert_cycles = inserts ? insert_sum/inserts : 0;
+      p_result->select_cycles = selects ? select_sum/selects : 0;
+      p_result->release_cycles = release_irqs ? release_sum/release_irqs : 0;
+    }
+  }
+
+  /* back to the FIFO ready list */
+  g_sched_policy = D_SCHED_POLICY_FIFO;
+  M_WRITE_CSR(mtvec, mtvec);
+  M_WRITE_CSR(mstatus, mstatus);
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
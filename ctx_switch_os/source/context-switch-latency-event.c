@@ -0,0 +1,156 @@
+
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#elif defined(D_ARM)
+ #include "context-switch-latency-port-arm.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+
+/*
+ * Event broadcast benchmark - N tasks pend the same event group and a
+ * setter task releases them all with a single event_set. Waiters alternate
+ * between D_OR and D_AND conditions so both paths are evaluated. Measured
+ * from the event_set call to the first and to the last released task.
+ */
+
+#define D_EVT_MAX_WAITERS     64
+#define D_EVT_NUM_OF_COUNTS   7
+#define D_EVT_OR_BITS         0x1
+#define D_EVT_AND_BITS        0x3
+
+/* measurement results of a single waiter count */
+typedef struct eventResult
+{
+  /* number of tasks pending the event */
+  unsigned int num_of_waiters;
+  /* number of tasks released by event_set */
+  unsigned int num_of_woken;
+  /* cpu cycles from event_set to the first released task */
+  unsigned int cycles_to_first_waiter;
+  /* cpu cycles from event_set to the last released task */
+  unsigned int cycles_to_last_waiter;
+}eventResult_t;
+
+/* tasks handlers functions */
+static void evt_waiter_func(void);
+static void evt_setter_func(void);
+
+/* benchmark results */
+/* volatile - only written here, read by the debugger (kept with LTO) */
+volatile eventResult_t g_event_broadcast_results[D_EVT_NUM_OF_COUNTS];
+unsigned int g_event_broadcast_errors;
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_event_stack_usage_waiter;
+stackUsage_t g_event_stack_usage_setter;
+#endif /* D_STACK_WATERMARK */
+
+static const unsigned int g_evt_waiter_counts[D_EVT_NUM_OF_COUNTS] = { 1, 2, 4, 8, 16, 32, 64 };
+
+/* tasks and stacks */
+unsigned int evt_waiter_stacks[D_EVT_MAX_WAITERS][D_STACK_SIZE];
+unsigned int evt_setter_stack[D_STACK_SIZE];
+static taskCB_t g_evt_waiter_tasks[D_EVT_MAX_WAITERS];
+static taskCB_t g_evt_setter_task;
+
+static eventCB_t     g_evt_event;
+/* never given - released tasks park on it */
+static semaphoreCB_t g_evt_parking_sem;
+
+static unsigned int g_evt_woken;
+static volatile cycles_t g_evt_cycles_start, g_evt_cycles_first, g_evt_cycles_last;
+
+/*
+ * Waiter task - pend the event, record the release time and park
+ */
+void evt_waiter_func(void)
+{
+  cycles_t cycles;
+  unsigned int bits;
+
+  /* odd waiters need all bits, even waiters need any bit */
+  if ((g_p_current_task - g_evt_waiter_tasks) & 1)
+  {
+    bits = event_get(&g_evt_event, D_EVT_AND_BITS, D_AND, D_WAIT_FOREVER);
+    g_event_broadcast_errors += (bits != D_EVT_AND_BITS);
+  }
+  else
+  {
+    bits = event_get(&g_evt_event, D_EVT_OR_BITS, D_OR, D_WAIT_FOREVER);
+    g_event_broadcast_errors += (bits != D_EVT_OR_BITS);
+  }
+
+  /* read cpu cycle - this task was released */
+  M_READ_CYCLE_COUNTER(cycles);
+  if (g_evt_woken == 0)
+  {
+    g_evt_cycles_first = cycles;
+  }
+  g_evt_cycles_last = cycles;
+  g_evt_woken++;
+
+  /* park for the rest of the measurement */
+  semaphore_take(&g_evt_parking_sem, D_WAIT_FOREVER);
+}
+
+/*
+ * Setter task - runs once all waiters pend the event
+ */
+void evt_setter_func(void)
+{
+  /* read cpu cycle - start measure event_set */
+  M_READ_CYCLE_COUNTER(g_evt_cycles_start);
+  event_set(&g_evt_event, D_EVT_AND_BITS);
+  /* all released tasks ran before the setter is switched back in */
+  return_to_main();
+}
+
+void
+event_broadcast_benchmark(void)
+{
+  unsigned int i, j, num_of_waiters;
+
+  g_event_broadcast_errors = 0;
+
+  for (i = 0 ; i < D_EVT_NUM_OF_COUNTS ; i++)
+  {
+    num_of_waiters = g_evt_waiter_counts[i];
+
+    init_event(&g_evt_event);
+    init_semaphore(&g_evt_parking_sem);
+    g_evt_woken = 0;
+
+    /* waiters run first and pend the event, the setter runs last */
+    init_scheduler();
+    for (j = 0 ; j < num_of_waiters ; j++)
+    {
+      init_task(&g_evt_waiter_tasks[j], evt_waiter_func, evt_waiter_stacks[j], D_STACK_SIZE);
+      add_task_to_list(&ready_tasks_list, &g_evt_waiter_tasks[j]);
+    }
+    init_task(&g_evt_setter_task, evt_setter_func, evt_setter_stack, D_STACK_SIZE);
+    add_task_to_list(&ready_tasks_list, &g_evt_setter_task);
+    invoke_first_task();
+
+#ifdef D_STACK_WATERMARK
+    for (j = 0 ; j < num_of_waiters ; j++)
+    {
+      update_task_stack_usage(&g_evt_waiter_tasks[j], &g_event_stack_usage_waiter);
+    }
+    update_task_stack_usage(&g_evt_setter_task, &g_event_stack_usage_setter);
+#endif /* D_STACK_WATERMARK */
+
+    g_event_broadcast_results[i].num_of_waiters = num_of_waiters;
+    g_event_broadcast_results[i].num_of_woken = g_evt_woken;
+    g_event_broadcast_results[i].cycles_to_first_waiter = g_evt_cycles_first - g_evt_cycles_start;
+    g_event_broadcast_results[i].cycles_to_last_waiter = g_evt_cycles_last - g_evt_cycles_start;
+    g_event_broadcast_errors += (g_evt_woken != num_of_waiters);
+  }
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,340 @@
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+#include "context-switch-latency-trace.h"
+#include "context-switch-latency-isr.h"
+
+/*
+ * Deferred switch benchmark - a burst of 1 to 8 software interrupts (CLINT
+ * msip, raised again by the isr until the burst is done), each giving the
+ * semaphore of its own task. The primitives only mark the reschedule and
+ * the switch is done either
+ *   exit   - by isr_switch on the way out of every isr, or
+ *   pended - in a pended interrupt taken after the whole burst. RISC-V
+ *            takes the machine interrupts in a fixed order (external,
+ *            software, timer), so the lowest priority one is the timer,
+ *            pended by writing mtimecmp 0; the burst is coalesced into a
+ *            single switch.
+ * Per mode and burst size it reports the cycles from the end of an isr to
+ * the task it woke running, the cycles of the whole burst and the switches
+ * done from interrupt context.
+ */
+
+#define D_ISR_MAX_BURST        8
+/* bursts of 1, 2, 4, 8 interrupts */
+#define D_ISR_NUM_OF_BURSTS    4
+#define D_ISR_NUM_OF_ROUNDS    8
+/* task stack in words - an isr frame and a switch on top of the task */
+#define D_ISR_STACK_SIZE       (4*D_STACK_SIZE)
+
+/* deferred switch modes */
+#define D_ISR_EXIT             0
+#define D_ISR_PENDED           1
+#define D_ISR_NUM_OF_MODES     2
+
+/* CLINT msip and mtimecmp of hart 0 */
+#ifndef D_ISR_CLINT_MSIP
+#define D_ISR_CLINT_MSIP       0x02000000
+#endif /* D_ISR_CLINT_MSIP */
+#ifndef D_ISR_CLINT_MTIMECMP
+#define D_ISR_CLINT_MTIMECMP   0x02004000
+#endif /* D_ISR_CLINT_MTIMECMP */
+/* mtimecmp - never reached, due at once */
+#define D_ISR_TIMECMP_NEVER    0xFFFFFFFFFFFFFFFFULL
+#define D_ISR_TIMECMP_NOW      0
+/* mcause of the software and timer interrupts */
+#define D_ISR_MCAUSE_INT       (1UL << (__riscv_xlen - 1))
+#define D_ISR_MCAUSE_MSI       (D_ISR_MCAUSE_INT | 3)
+#define D_ISR_MCAUSE_MTI       (D_ISR_MCAUSE_INT | 7)
+/* mie.MSIE and mie.MTIE, mstatus.MIE */
+#define D_ISR_MIE_MSIE         0x8
+#define D_ISR_MIE_MTIE         0x80
+#define D_ISR_MSTATUS_MIE      0x8
+
+/* a burst size in one mode - averages over D_ISR_NUM_OF_ROUNDS bursts */
+typedef struct isrDeferResult
+{
+  /* interrupts in the burst - a task woken by each */
+  unsigned int burst;
+  /* cpu cycles from the end of an isr to the task it woke running */
+  unsigned int exit_to_task_cycles;
+  /* cpu cycles from raising the burst to the last woken task running */
+  unsigned int burst_cycles;
+  /* switches done from interrupt context per burst */
+  unsigned int isr_switches;
+}isrDeferResult_t;
+
+/* tasks handlers functions */
+static void isr_woken_task_func(void);
+static void isr_trigger_task_func(void);
+
+/* benchmark results - [mode][burst size] */
+isrDeferResult_t g_isr_results[D_ISR_NUM_OF_MODES][D_ISR_NUM_OF_BURSTS];
+unsigned int g_isr_errors;
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_isr_stack_usage;
+#endif /* D_STACK_WATERMARK */
+void (*g_isr_timer_handler)(void);
+
+/* woken tasks and the task raising the bursts */
+static taskCB_t g_isr_tasks[D_ISR_MAX_BURST];
+static taskCB_t g_isr_trigger_task;
+unsigned int isr_task_stacks[D_ISR_MAX_BURST][D_ISR_STACK_SIZE];
+unsigned int isr_trigger_stack[D_ISR_STACK_SIZE];
+/* a semaphore per woken task, the last one gives the done semaphore */
+static semaphoreCB_t g_isr_sems[D_ISR_MAX_BURST];
+static semaphoreCB_t g_isr_done_sem;
+
+static unsigned int g_isr_mode;
+static unsigned int g_isr_burst;
+static unsigned int g_isr_next_id;
+static volatile unsigned int g_isr_burst_index;
+static unsigned int g_isr_woken;
+static unsigned int g_isr_latency_sum, g_isr_burst_sum, g_isr_switch_sum;
+static volatile cycles_t g_isr_exit_cycles[D_ISR_MAX_BURST];
+static volatile cycles_t g_isr_burst_start, g_isr_burst_end;
+
+/*
+ * Write mtimecmp of hart 0 - the high word is parked at its max while the
+ * low word changes, so no interrupt is raised by a value in between
+ */
+void
+isr_write_timecmp(unsigned long long value)
+{
+  volatile unsigned int *p_timecmp = (volatile unsigned int*)D_ISR_CLINT_MTIMECMP;
+
+  p_timecmp[1] = 0xFFFFFFFF;
+  p_timecmp[0] = (unsigned int)value;
+  p_timecmp[1] = (unsigned int)(value >> 32);
+}
+
+/*
+ * Raise or clear the software interrupt of hart 0
+ */
+static void
+isr_write_msip(unsigned int value)
+{
+  volatile unsigned int *p_msip = (volatile unsigned int*)D_ISR_CLINT_MSIP;
+
+  *p_msip = value;
+}
+
+/*
+ * Interrupt of the burst - wake the task of this interrupt
+ */
+static void
+isr_burst_handler(void)
+{
+  unsigned int id = g_isr_burst_index++;
+
+  isr_write_msip(0);
+  if (id >= g_isr_burst)
+  {
+    g_isr_errors++;
+    return;
+  }
+  /* the next interrupt of the burst is taken once interrupts are enabled */
+  if (id + 1 < g_isr_burst)
+  {
+    isr_write_msip(1);
+  }
+  /* from an isr - marks the reschedule only */
+  semaphore_give(&g_isr_sems[id]);
+  M_READ_CYCLE_COUNTER(g_isr_exit_cycles[id]);
+}
+
+/*
+ * Pended interrupt - clear it, the switch is done on its way out
+ */
+static void
+isr_pended_handler(void)
+{
+  isr_write_timecmp(D_ISR_TIMECMP_NEVER);
+}
+
+/*
+ * Interrupt dispatch - called by isr_trap_handler with the interrupted
+ * context saved on its stack and interrupts masked
+ * mcause - trap cause
+ */
+void
+isr_dispatch(unsigned long mcause)
+{
+  g_isr_nesting++;
+  M_TRACE_ISR_ENTER(mcause & 0xFF);
+  if (mcause == D_ISR_MCAUSE_MSI)
+  {
+    isr_burst_handler();
+  }
+  else if (mcause == D_ISR_MCAUSE_MTI)
+  {
+    g_isr_timer_handler();
+  }
+  else
+  {
+    g_isr_errors++;
+  }
+  M_TRACE_ISR_EXIT(mcause & 0xFF);
+  g_isr_nesting--;
+
+  /* the outermost isr made tasks ready - pend the switch of a burst
+     interrupt in the pended mode, switch now otherwise */
+  if (g_isr_nesting == 0 && g_isr_reschedule != 0)
+  {
+    if (g_isr_mode == D_ISR_PENDED && mcause == D_ISR_MCAUSE_MSI)
+    {
+      isr_write_timecmp(D_ISR_TIMECMP_NOW);
+    }
+    else
+    {
+      isr_switch();
+    }
+  }
+}
+
+/*
+ * Woken task - waits on its semaphore, given by the interrupt of the
+ * burst with its id
+ */
+void isr_woken_task_func(void)
+{
+  unsigned int id;
+  cycles_t now;
+
+  /* the switch that first runs a task has interrupts masked */
+  M_ENABLE_INTERRUPTS();
+  /* the tasks start in creation order */
+  id = g_isr_next_id++;
+  while (1)
+  {
+    semaphore_take(&g_isr_sems[id], D_WAIT_FOREVER);
+    M_READ_CYCLE_COUNTER(now);
+    g_isr_latency_sum += now - g_isr_exit_cycles[id];
+    /* the last task of the burst ends it */
+    if (++g_isr_woken == g_isr_burst)
+    {
+      M_READ_CYCLE_COUNTER(g_isr_burst_end);
+      semaphore_give(&g_isr_done_sem);
+    }
+  }
+}
+
+/*
+ * Trigger task - raises D_ISR_NUM_OF_ROUNDS bursts, each once the last
+ * one is done
+ */
+void isr_trigger_task_func(void)
+{
+  unsigned int round, switches;
+
+  M_ENABLE_INTERRUPTS();
+  for (round = 0 ; round < D_ISR_NUM_OF_ROUNDS ; round++)
+  {
+    g_isr_burst_index = 0;
+    g_isr_woken = 0;
+    switches = g_isr_switches;
+    M_READ_CYCLE_COUNTER(g_isr_burst_start);
+    isr_write_msip(1);
+    /* wait for the last woken task */
+    semaphore_take(&g_isr_done_sem, D_WAIT_FOREVER);
+    g_isr_burst_sum += g_isr_burst_end - g_isr_burst_start;
+    g_isr_switch_sum += g_isr_switches - switches;
+    g_isr_errors += (g_isr_woken != g_isr_burst);
+  }
+  /* no more interrupts - back to the benchmark */
+  M_WRITE_CSR(mie, 0);
+  return_to_main();
+}
+
+/*
+ * Run D_ISR_NUM_OF_ROUNDS bursts of burst interrupts in a mode
+ * p_result - averages per burst
+ */
+static void
+isr_run(unsigned int mode, unsigned int burst, isrDeferResult_t* p_result)
+{
+  unsigned int i;
+
+  g_isr_mode = mode;
+  g_isr_burst = burst;
+  g_isr_next_id = 0;
+  g_isr_latency_sum = 0;
+  g_isr_burst_sum = 0;
+  g_isr_switch_sum = 0;
+  init_scheduler();
+  for (i = 0 ; i < burst ; i++)
+  {
+    init_semaphore(&g_isr_sems[i]);
+    init_task(&g_isr_tasks[i], isr_woken_task_func, isr_task_stacks[i], D_ISR_STACK_SIZE);
+    add_task_to_list(&ready_tasks_list, &g_isr_tasks[i]);
+  }
+  /* the woken tasks wait on their semaphores before the first burst */
+  init_semaphore(&g_isr_done_sem);
+  init_task(&g_isr_trigger_task, isr_trigger_task_func, isr_trigger_stack, D_ISR_STACK_SIZE);
+  add_task_to_list(&ready_tasks_list, &g_isr_trigger_task);
+
+  g_isr_nesting = 0;
+  g_isr_reschedule = 0;
+  g_switch_committed = 0;
+  /* nothing pending until the first burst */
+  isr_write_timecmp(D_ISR_TIMECMP_NEVER);
+  isr_write_msip(0);
+  M_WRITE_CSR(mie, D_ISR_MIE_MSIE | D_ISR_MIE_MTIE);
+  invoke_first_task();
+
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(&g_isr_tasks[0], &g_isr_stack_usage);
+#endif /* D_STACK_WATERMARK */
+
+  p_result->burst = burst;
+  p_result->exit_to_task_cycles = g_isr_latency_sum/(D_ISR_NUM_OF_ROUNDS*burst);
+  p_result->burst_cycles = g_isr_burst_sum/D_ISR_NUM_OF_ROUNDS;
+  p_result->isr_switches = g_isr_switch_sum/D_ISR_NUM_OF_ROUNDS;
+}
+
+/*
+ * Deferred switch benchmark - both modes, every burst size
+ */
+void
+isr_defer_benchmark(void)
+{
+  unsigned int mode, i;
+  unsigned long mtvec, mstatus;
+
+  g_isr_errors = 0;
+  g_isr_timer_handler = isr_pended_handler;
+  M_READ_CSR(mtvec, mtvec);
+  M_READ_CSR(mstatus, mstatus);
+  M_WRITE_CSR(mtvec, isr_trap_handler);
+  /* the first task starts with the interrupts of main */
+  M_WRITE_CSR(mstatus, mstatus | D_ISR_MSTATUS_MIE);
+
+  for (mode = 0 ; mode < D_ISR_NUM_OF_MODES ; mode++)
+  {
+    for (i = 0 ; i < D_ISR_NUM_OF_BURSTS ; i++)
+    {
+      isr_run(mode, 1 << i, &g_isr_results[mode][i]);
+    }
+    /* pended - one switch per burst, whatever its size */
+    if (mode == D_ISR_PENDED)
+    {
+      for (i = 0 ; i < D_ISR_NUM_OF_BURSTS ; i++)
+      {
+        g_isr_errors += (g_isr_results[mode][i].isr_switches != 1);
+      }
+    }
+  }
+
+  M_WRITE_CSR(mtvec, mtvec);
+  M_WRITE_CSR(mstatus, mstatus);
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
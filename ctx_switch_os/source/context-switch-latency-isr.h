@@ -0,0 +1,59 @@
+#ifndef __CONTEXT_SWITCH_LATENCY_ISR_H__
+#define __CONTEXT_SWITCH_LATENCY_ISR_H__
+
+/*
+ * Deferred switch from interrupt context (D_ISR_DEFER). A primitive called
+ * from an isr (g_isr_nesting != 0) makes the woken tasks ready and only
+ * marks a reschedule; isr_switch does the switch once for every wake up,
+ * either on the way out of the outermost isr or in a pended lowest
+ * priority interrupt. An isr may only call the primitives which don't
+ * block.
+ * A task is committed to a switch of its own from the moment it queued
+ * itself on a ready or wait list until select_next_task runs for it; an
+ * isr hitting that window leaves the switch to the task. The tasks switch
+ * with interrupts masked and restore them once switched back in, so a
+ * task switched in from an isr runs with the interrupts it had.
+ */
+
+#ifdef D_ISR_DEFER
+/* isrs running - the trap dispatch counts them */
+extern volatile unsigned int g_isr_nesting;
+/* a primitive called from an isr made tasks ready */
+extern volatile unsigned int g_isr_reschedule;
+/* the running task queued itself and is about to switch */
+extern volatile unsigned int g_switch_committed;
+/* switches done by isr_switch */
+extern unsigned int g_isr_switches;
+/* timer interrupt handler of the running benchmark */
+extern void (*g_isr_timer_handler)(void);
+
+void isr_switch(void);
+/* functions implemented in context-switch-latency-rv.S */
+void isr_trap_handler(void);
+/* functions implemented in context-switch-latency-isr.c */
+void isr_write_timecmp(unsigned long long value);
+
+/*
+ * Switch from a task - interrupts masked across the switch, restored once
+ * the task is switched back in
+ */
+static inline void
+isr_task_switch(void)
+{
+  unsigned int int_state;
+
+  M_DISABLE_INTERRUPTS(int_state);
+  context_switch();
+  M_RESTORE_INTERRUPTS(int_state);
+}
+
+  #define M_IN_ISR()           (g_isr_nesting != 0)
+  #define M_SWITCH_COMMIT()    g_switch_committed = 1
+  #define M_CONTEXT_SWITCH()   isr_task_switch()
+#else
+  #define M_IN_ISR()           0
+  #define M_SWITCH_COMMIT()
+  #define M_CONTEXT_SWITCH()   context_switch()
+#endif /* D_ISR_DEFER */
+
+#endif /* __CONTEXT_SWITCH_LATENCY_ISR_H__ */
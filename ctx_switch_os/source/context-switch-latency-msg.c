@@ -0,0 +1,274 @@
+
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#elif defined(D_ARM)
+ #include "context-switch-latency-port-arm.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+
+/*
+ * Message passing benchmark - a producer task sends D_MSG_NUM_OF_MSGS
+ * messages to a consumer task, either by copying the payload into the
+ * queue or by passing a pointer to a pool block (ownership transfer).
+ * Each mode is measured with one item per switch and with a batch of
+ * D_MSG_BATCH items per switch.
+ */
+
+#define D_MSG_NUM_OF_MSGS     64
+#define D_MSG_MAX_PAYLOAD     4096
+#define D_MSG_NUM_OF_SIZES    6
+#define D_MSG_QUEUE_DEPTH     4
+#define D_MSG_BATCH           D_MSG_QUEUE_DEPTH
+/* blocks in flight: a full queue plus the batch being composed */
+#define D_MSG_POOL_BLOCKS     (D_MSG_QUEUE_DEPTH + D_MSG_BATCH)
+/* producer/consumer stack - deeper call chain than the primitives benchmark */
+#define D_MSG_STACK_SIZE      (2*D_STACK_SIZE)
+#define D_MSG_COPY            0
+#define D_MSG_ZERO_COPY       1
+
+/* measurement results of a single payload size */
+typedef struct msgResult
+{
+  /* payload size in bytes */
+  unsigned int payload_size;
+  /* cpu cycles per message - producer compose to consumer done */
+  unsigned int cycles_per_msg;
+  /* messages per second at D_CORE_CLOCK_HZ */
+  unsigned int msgs_per_sec;
+  /* payload bytes moved per 1000 cpu cycles */
+  unsigned int bytes_per_kcycle;
+}msgResult_t;
+
+/* tasks handlers functions */
+static void msg_producer_func(void);
+static void msg_consumer_func(void);
+
+/* benchmark results */
+msgResult_t g_msg_copy_results[D_MSG_NUM_OF_SIZES];
+msgResult_t g_msg_copy_batch_results[D_MSG_NUM_OF_SIZES];
+msgResult_t g_msg_zero_copy_results[D_MSG_NUM_OF_SIZES];
+msgResult_t g_msg_zero_copy_batch_results[D_MSG_NUM_OF_SIZES];
+unsigned int g_msg_errors;
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_msg_stack_usage_producer;
+stackUsage_t g_msg_stack_usage_consumer;
+#endif /* D_STACK_WATERMARK */
+
+static const unsigned int g_msg_payload_sizes[D_MSG_NUM_OF_SIZES] = { 4, 16, 64, 256, 1024, 4096 };
+
+/* tasks stack */
+unsigned int msg_producer_stack[D_MSG_STACK_SIZE];
+unsigned int msg_consumer_stack[D_MSG_STACK_SIZE];
+
+/* queue, pool and producer/consumer buffers */
+static unsigned int msg_queue_storage[D_MSG_QUEUE_DEPTH*D_MSG_MAX_PAYLOAD/sizeof(unsigned int)];
+static unsigned int msg_pool_storage[D_MSG_POOL_BLOCKS*D_MSG_MAX_PAYLOAD/sizeof(unsigned int)];
+static unsigned int msg_tx_buffer[D_MSG_BATCH*D_MSG_MAX_PAYLOAD/sizeof(unsigned int)];
+static unsigned int msg_rx_buffer[D_MSG_MAX_PAYLOAD/sizeof(unsigned int)];
+
+static msgQueueCB_t g_msg_queue;
+static memPoolCB_t g_msg_pool;
+static taskCB_t    g_msg_producer_task, g_msg_consumer_task;
+
+/* current measurement configuration */
+static unsigned int g_msg_mode, g_msg_batch, g_msg_payload_words;
+static volatile cycles_t g_msg_cycles_start, g_msg_cycles_end;
+
+/*
+ * Compose a message payload
+ * p_msg - payload to fill
+ * num_of_words - payload size in words
+ * seq - message sequence number
+ */
+static void
+msg_fill(unsigned int* p_msg, unsigned int num_of_words, unsigned int seq)
+{
+  unsigned int i;
+
+  for (i = 0 ; i < num_of_words ; i++)
+  {
+    p_msg[i] = seq + i;
+  }
+}
+
+/*
+ * Consume a message payload and verify it
+ * p_msg - payload to read
+ * num_of_words - payload size in words
+ * seq - expected message sequence number
+ * return 0 if the payload is as composed by msg_fill
+ */
+static unsigned int
+msg_consume(unsigned int* p_msg, unsigned int num_of_words, unsigned int seq)
+{
+  unsigned int i, sum = 0;
+
+  for (i = 0 ; i < num_of_words ; i++)
+  {
+    sum += p_msg[i];
+  }
+
+  return sum != (num_of_words*seq + num_of_words*(num_of_words - 1)/2);
+}
+
+/*
+ * Producer task - compose and send all messages
+ */
+void msg_producer_func(void)
+{
+  unsigned int sent, i;
+  unsigned int *p_msg;
+  void *p_blocks[D_MSG_BATCH];
+
+  /* read cpu cycle - start measure */
+  M_READ_CYCLE_COUNTER(g_msg_cycles_start);
+
+  for (sent = 0 ; sent < D_MSG_NUM_OF_MSGS ; sent += g_msg_batch)
+  {
+    /* compose a batch of messages */
+    for (i = 0 ; i < g_msg_batch ; i++)
+    {
+      if (g_msg_mode == D_MSG_COPY)
+      {
+        /* compose in the producer buffer - the queue copies it */
+        p_msg = msg_tx_buffer + i*g_msg_payload_words;
+      }
+      else
+      {
+        /* compose straight in a pool block - the queue passes its address */
+        p_msg = pool_alloc(&g_msg_pool);
+        if (p_msg == 0)
+        {
+          g_msg_errors++;
+          return_to_main();
+        }
+        p_blocks[i] = p_msg;
+      }
+      msg_fill(p_msg, g_msg_payload_words, sent + i);
+    }
+
+    /* send the batch - the consumer is switched in once per batch */
+    if (g_msg_mode == D_MSG_COPY)
+    {
+      msg_queue_send_batch(&g_msg_queue, msg_tx_buffer, g_msg_batch);
+    }
+    else
+    {
+      msg_queue_send_batch(&g_msg_queue, p_blocks, g_msg_batch);
+    }
+  }
+
+  /* the consumer returns to main once all messages are consumed */
+  while (1)
+  {
+    task_yield();
+  }
+}
+
+/*
+ * Consumer task - receive and consume all messages
+ */
+void msg_consumer_func(void)
+{
+  unsigned int received;
+  unsigned int *p_msg;
+
+  for (received = 0 ; received < D_MSG_NUM_OF_MSGS ; received++)
+  {
+    if (g_msg_mode == D_MSG_COPY)
+    {
+      /* copy the payload out of the queue */
+      msg_queue_receive(&g_msg_queue, msg_rx_buffer, D_WAIT_FOREVER);
+      p_msg = msg_rx_buffer;
+    }
+    else
+    {
+      /* take ownership of the producer block */
+      msg_queue_receive(&g_msg_queue, &p_msg, D_WAIT_FOREVER);
+    }
+
+    g_msg_errors += msg_consume(p_msg, g_msg_payload_words, received);
+
+    if (g_msg_mode == D_MSG_ZERO_COPY)
+    {
+      /* the block goes back to the pool */
+      pool_free(&g_msg_pool, p_msg);
+    }
+  }
+
+  /* read cpu cycle - end measure */
+  M_READ_CYCLE_COUNTER(g_msg_cycles_end);
+  /* quit the measurement */
+  return_to_main();
+}
+
+/*
+ * Measure all payload sizes in a given mode
+ * mode - D_MSG_COPY or D_MSG_ZERO_COPY
+ * batch - number of items sent per switch (divides D_MSG_NUM_OF_MSGS)
+ * p_results - D_MSG_NUM_OF_SIZES results
+ */
+static void
+msg_measure(unsigned int mode, unsigned int batch, msgResult_t* p_results)
+{
+  unsigned int i, cycles;
+
+  for (i = 0 ; i < D_MSG_NUM_OF_SIZES ; i++)
+  {
+    g_msg_mode = mode;
+    g_msg_batch = batch;
+    g_msg_payload_words = g_msg_payload_sizes[i]/sizeof(unsigned int);
+
+    if (mode == D_MSG_COPY)
+    {
+      /* queue items are the payload itself */
+      init_msg_queue(&g_msg_queue, msg_queue_storage, g_msg_payload_sizes[i], D_MSG_QUEUE_DEPTH);
+    }
+    else
+    {
+      /* queue items are pointers to pool blocks */
+      init_msg_queue(&g_msg_queue, msg_queue_storage, sizeof(void*), D_MSG_QUEUE_DEPTH);
+    }
+    init_pool(&g_msg_pool, msg_pool_storage, D_MSG_MAX_PAYLOAD, D_MSG_POOL_BLOCKS);
+
+    /* the consumer runs first and pends the empty queue */
+    init_scheduler();
+    init_task(&g_msg_consumer_task, msg_consumer_func, msg_consumer_stack, D_MSG_STACK_SIZE);
+    init_task(&g_msg_producer_task, msg_producer_func, msg_producer_stack, D_MSG_STACK_SIZE);
+    add_task_to_list(&ready_tasks_list, &g_msg_consumer_task);
+    add_task_to_list(&ready_tasks_list, &g_msg_producer_task);
+    invoke_first_task();
+
+#ifdef D_STACK_WATERMARK
+    update_task_stack_usage(&g_msg_producer_task, &g_msg_stack_usage_producer);
+    update_task_stack_usage(&g_msg_consumer_task, &g_msg_stack_usage_consumer);
+#endif /* D_STACK_WATERMARK */
+
+    cycles = g_msg_cycles_end - g_msg_cycles_start;
+    p_results[i].payload_size = g_msg_payload_sizes[i];
+    p_results[i].cycles_per_msg = cycles/D_MSG_NUM_OF_MSGS;
+    p_results[i].msgs_per_sec = p_results[i].cycles_per_msg ? D_CORE_CLOCK_HZ/p_results[i].cycles_per_msg : 0;
+    /* D_MSG_MAX_PAYLOAD*D_MSG_NUM_OF_MSGS*1000 fits in 32 bits */
+    p_results[i].bytes_per_kcycle = cycles ? (g_msg_payload_sizes[i]*D_MSG_NUM_OF_MSGS*1000)/cycles : 0;
+  }
+}
+
+void
+msg_passing_benchmark(void)
+{
+  g_msg_errors = 0;
+
+  msg_measure(D_MSG_COPY, 1, g_msg_copy_results);
+  msg_measure(D_MSG_COPY, D_MSG_BATCH, g_msg_copy_batch_results);
+  msg_measure(D_MSG_ZERO_COPY, 1, g_msg_zero_copy_results);
+  msg_measure(D_MSG_ZERO_COPY, D_MSG_BATCH, g_msg_zero_copy_batch_results);
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,512 @@
+
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+
+/*
+ * Isolated tasks - a task with a pmp region set gets its regions programmed
+ * when it is switched in, either rewriting all of its entries or only the
+ * entries that differ from the set loaded before. The benchmark measures
+ * the added switch cost vs the number of entries (1 to 16), and a task
+ * layout of code, data, stack and peripheral window encoded as NAPOT and
+ * as TOR regions.
+ * Cores without pmp (D_CORE_HAS_PMP not defined, e.g. EH1) write the
+ * entries to a RAM shadow, so only the kernel side of the cost is seen.
+ * Tasks run in machine mode, where unlocked entries aren't enforced -
+ * the regions cost the same to program whether enforced or not.
+ */
+
+#define D_PMP_NUM_OF_ROUNDS   16
+#define D_PMP_NUM_OF_COUNTS   5
+#define D_PMP_NUM_OF_CFGS     (D_PMP_MAX_ENTRIES/D_PMP_ENTRIES_PER_CFG)
+
+/* pmpcfg address matching */
+#define D_PMP_A_TOR           0x08
+#define D_PMP_A_NAPOT         0x18
+
+/* synthetic regions of the entries sweep - never accessed */
+#define D_PMP_SWEEP_BASE      0x00100000
+#define D_PMP_SWEEP_SIZE      0x1000
+/* address offset of a region that differs between the two tasks */
+#define D_PMP_SWEEP_OFFSET    0x00100000
+
+/* task layout - SweRVolf memory map by default */
+#ifndef D_PMP_CODE_BASE
+#define D_PMP_CODE_BASE       0x00000000
+#define D_PMP_CODE_SIZE       0x00010000
+#define D_PMP_DATA_BASE       0x00010000
+#define D_PMP_DATA_SIZE       0x00010000
+#define D_PMP_PERIPH_A_BASE   0x80001000
+#define D_PMP_PERIPH_B_BASE   0x80002000
+#define D_PMP_PERIPH_SIZE     0x00001000
+#endif /* D_PMP_CODE_BASE */
+
+/* pmpcfg registers covering num entries */
+#define M_PMP_NUM_OF_CFGS(num)  (((num) + D_PMP_ENTRIES_PER_CFG - 1)/D_PMP_ENTRIES_PER_CFG)
+
+/* switch cost vs number of pmp entries */
+typedef struct pmpSwitchResult
+{
+  /* pmp entries of each task */
+  unsigned int num_of_entries;
+  /* cpu cycles per switch - full rewrite */
+  unsigned int full_cycles;
+  /* cpu cycles per switch - diff rewrite, all entries differ */
+  unsigned int diff_all_cycles;
+  /* cpu cycles per switch - diff rewrite, one entry differs */
+  unsigned int diff_one_cycles;
+}pmpSwitchResult_t;
+
+/* switch cost of the task layout in a single encoding */
+typedef struct pmpEncodingResult
+{
+  /* pmp entries of each task */
+  unsigned int num_of_entries;
+  /* cpu cycles per switch - full rewrite */
+  unsigned int full_cycles;
+  /* cpu cycles per switch - diff rewrite */
+  unsigned int diff_cycles;
+}pmpEncodingResult_t;
+
+/* tasks handlers functions */
+static void pmp_measure_func(void);
+static void pmp_partner_func(void);
+
+/* benchmark results */
+/* cpu cycles per switch of tasks without pmp regions */
+unsigned int g_pmp_switch_base_cycles;
+pmpSwitchResult_t g_pmp_switch_results[D_PMP_NUM_OF_COUNTS];
+pmpEncodingResult_t g_pmp_napot_result;
+pmpEncodingResult_t g_pmp_tor_result;
+unsigned int g_pmp_errors;
+
+static const unsigned int g_pmp_entry_counts[D_PMP_NUM_OF_COUNTS] = { 1, 2, 4, 8, 16 };
+
+/* loaded regions - the diff rewrite compares against them */
+static pmpRegionSet_t* g_p_pmp_loaded;
+/* entries enabled by the loaded set */
+static unsigned int g_pmp_loaded_entries;
+static unsigned int g_pmp_strategy;
+#ifndef D_CORE_HAS_PMP
+/* pmp registers of cores without pmp */
+static volatile unsigned long g_pmp_shadow_addr[D_PMP_MAX_ENTRIES];
+static volatile unsigned long g_pmp_shadow_cfg[D_PMP_NUM_OF_CFGS];
+#endif /* D_CORE_HAS_PMP */
+
+/* tasks and stacks - aligned to their size for a NAPOT stack region */
+unsigned int pmp_measure_stack[D_STACK_SIZE] __attribute__ ((aligned (D_STACK_SIZE*4)));
+unsigned int pmp_partner_stack[D_STACK_SIZE] __attribute__ ((aligned (D_STACK_SIZE*4)));
+static taskCB_t g_pmp_measure_task, g_pmp_partner_task;
+static pmpRegionSet_t g_pmp_set_a, g_pmp_set_b;
+static volatile unsigned int g_pmp_measured;
+
+#ifdef D_CORE_HAS_PMP
+#define M_PMP_WRITE_ADDR_CASE(n)  case n: M_WRITE_CSR(pmpaddr##n, value); break;
+#define M_PMP_READ_ADDR_CASE(n)   case n: M_READ_CSR(pmpaddr##n, value); break;
+/* index - cfg register of the set; n - pmpcfg csr (even only on rv64) */
+#define M_PMP_WRITE_CFG_CASE(index, n)  case index: M_WRITE_CSR(pmpcfg##n, value); break;
+#define M_PMP_READ_CFG_CASE(index, n)   case index: M_READ_CSR(pmpcfg##n, value); break;
+#endif /* D_CORE_HAS_PMP */
+
+/*
+ * Write a pmpaddr register
+ */
+static inline void
+pmp_write_addr(unsigned int index, unsigned long value)
+{
+#ifdef D_CORE_HAS_PMP
+  switch (index)
+  {
+  M_PMP_WRITE_ADDR_CASE(0)  M_PMP_WRITE_ADDR_CASE(1)  M_PMP_WRITE_ADDR_CASE(2)  M_PMP_WRITE_ADDR_CASE(3)
+  M_PMP_WRITE_ADDR_CASE(4)  M_PMP_WRITE_ADDR_CASE(5)  M_PMP_WRITE_ADDR_CASE(6)  M_PMP_WRITE_ADDR_CASE(7)
+  M_PMP_WRITE_ADDR_CASE(8)  M_PMP_WRITE_ADDR_CASE(9)  M_PMP_WRITE_ADDR_CASE(10) M_PMP_WRITE_ADDR_CASE(11)
+  M_PMP_WRITE_ADDR_CASE(12) M_PMP_WRITE_ADDR_CASE(13) M_PMP_WRITE_ADDR_CASE(14) M_PMP_WRITE_ADDR_CASE(15)
+  }
+#else
+  g_pmp_shadow_addr[index] = value;
+#endif /* D_CORE_HAS_PMP */
+}
+
+/*
+ * Write a pmpcfg register (D_PMP_ENTRIES_PER_CFG entries each)
+ */
+static inline void
+pmp_write_cfg(unsigned int index, unsigned long value)
+{
+#ifdef D_CORE_HAS_PMP
+  switch (index)
+  {
+#if __riscv_xlen == 64
+  M_PMP_WRITE_CFG_CASE(0, 0) M_PMP_WRITE_CFG_CASE(1, 2)
+#else
+  M_PMP_WRITE_CFG_CASE(0, 0) M_PMP_WRITE_CFG_CASE(1, 1) M_PMP_WRITE_CFG_CASE(2, 2) M_PMP_WRITE_CFG_CASE(3, 3)
+#endif /* __riscv_xlen */
+  }
+#else
+  g_pmp_shadow_cfg[index] = value;
+#endif /* D_CORE_HAS_PMP */
+}
+
+static unsigned long
+pmp_read_addr(unsigned int index)
+{
+  unsigned long value = 0;
+
+#ifdef D_CORE_HAS_PMP
+  switch (index)
+  {
+  M_PMP_READ_ADDR_CASE(0)  M_PMP_READ_ADDR_CASE(1)  M_PMP_READ_ADDR_CASE(2)  M_PMP_READ_ADDR_CASE(3)
+  M_PMP_READ_ADDR_CASE(4)  M_PMP_READ_ADDR_CASE(5)  M_PMP_READ_ADDR_CASE(6)  M_PMP_READ_ADDR_CASE(7)
+  M_PMP_READ_ADDR_CASE(8)  M_PMP_READ_ADDR_CASE(9)  M_PMP_READ_ADDR_CASE(10) M_PMP_READ_ADDR_CASE(11)
+  M_PMP_READ_ADDR_CASE(12) M_PMP_READ_ADDR_CASE(13) M_PMP_READ_ADDR_CASE(14) M_PMP_READ_ADDR_CASE(15)
+  }
+#else
+  value = g_pmp_shadow_addr[index];
+#endif /* D_CORE_HAS_PMP */
+
+  return value;
+}
+
+static unsigned long
+pmp_read_cfg(unsigned int index)
+{
+  unsigned long value = 0;
+
+#ifdef D_CORE_HAS_PMP
+  switch (index)
+  {
+#if __riscv_xlen == 64
+  M_PMP_READ_CFG_CASE(0, 0) M_PMP_READ_CFG_CASE(1, 2)
+#else
+  M_PMP_READ_CFG_CASE(0, 0) M_PMP_READ_CFG_CASE(1, 1) M_PMP_READ_CFG_CASE(2, 2) M_PMP_READ_CFG_CASE(3, 3)
+#endif /* __riscv_xlen */
+  }
+#else
+  value = g_pmp_shadow_cfg[index];
+#endif /* D_CORE_HAS_PMP */
+
+  return value;
+}
+
+/*
+ * Empty a region set
+ */
+void
+pmp_init_set(pmpRegionSet_t* p_set)
+{
+  unsigned int i;
+
+  p_set->num_of_entries = 0;
+  for (i = 0 ; i < D_PMP_NUM_OF_CFGS ; i++)
+  {
+    p_set->cfg[i] = 0;
+  }
+}
+
+/*
+ * Append an entry to a region set
+ */
+static void
+pmp_add_entry(pmpRegionSet_t* p_set, unsigned long addr, unsigned long cfg)
+{
+  unsigned int index = p_set->num_of_entries++;
+
+  p_set->addr[index] = addr;
+  p_set->cfg[index/D_PMP_ENTRIES_PER_CFG] |= cfg << (8*(index % D_PMP_ENTRIES_PER_CFG));
+}
+
+/*
+ * Add a NAPOT region - a single entry
+ * p_base - region start, aligned to size
+ * size - power of 2, at least 8 bytes
+ * perm - D_PMP_R/W/X
+ * return the entries used, 0 if the set is full
+ */
+unsigned int
+pmp_add_napot(pmpRegionSet_t* p_set, void* p_base, unsigned int size, unsigned int perm)
+{
+  if (p_set->num_of_entries == D_PMP_MAX_ENTRIES)
+  {
+    return 0;
+  }
+
+  pmp_add_entry(p_set, ((unsigned long)p_base >> 2) | ((size >> 3) - 1), D_PMP_A_NAPOT | perm);
+
+  return 1;
+}
+
+/*
+ * Add a TOR region [p_base, p_top) - two entries, a single one when the
+ * region starts at 0 as the first entry or where the previous entry ends
+ * return the entries used, 0 if the set is full
+ */
+unsigned int
+pmp_add_tor(pmpRegionSet_t* p_set, void* p_base, void* p_top, unsigned int perm)
+{
+  unsigned long base = (unsigned long)p_base >> 2;
+  unsigned int entries = 1;
+  unsigned int num = p_set->num_of_entries;
+
+  /* the bottom comes from the previous entry address */
+  if ((num == 0 && base != 0) || (num != 0 && p_set->addr[num - 1] != base))
+  {
+    entries = 2;
+  }
+  if (num + entries > D_PMP_MAX_ENTRIES)
+  {
+    return 0;
+  }
+
+  if (entries == 2)
+  {
+    /* bottom only - off */
+    pmp_add_entry(p_set, base, 0);
+  }
+  pmp_add_entry(p_set, (unsigned long)p_top >> 2, D_PMP_A_TOR | perm);
+
+  return entries;
+}
+
+/*
+ * Program the regions of a task being switched in - called by
+ * select_next_task. The set mustn't change while it is loaded.
+ */
+void
+pmp_switch(pmpRegionSet_t* p_set)
+{
+  pmpRegionSet_t* p_loaded = g_p_pmp_loaded;
+  unsigned int i, num_of_entries = p_set->num_of_entries, num_of_cfgs;
+
+  if (p_set == p_loaded)
+  {
+    return;
+  }
+
+  /* entries the loaded set enabled are disabled as well */
+  num_of_cfgs = M_PMP_NUM_OF_CFGS(num_of_entries > g_pmp_loaded_entries ? num_of_entries : g_pmp_loaded_entries);
+
+  if (g_pmp_strategy == D_PMP_DIFF_REWRITE && p_loaded != 0)
+  {
+    for (i = 0 ; i < num_of_entries ; i++)
+    {
+      if (i >= p_loaded->num_of_entries || p_set->addr[i] != p_loaded->addr[i])
+      {
+        pmp_write_addr(i, p_set->addr[i]);
+      }
+    }
+    for (i = 0 ; i < num_of_cfgs ; i++)
+    {
+      if (p_set->cfg[i] != p_loaded->cfg[i])
+      {
+        pmp_write_cfg(i, p_set->cfg[i]);
+      }
+    }
+  }
+  else
+  {
+    for (i = 0 ; i < num_of_entries ; i++)
+    {
+      pmp_write_addr(i, p_set->addr[i]);
+    }
+    for (i = 0 ; i < num_of_cfgs ; i++)
+    {
+      pmp_write_cfg(i, p_set->cfg[i]);
+    }
+  }
+
+  g_p_pmp_loaded = p_set;
+  g_pmp_loaded_entries = num_of_entries;
+}
+
+/*
+ * Disable all entries - nothing loaded
+ */
+void
+pmp_reset(void)
+{
+  unsigned int i;
+
+  for (i = 0 ; i < D_PMP_NUM_OF_CFGS ; i++)
+  {
+    pmp_write_cfg(i, 0);
+  }
+  g_p_pmp_loaded = 0;
+  g_pmp_loaded_entries = 0;
+}
+
+/*
+ * Count the entries of a set that differ from the pmp registers
+ */
+static unsigned int
+pmp_verify(pmpRegionSet_t* p_set)
+{
+  unsigned int i, errors = 0;
+
+  for (i = 0 ; i < p_set->num_of_entries ; i++)
+  {
+    errors += (pmp_read_addr(i) != p_set->addr[i]);
+  }
+  for (i = 0 ; i < D_PMP_NUM_OF_CFGS ; i++)
+  {
+    errors += (pmp_read_cfg(i) != p_set->cfg[i]);
+  }
+
+  return errors;
+}
+
+/*
+ * Measuring task - yield to the partner and back D_PMP_NUM_OF_ROUNDS
+ * times, two switches per round
+ */
+void pmp_measure_func(void)
+{
+  cycles_t start, end;
+  unsigned int i;
+
+  /* first dispatch of the partner isn't measured */
+  task_yield();
+
+  M_READ_CYCLE_COUNTER(start);
+  for (i = 0 ; i < D_PMP_NUM_OF_ROUNDS ; i++)
+  {
+    task_yield();
+  }
+  M_READ_CYCLE_COUNTER(end);
+
+  g_pmp_measured = (end - start)/(2*D_PMP_NUM_OF_ROUNDS);
+  return_to_main();
+}
+
+void pmp_partner_func(void)
+{
+  while (1)
+  {
+    task_yield();
+  }
+}
+
+/*
+ * Measure the switch cost of two tasks with the given region sets
+ * p_set_a, p_set_b - regions of the tasks, 0 for no regions
+ * strategy - D_PMP_FULL_REWRITE or D_PMP_DIFF_REWRITE
+ * return cpu cycles per switch
+ */
+static unsigned int
+pmp_run(pmpRegionSet_t* p_set_a, pmpRegionSet_t* p_set_b, unsigned int strategy)
+{
+  g_pmp_strategy = strategy;
+  pmp_reset();
+  init_scheduler();
+  init_task(&g_pmp_measure_task, pmp_measure_func, pmp_measure_stack, D_STACK_SIZE);
+  init_task(&g_pmp_partner_task, pmp_partner_func, pmp_partner_stack, D_STACK_SIZE);
+  g_pmp_measure_task.p_pmp = p_set_a;
+  g_pmp_partner_task.p_pmp = p_set_b;
+  add_task_to_list(&ready_tasks_list, &g_pmp_measure_task);
+  add_task_to_list(&ready_tasks_list, &g_pmp_partner_task);
+  invoke_first_task();
+
+  /* the measuring task was switched in last */
+  if (p_set_a != 0)
+  {
+    g_pmp_errors += (g_p_pmp_loaded != p_set_a) + pmp_verify(p_set_a);
+  }
+
+  return g_pmp_measured;
+}
+
+/*
+ * Synthetic sets of num_of_entries NAPOT regions
+ * num_of_different - regions of set b that differ from set a (the last ones)
+ */
+static void
+pmp_build_sweep_sets(unsigned int num_of_entries, unsigned int num_of_different)
+{
+  unsigned int i;
+  unsigned long base;
+
+  pmp_init_set(&g_pmp_set_a);
+  pmp_init_set(&g_pmp_set_b);
+  for (i = 0 ; i < num_of_entries ; i++)
+  {
+    base = D_PMP_SWEEP_BASE + i*D_PMP_SWEEP_SIZE;
+    pmp_add_napot(&g_pmp_set_a, (void*)base, D_PMP_SWEEP_SIZE, D_PMP_R | D_PMP_W);
+    if (i >= num_of_entries - num_of_different)
+    {
+      base += D_PMP_SWEEP_OFFSET;
+    }
+    pmp_add_napot(&g_pmp_set_b, (void*)base, D_PMP_SWEEP_SIZE, D_PMP_R | D_PMP_W);
+  }
+}
+
+/*
+ * Task layout - shared code and data, own stack and peripheral window
+ */
+static void
+pmp_build_layout_set(pmpRegionSet_t* p_set, unsigned int* p_stack, unsigned long periph_base, unsigned int is_tor)
+{
+  pmp_init_set(p_set);
+  if (is_tor)
+  {
+    pmp_add_tor(p_set, (void*)D_PMP_CODE_BASE, (void*)(D_PMP_CODE_BASE + D_PMP_CODE_SIZE), D_PMP_R | D_PMP_X);
+    pmp_add_tor(p_set, (void*)D_PMP_DATA_BASE, (void*)(D_PMP_DATA_BASE + D_PMP_DATA_SIZE), D_PMP_R | D_PMP_W);
+    pmp_add_tor(p_set, p_stack, p_stack + D_STACK_SIZE, D_PMP_R | D_PMP_W);
+    pmp_add_tor(p_set, (void*)periph_base, (void*)(periph_base + D_PMP_PERIPH_SIZE), D_PMP_R | D_PMP_W);
+  }
+  else
+  {
+    pmp_add_napot(p_set, (void*)D_PMP_CODE_BASE, D_PMP_CODE_SIZE, D_PMP_R | D_PMP_X);
+    pmp_add_napot(p_set, (void*)D_PMP_DATA_BASE, D_PMP_DATA_SIZE, D_PMP_R | D_PMP_W);
+    pmp_add_napot(p_set, p_stack, D_STACK_SIZE*4, D_PMP_R | D_PMP_W);
+    pmp_add_napot(p_set, (void*)periph_base, D_PMP_PERIPH_SIZE, D_PMP_R | D_PMP_W);
+  }
+}
+
+static void
+pmp_measure_layout(pmpEncodingResult_t* p_result, unsigned int is_tor)
+{
+  pmp_build_layout_set(&g_pmp_set_a, pmp_measure_stack, D_PMP_PERIPH_A_BASE, is_tor);
+  pmp_build_layout_set(&g_pmp_set_b, pmp_partner_stack, D_PMP_PERIPH_B_BASE, is_tor);
+  p_result->num_of_entries = g_pmp_set_a.num_of_entries;
+  p_result->full_cycles = pmp_run(&g_pmp_set_a, &g_pmp_set_b, D_PMP_FULL_REWRITE);
+  p_result->diff_cycles = pmp_run(&g_pmp_set_a, &g_pmp_set_b, D_PMP_DIFF_REWRITE);
+}
+
+void
+pmp_benchmark(void)
+{
+  unsigned int i, num_of_entries;
+
+  g_pmp_errors = 0;
+
+  /* tasks without regions */
+  g_pmp_switch_base_cycles = pmp_run(0, 0, D_PMP_FULL_REWRITE);
+
+  for (i = 0 ; i < D_PMP_NUM_OF_COUNTS ; i++)
+  {
+    num_of_entries = g_pmp_entry_counts[i];
+    g_pmp_switch_results[i].num_of_entries = num_of_entries;
+
+    pmp_build_sweep_sets(num_of_entries, num_of_entries);
+    g_pmp_switch_results[i].full_cycles = pmp_run(&g_pmp_set_a, &g_pmp_set_b, D_PMP_FULL_REWRITE);
+    g_pmp_switch_results[i].diff_all_cycles = pmp_run(&g_pmp_set_a, &g_pmp_set_b, D_PMP_DIFF_REWRITE);
+
+    pmp_build_sweep_sets(num_of_entries, 1);
+    g_pmp_switch_results[i].diff_one_cycles = pmp_run(&g_pmp_set_a, &g_pmp_set_b, D_PMP_DIFF_REWRITE);
+  }
+
+  pmp_measure_layout(&g_pmp_napot_result, 0);
+  pmp_measure_layout(&g_pmp_tor_result, 1);
+
+  /* leave no regions behind */
+  pmp_reset();
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,31 @@
+#ifndef __CONTEXT_SWITCH_LATENCY_PORT_ARM_H__
+#define __CONTEXT_SWITCH_LATENCY_PORT_ARM_H__
+
+#ifdef D_ARM
+    /* Cortex-M has no instructions counter - D_CYCLES or not, cycles are
+       read from DWT CYCCNT, or from SysTick on cores (or models) without
+       the DWT (D_ARM_SYSTICK_CYCLES) */
+    #ifdef D_ARM_SYSTICK_CYCLES
+       unsigned int bsp_read_cycles(void);
+       #define M_READ_CYCLE_COUNTER(var)     (var) = bsp_read_cycles();
+    #else
+       #define M_READ_CYCLE_COUNTER(var)     (var) = *(volatile unsigned int*)0xE0001004;
+    #endif /* D_ARM_SYSTICK_CYCLES */
+    #define M_READ_CYCLE_COUNTER_END(var)    M_READ_CYCLE_COUNTER(var)
+    /* the tasks run privileged */
+    #define M_READ_USER_CYCLE_COUNTER(var)   M_READ_CYCLE_COUNTER(var)
+    /* stall the core until an interrupt is pending */
+    #define M_WAIT_FOR_INTERRUPT()            asm volatile ("wfi" : : : "memory");
+    /* read the stack pointer */
+    #define M_READ_STACK_POINTER(var)         asm volatile ("mov %0, sp" : "=r"(var));
+    /* mask interrupts (PRIMASK) - state gets the previous PRIMASK */
+    #define M_DISABLE_INTERRUPTS(state)       asm volatile ("mrs %0, primask\n cpsid i" : "=r"(state) : : "memory");
+    /* unmask interrupts if they were enabled in state */
+    #define M_RESTORE_INTERRUPTS(state)       asm volatile ("msr primask, %0" : : "r"(state) : "memory");
+    /* unmask interrupts */
+    #define M_ENABLE_INTERRUPTS()             asm volatile ("cpsie i" : : : "memory");
+    /* straight-line code of num 32 bit nops - an instruction working set */
+    #define M_RUN_NOPS(num)                   asm volatile (".rept %c0\nnop.w\n.endr" : : "i"(num));
+#endif /* D_ARM */
+
+#endif /* __CONTEXT_SWITCH_LATENCY_PORT_ARM_H__ */
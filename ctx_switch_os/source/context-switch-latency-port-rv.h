@@ -9,6 +9,31 @@
        #define M_READ_CYCLE_COUNTER(var)     asm volatile ("csrr %0, minstret" : "=r"(var));
        #define M_READ_CYCLE_COUNTER_END(var) M_READ_CYCLE_COUNTER(var)
     #endif /* D_CYCLES */
+    /* counters readable by user mode tasks - mcounteren must allow them */
+    #ifdef D_CORE_HAS_USER_MODE
+       #ifdef D_CYCLES
+          #define M_READ_USER_CYCLE_COUNTER(var)  asm volatile ("csrr %0, cycle" : "=r"(var));
+       #else
+          #define M_READ_USER_CYCLE_COUNTER(var)  asm volatile ("csrr %0, instret" : "=r"(var));
+       #endif /* D_CYCLES */
+    #else
+       #define M_READ_USER_CYCLE_COUNTER(var)  M_READ_CYCLE_COUNTER(var)
+    #endif /* D_CORE_HAS_USER_MODE */
+    /* stall the hart until an interrupt is pending */
+    #define M_WAIT_FOR_INTERRUPT()            asm volatile ("wfi" : : : "memory");
+    /* read the stack pointer */
+    #define M_READ_STACK_POINTER(var)         asm volatile ("mv %0, sp" : "=r"(var));
+    /* mask interrupts (mstatus.MIE) - state gets the previous mstatus */
+    #define M_DISABLE_INTERRUPTS(state)       asm volatile ("csrrci %0, mstatus, 8" : "=r"(state) : : "memory");
+    /* unmask interrupts if they were enabled in state */
+    #define M_RESTORE_INTERRUPTS(state)       asm volatile ("csrs mstatus, %0" : : "r"((state) & 8) : "memory");
+    /* unmask interrupts */
+    #define M_ENABLE_INTERRUPTS()             asm volatile ("csrsi mstatus, 8" : : : "memory");
+    /* read/write a csr */
+    #define M_READ_CSR(csr, var)              asm volatile ("csrr %0, " #csr : "=r"(var));
+    #define M_WRITE_CSR(csr, val)             asm volatile ("csrw " #csr ", %0" : : "r"(val));
+    /* straight-line code of num 32 bit nops - an instruction working set */
+    #define M_RUN_NOPS(num)                   asm volatile (".option push\n.option norvc\n.rept %0\nnop\n.endr\n.option pop" : : "i"(num));
 #else
     #ifdef D_CYCLES
        #define M_READ_CYCLE_COUNTER(var)
@@ -17,6 +42,15 @@
        #define M_READ_CYCLE_COUNTER(var)     
        #define M_READ_CYCLE_COUNTER_END(var)
     #endif /* D_CYCLES */
+    #define M_READ_USER_CYCLE_COUNTER(var)   M_READ_CYCLE_COUNTER(var)
+    #define M_WAIT_FOR_INTERRUPT()
+    #define M_READ_STACK_POINTER(var)         var = __builtin_frame_address(0);
+    #define M_DISABLE_INTERRUPTS(state)       state = 0;
+    #define M_RESTORE_INTERRUPTS(state)
+    #define M_ENABLE_INTERRUPTS()
+    #define M_READ_CSR(csr, var)
+    #define M_WRITE_CSR(csr, val)
+    #define M_RUN_NOPS(num)
 #endif /* D_RISCV */
 
 #endif /* __CONTEXT_SWITCH_LATENCY_PORT_RV_H__ */
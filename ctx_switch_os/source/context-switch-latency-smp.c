@@ -0,0 +1,590 @@
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+
+#include <string.h>
+
+/*
+ * SMP scheduler benchmark - the kernel primitives keep their single ready
+ * list and run on hart 0; this scheduler runs yielding tasks on 1 to
+ * D_SMP_MAX_HARTS harts. Every hart has its own current task, ready queue
+ * and idle task, and a hart whose queue is empty steals the head of the
+ * queue of another hart. The same tasks also run with one queue shared by
+ * every hart, so the two designs compare on the same load:
+ *   throughput - task switches per second across all harts
+ *   steal      - cycles from an empty queue to a task taken from another
+ *                hart, with every task starting on hart 0
+ *   contention - lock acquisitions of the ready queues that found the
+ *                lock taken, and the spins they took
+ * The queues are guarded by spinlocks built on atomic swap (amoswap.aq),
+ * the run is coordinated with atomic counters. Harts 1 to n wait in the
+ * start up code until hart 0 raises their CLINT software interrupt.
+ */
+
+#define D_SMP_MAX_HARTS        8
+/* harts of the machine - QEMU -smp */
+#ifndef D_SMP_NUM_OF_HARTS
+#define D_SMP_NUM_OF_HARTS     D_SMP_MAX_HARTS
+#endif /* D_SMP_NUM_OF_HARTS */
+/* 1, 2, 4, 8 harts */
+#define D_SMP_NUM_OF_COUNTS    4
+#define D_SMP_TASKS_PER_HART   4
+#define D_SMP_MAX_TASKS        (D_SMP_MAX_HARTS*D_SMP_TASKS_PER_HART)
+#define D_SMP_NUM_OF_ROUNDS    16
+/* work of a task between yields - 32 bit nops */
+#ifndef D_SMP_WORK_NOPS
+#define D_SMP_WORK_NOPS        64
+#endif /* D_SMP_WORK_NOPS */
+/* the queues and the harts don't share cache lines */
+#define D_SMP_LINE_BYTES       64
+/* task and idle stacks in words - a frame and the scheduler with its
+   queue lock on top of the task */
+#define D_SMP_STACK_SIZE       (2*D_STACK_SIZE)
+/* stack of harts 1 to n in words - the scheduler runs on it before the
+   first task and after the last one */
+#define D_SMP_HART_STACK_SIZE  (4*D_STACK_SIZE)
+/* CLINT msip of hart 0 - a word per hart */
+#ifndef D_SMP_CLINT_MSIP
+#define D_SMP_CLINT_MSIP       0x02000000
+#endif /* D_SMP_CLINT_MSIP */
+/* mip.MSIP */
+#define D_SMP_MIP_MSIP         0x8
+
+/* runs */
+/* per-hart queues, the tasks spread evenly */
+#define D_SMP_PER_HART         0
+/* per-hart queues, every task on hart 0 - the other harts steal */
+#define D_SMP_STEAL            1
+/* one queue shared by every hart */
+#define D_SMP_SHARED           2
+#define D_SMP_NUM_OF_RUNS      3
+
+/* ready queue of a hart (queue 0 in D_SMP_SHARED) */
+#define M_SMP_QUEUE(hart)      (g_smp_run == D_SMP_SHARED ? 0 : (hart))
+/* tasks in a queue - read without the lock */
+#define M_SMP_PEEK(p_queue)    (*(volatile unsigned int*)&(p_queue)->tasks.node_count)
+
+/* a run of D_SMP_TASKS_PER_HART tasks per hart */
+typedef struct smpResult
+{
+  /* number of harts */
+  unsigned int num_of_harts;
+  /* number of tasks */
+  unsigned int num_of_tasks;
+  /* task switches on all harts - the first dispatch and one per yield */
+  unsigned int switches;
+  /* cpu cycles from the start of the harts to the last one done */
+  unsigned int total_cycles;
+  /* switches across all harts per second at D_CORE_CLOCK_HZ */
+  unsigned int switches_per_sec;
+  /* tasks taken from the queue of another hart */
+  unsigned int steals;
+  /* cpu cycles from an empty queue to a stolen task */
+  unsigned int steal_avg_cycles;
+  unsigned int steal_max_cycles;
+  /* ready queue lock acquisitions */
+  unsigned int lock_acquires;
+  /* acquisitions that found the lock taken */
+  unsigned int lock_contended;
+  /* spins on taken locks */
+  unsigned int lock_spins;
+}smpResult_t;
+
+/* ready queue */
+typedef struct smpQueue
+{
+  /* spinlock - 0 free, 1 taken */
+  volatile unsigned int lock;
+  /* ready tasks */
+  taskList_t    tasks;
+}__attribute__ ((aligned (D_SMP_LINE_BYTES))) smpQueue_t;
+
+/* hart state - written by its own hart only */
+typedef struct smpHart
+{
+  /* running task - 0 once it exited */
+  taskCB_t     *p_current_task;
+  /* task switched out by a yield - made ready by smp_finish_switch, once
+     this hart left its stack */
+  taskCB_t     *p_prev_task;
+  /* sp of the hart before the first task - resumed once every task is
+     done */
+  void         *main_stack;
+  /* idle task - looks for tasks to steal */
+  taskCB_t      idle_task;
+  /* statistics - see smpResult_t */
+  unsigned int  switches;
+  unsigned int  steals;
+  unsigned int  steal_cycles;
+  unsigned int  steal_max_cycles;
+  unsigned int  lock_acquires;
+  unsigned int  lock_contended;
+  unsigned int  lock_spins;
+  /* the hart returned from its tasks */
+  cycles_t      end_cycles;
+}__attribute__ ((aligned (D_SMP_LINE_BYTES))) smpHart_t;
+
+/* functions implemented in context-switch-latency-rv.S */
+void smp_context_switch(void);
+void smp_invoke_first_task(void** p_main_stack);
+
+/* tasks handlers functions */
+static void smp_task_func(void);
+static void smp_idle_task_func(void);
+
+/* benchmark results - [run][hart counts] */
+smpResult_t g_smp_results[D_SMP_NUM_OF_RUNS][D_SMP_NUM_OF_COUNTS];
+unsigned int g_smp_errors;
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_smp_stack_usage;
+#endif /* D_STACK_WATERMARK */
+
+/* not static - sp of harts 1 to n, loaded by the start up code */
+void* g_smp_boot_sp[D_SMP_MAX_HARTS];
+static unsigned int g_smp_hart_stacks[D_SMP_MAX_HARTS][D_SMP_HART_STACK_SIZE] __attribute__ ((aligned (16)));
+
+/* harts, queues, tasks and stacks */
+static smpHart_t g_smp_harts[D_SMP_MAX_HARTS];
+static smpQueue_t g_smp_queues[D_SMP_MAX_HARTS];
+static taskCB_t g_smp_tasks[D_SMP_MAX_TASKS];
+unsigned int smp_task_stacks[D_SMP_MAX_TASKS][D_SMP_STACK_SIZE];
+unsigned int smp_idle_stacks[D_SMP_MAX_HARTS][D_SMP_STACK_SIZE];
+
+/* the run - set by hart 0 before the harts start */
+static unsigned int g_smp_run;
+static unsigned int g_smp_num_of_harts;
+/* tasks not done yet */
+static unsigned int g_smp_live_tasks;
+/* start barrier and end of the run */
+static unsigned int g_smp_arrived;
+static unsigned int g_smp_go;
+static unsigned int g_smp_done;
+
+/*
+ * this hart
+ */
+static inline unsigned int
+smp_hart_id(void)
+{
+  unsigned long id;
+
+  M_READ_CSR(mhartid, id);
+  return id;
+}
+
+/*
+ * Raise the software interrupt of a hart
+ */
+static void
+smp_send_ipi(unsigned int hart)
+{
+  volatile unsigned int *p_msip = (volatile unsigned int*)D_SMP_CLINT_MSIP;
+
+  /* the stores of the run ahead of the interrupt */
+  asm volatile ("fence" : : : "memory");
+  p_msip[hart] = 1;
+}
+
+/*
+ * Wait for the software interrupt of this hart and clear it - mie.MSIE is
+ * set by the start up code, mstatus.MIE stays clear
+ */
+static void
+smp_wait_ipi(unsigned int hart)
+{
+  volatile unsigned int *p_msip = (volatile unsigned int*)D_SMP_CLINT_MSIP;
+  unsigned long pending;
+
+  do
+  {
+    M_WAIT_FOR_INTERRUPT();
+    M_READ_CSR(mip, pending);
+  } while ((pending & D_SMP_MIP_MSIP) == 0);
+  p_msip[hart] = 0;
+}
+
+/*
+ * Take the lock of a ready queue - test and test-and-set, the spins are
+ * plain loads until the lock looks free
+ * p_hart - the hart taking it (statistics)
+ */
+static void
+smp_lock(smpQueue_t* p_queue, smpHart_t* p_hart)
+{
+  unsigned int spins = 0;
+
+  while (__atomic_exchange_n(&p_queue->lock, 1, __ATOMIC_ACQUIRE) != 0)
+  {
+    do
+    {
+      spins++;
+    } while (p_queue->lock != 0);
+  }
+  p_hart->lock_acquires++;
+  if (spins != 0)
+  {
+    p_hart->lock_contended++;
+    p_hart->lock_spins += spins;
+  }
+}
+
+/*
+ * Release the lock of a ready queue
+ */
+static void
+smp_unlock(smpQueue_t* p_queue)
+{
+  __atomic_store_n(&p_queue->lock, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Add a task to the tail of a ready queue
+ */
+static void
+smp_enqueue(smpQueue_t* p_queue, taskCB_t* p_task, smpHart_t* p_hart)
+{
+  smp_lock(p_queue, p_hart);
+  add_task_to_list(&p_queue->tasks, p_task);
+  smp_unlock(p_queue);
+}
+
+/*
+ * Remove the head of a ready queue
+ * return the task node, 0 if the queue is empty
+ */
+static taskNode_t*
+smp_dequeue(smpQueue_t* p_queue, smpHart_t* p_hart)
+{
+  taskNode_t* p_node;
+
+  smp_lock(p_queue, p_hart);
+  p_node = remove_head_from_list(&p_queue->tasks);
+  smp_unlock(p_queue);
+
+  return p_node;
+}
+
+/*
+ * Select the next task of this hart - its own queue first, then the head
+ * of the queue of another hart, then the task that just yielded, then the
+ * idle task; back to the hart main stack once every task is done.
+ * Called from smp_context_switch on the stack of the previous task
+ * p_task_sp - sp of the previous task
+ * return - sp of the selected task
+ */
+void*
+smp_select_next_task(void* p_task_sp)
+{
+  unsigned int hart = smp_hart_id(), i;
+  smpHart_t *p_hart = &g_smp_harts[hart];
+  smpQueue_t *p_victim;
+  taskNode_t *p_node;
+  cycles_t start, end;
+
+  /* save the previous task sp, unless it exited */
+  if (p_hart->p_current_task != 0)
+  {
+    p_hart->p_current_task->pStack = p_task_sp;
+  }
+
+  /* own queue */
+  p_node = smp_dequeue(&g_smp_queues[M_SMP_QUEUE(hart)], p_hart);
+  /* empty - steal from the next hart with ready tasks */
+  if (p_node == 0 && g_smp_run != D_SMP_SHARED)
+  {
+    M_READ_CYCLE_COUNTER(start);
+    for (i = 1 ; i < g_smp_num_of_harts && p_node == 0 ; i++)
+    {
+      p_victim = &g_smp_queues[(hart + i) % g_smp_num_of_harts];
+      /* most queues are empty - look before taking the lock */
+      if (M_SMP_PEEK(p_victim) != 0)
+      {
+        p_node = smp_dequeue(p_victim, p_hart);
+      }
+    }
+    if (p_node != 0)
+    {
+      M_READ_CYCLE_COUNTER_END(end);
+      end -= start;
+      p_hart->steals++;
+      p_hart->steal_cycles += end;
+      if (end > p_hart->steal_max_cycles)
+      {
+        p_hart->steal_max_cycles = end;
+      }
+    }
+  }
+
+  if (p_node != 0)
+  {
+    p_hart->p_current_task = p_node->p_owner;
+  }
+  /* nothing else is ready - run the task that yielded again */
+  else if (p_hart->p_prev_task != 0)
+  {
+    p_hart->p_current_task = p_hart->p_prev_task;
+    p_hart->p_prev_task = 0;
+  }
+  /* every task is done - resume the hart main stack */
+  else if (__atomic_load_n(&g_smp_live_tasks, __ATOMIC_ACQUIRE) == 0)
+  {
+    p_hart->p_current_task = 0;
+    return p_hart->main_stack;
+  }
+  else
+  {
+    p_hart->p_current_task = &p_hart->idle_task;
+  }
+
+  if (p_hart->p_current_task != &p_hart->idle_task)
+  {
+    p_hart->switches++;
+  }
+
+  return p_hart->p_current_task->pStack;
+}
+
+/*
+ * Make the task that yielded ready - called from smp_context_switch once
+ * this hart runs on the stack of the next task; before that another hart
+ * could resume the task on the stack still in use here
+ */
+void
+smp_finish_switch(void)
+{
+  unsigned int hart = smp_hart_id();
+  smpHart_t *p_hart = &g_smp_harts[hart];
+  taskCB_t *p_task = p_hart->p_prev_task;
+
+  if (p_task != 0)
+  {
+    p_hart->p_prev_task = 0;
+    smp_enqueue(&g_smp_queues[M_SMP_QUEUE(hart)], p_task, p_hart);
+  }
+}
+
+/*
+ * Yield the hart - the task goes to the queue of the hart it ran on and
+ * may resume on any hart
+ */
+static void __attribute__ ((noinline))
+smp_task_yield(void)
+{
+  smpHart_t *p_hart = &g_smp_harts[smp_hart_id()];
+
+  p_hart->p_prev_task = p_hart->p_current_task;
+  smp_context_switch();
+}
+
+/*
+ * End the running task - its context isn't saved
+ */
+static void __attribute__ ((noinline))
+smp_task_exit(void)
+{
+  g_smp_harts[smp_hart_id()].p_current_task = 0;
+  __atomic_fetch_sub(&g_smp_live_tasks, 1, __ATOMIC_ACQ_REL);
+  smp_context_switch();
+}
+
+/*
+ * Task - D_SMP_NUM_OF_ROUNDS rounds of work and yield
+ */
+void smp_task_func(void)
+{
+  unsigned int round;
+
+  for (round = 0 ; round < D_SMP_NUM_OF_ROUNDS ; round++)
+  {
+    M_RUN_NOPS(D_SMP_WORK_NOPS);
+    smp_task_yield();
+  }
+  smp_task_exit();
+}
+
+/*
+ * Is any ready queue of the run not empty
+ */
+static unsigned int
+smp_work_available(void)
+{
+  unsigned int i;
+
+  for (i = 0 ; i < g_smp_num_of_harts ; i++)
+  {
+    if (M_SMP_PEEK(&g_smp_queues[i]) != 0)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Idle task of a hart - polls the queues until there is a task to run or
+ * steal, or every task is done
+ */
+void smp_idle_task_func(void)
+{
+  while (1)
+  {
+    if (smp_work_available() || __atomic_load_n(&g_smp_live_tasks, __ATOMIC_ACQUIRE) == 0)
+    {
+      smp_context_switch();
+    }
+  }
+}
+
+/*
+ * Run the tasks of this hart until every task is done
+ */
+static void
+smp_hart_run(smpHart_t* p_hart)
+{
+  smp_invoke_first_task(&p_hart->main_stack);
+  M_READ_CYCLE_COUNTER(p_hart->end_cycles);
+}
+
+/*
+ * Harts 1 to n - called by the start up code on the software interrupt of
+ * the first run of the hart; runs, then waits for the next run
+ */
+void
+smp_secondary_main(void)
+{
+  unsigned int hart = smp_hart_id();
+
+  while (1)
+  {
+    /* start barrier */
+    __atomic_fetch_add(&g_smp_arrived, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&g_smp_go, __ATOMIC_ACQUIRE) == 0);
+    smp_hart_run(&g_smp_harts[hart]);
+    __atomic_fetch_add(&g_smp_done, 1, __ATOMIC_RELEASE);
+    smp_wait_ipi(hart);
+  }
+}
+
+/*
+ * One run of a policy on num_of_harts harts
+ * run - D_SMP_PER_HART, D_SMP_STEAL or D_SMP_SHARED
+ */
+static void
+smp_run(unsigned int run, unsigned int num_of_harts, smpResult_t* p_result)
+{
+  unsigned int i, num_of_tasks = num_of_harts*D_SMP_TASKS_PER_HART;
+  cycles_t start, end;
+  smpHart_t *p_hart;
+
+  g_smp_run = run;
+  g_smp_num_of_harts = num_of_harts;
+  memset(g_smp_harts, 0, sizeof(g_smp_harts));
+  for (i = 0 ; i < num_of_harts ; i++)
+  {
+    g_smp_queues[i].lock = 0;
+    g_smp_queues[i].tasks.node_count = 0;
+    init_task(&g_smp_harts[i].idle_task, smp_idle_task_func, smp_idle_stacks[i], D_SMP_STACK_SIZE);
+  }
+  /* spread the tasks - or all on hart 0 */
+  for (i = 0 ; i < num_of_tasks ; i++)
+  {
+    init_task(&g_smp_tasks[i], smp_task_func, smp_task_stacks[i], D_SMP_STACK_SIZE);
+    add_task_to_list(&g_smp_queues[run == D_SMP_STEAL ? 0 : M_SMP_QUEUE(i % num_of_harts)].tasks, &g_smp_tasks[i]);
+  }
+  g_smp_live_tasks = num_of_tasks;
+  g_smp_arrived = 0;
+  g_smp_go = 0;
+  g_smp_done = 0;
+
+  /* start the harts, every one waits for go */
+  for (i = 1 ; i < num_of_harts ; i++)
+  {
+    smp_send_ipi(i);
+  }
+  while (__atomic_load_n(&g_smp_arrived, __ATOMIC_ACQUIRE) != num_of_harts - 1);
+  M_READ_CYCLE_COUNTER(start);
+  __atomic_store_n(&g_smp_go, 1, __ATOMIC_RELEASE);
+  smp_hart_run(&g_smp_harts[0]);
+  while (__atomic_load_n(&g_smp_done, __ATOMIC_ACQUIRE) != num_of_harts - 1);
+
+  /* the counter is shared by the harts on QEMU (-icount) - on other
+     machines the counters must be in sync */
+  memset(p_result, 0, sizeof(*p_result));
+  end = start;
+  for (i = 0 ; i < num_of_harts ; i++)
+  {
+    p_hart = &g_smp_harts[i];
+    if ((int)(p_hart->end_cycles - end) > 0)
+    {
+      end = p_hart->end_cycles;
+    }
+    p_result->switches += p_hart->switches;
+    p_result->steals += p_hart->steals;
+    p_result->steal_avg_cycles += p_hart->steal_cycles;
+    if (p_hart->steal_max_cycles > p_result->steal_max_cycles)
+    {
+      p_result->steal_max_cycles = p_hart->steal_max_cycles;
+    }
+    p_result->lock_acquires += p_hart->lock_acquires;
+    p_result->lock_contended += p_hart->lock_contended;
+    p_result->lock_spins += p_hart->lock_spins;
+  }
+  p_result->num_of_harts = num_of_harts;
+  p_result->num_of_tasks = num_of_tasks;
+  p_result->total_cycles = end - start;
+  if (p_result->total_cycles != 0)
+  {
+    p_result->switches_per_sec = (unsigned long long)p_result->switches*D_CORE_CLOCK_HZ/p_result->total_cycles;
+  }
+  if (p_result->steals != 0)
+  {
+    p_result->steal_avg_cycles /= p_result->steals;
+  }
+
+  /* every task ran its rounds - the first dispatch and one per yield */
+  g_smp_errors += (p_result->switches != num_of_tasks*(D_SMP_NUM_OF_ROUNDS + 1));
+  g_smp_errors += (g_smp_live_tasks != 0);
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(&g_smp_tasks[0], &g_smp_stack_usage);
+#endif /* D_STACK_WATERMARK */
+}
+
+/*
+ * SMP benchmark - every run with 1, 2, 4 and 8 harts, up to the harts of
+ * the machine
+ */
+void smp_benchmark(void)
+{
+  unsigned int run, count, i;
+
+  /* stacks of harts 1 to n, before their first software interrupt */
+  for (i = 1 ; i < D_SMP_MAX_HARTS ; i++)
+  {
+    g_smp_boot_sp[i] = &g_smp_hart_stacks[i][D_SMP_HART_STACK_SIZE];
+  }
+
+  /* this runs on hart 0 */
+  g_smp_errors += (smp_hart_id() != 0);
+
+  for (run = 0 ; run < D_SMP_NUM_OF_RUNS ; run++)
+  {
+    for (count = 0 ; count < D_SMP_NUM_OF_COUNTS ; count++)
+    {
+      if ((1 << count) > D_SMP_NUM_OF_HARTS)
+      {
+        break;
+      }
+      smp_run(run, 1 << count, &g_smp_results[run][count]);
+    }
+  }
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,386 @@
+
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+
+/*
+ * System call benchmark - the kernel services are called by tasks either
+ * directly (machine mode, as in the rest of the benchmarks) or through
+ * ecall from user mode tasks (D_CORE_HAS_USER_MODE; without it the tasks
+ * stay in machine mode and only the trap path is added). Both run the
+ * same measurement through a table of service functions, so the
+ * difference is the ecall round trip: trap entry and frame save, dispatch,
+ * frame restore and mret back to the caller.
+ */
+
+#define D_SYSCALL_NUM_OF_ROUNDS  8
+/* the trap frame and a nested context_switch are on the task stack */
+#define D_SYSCALL_STACK_SIZE     256
+
+/* service numbers - a7 of ecall */
+#define D_SYS_NULL               0
+#define D_SYS_SEMAPHORE_GIVE     1
+#define D_SYS_QUEUE_SEND         2
+#define D_SYS_TASK_YIELD         3
+#define D_SYS_EXIT               4
+/* measured services - all but exit */
+#define D_SYSCALL_NUM_OF_SERVICES  4
+
+/* ecall from user mode (mcause) */
+#define D_MCAUSE_ECALL_FROM_U    8
+/* m/scounteren - cycle, time and instret readable from user mode */
+#define D_COUNTEREN_ALL          7
+/* pmpcfg0 entry 0 - NAPOT, read/write/execute */
+#define D_PMPCFG_NAPOT_RWX       0x1F
+
+/* a service cost - direct call vs ecall */
+typedef struct syscallResult
+{
+  /* average cpu cycles of a direct call (machine mode) */
+  unsigned int direct_cycles;
+  /* average cpu cycles through ecall */
+  unsigned int ecall_cycles;
+  /* ecall_cycles - direct_cycles */
+  unsigned int overhead_cycles;
+}syscallResult_t;
+
+/* null service ecall round trip by part */
+typedef struct syscallBreakdown
+{
+  /* ecall to the end of the frame save */
+  unsigned int to_handler_cycles;
+  /* dispatch and service */
+  unsigned int service_cycles;
+  /* frame restore and mret to the caller */
+  unsigned int to_caller_cycles;
+}syscallBreakdown_t;
+
+/* services as seen by the measuring task */
+typedef struct syscallOps
+{
+  void (*null)(void);
+  unsigned int (*semaphore_give)(semaphoreCB_t* p_sem);
+  int (*queue_send)(queueCB_t* p_queue, unsigned int *p_item);
+  void (*task_yield)(void);
+  void (*exit)(void);
+}syscallOps_t;
+
+/* functions implemented in context-switch-latency-rv.S */
+void syscall_trap_handler(void);
+void enter_user_mode(task_handler func);
+
+/* tasks handlers functions */
+static void syscall_direct_task_func(void);
+static void syscall_direct_partner_func(void);
+static void syscall_user_task_entry(void);
+static void syscall_user_partner_entry(void);
+
+/* benchmark results */
+syscallResult_t g_syscall_null;
+syscallResult_t g_syscall_semaphore_give;
+syscallResult_t g_syscall_queue_send;
+syscallResult_t g_syscall_task_yield;
+syscallBreakdown_t g_syscall_null_breakdown;
+/* 1 if the ecalls came from user mode */
+unsigned int g_syscall_user_mode;
+unsigned int g_syscall_errors;
+
+/* not static - written by syscall_trap_handler */
+volatile cycles_t g_syscall_cycles_entry, g_syscall_cycles_exit;
+
+unsigned int syscall_task_stack[D_SYSCALL_STACK_SIZE];
+unsigned int syscall_partner_stack[D_SYSCALL_STACK_SIZE];
+static taskCB_t g_syscall_task, g_syscall_partner;
+static semaphoreCB_t g_syscall_sem;
+static queueCB_t g_syscall_queue;
+static unsigned int g_syscall_ecalls;
+/* the measurement running - direct or through ecall */
+static const syscallOps_t* g_p_syscall_ops;
+/* average cycles of the last measurement - null, give, send, yield */
+static unsigned int g_syscall_measured[D_SYSCALL_NUM_OF_SERVICES];
+static syscallBreakdown_t g_syscall_measured_breakdown;
+
+/*
+ * Kernel side of the system call trap - called from syscall_trap_handler
+ * arg0, arg1 - service arguments
+ * number - service number
+ * mcause - trap cause, ecall from user or machine mode
+ * return the service return value
+ */
+unsigned long
+syscall_dispatch(unsigned long arg0, unsigned long arg1, unsigned long number, unsigned long mcause)
+{
+  g_syscall_ecalls++;
+  g_syscall_user_mode = (mcause == D_MCAUSE_ECALL_FROM_U);
+
+  switch (number)
+  {
+  case D_SYS_NULL:
+    return 0;
+  case D_SYS_SEMAPHORE_GIVE:
+    return semaphore_give((semaphoreCB_t*)arg0);
+  case D_SYS_QUEUE_SEND:
+    return queue_send((queueCB_t*)arg0, (unsigned int*)arg1);
+  case D_SYS_TASK_YIELD:
+    task_yield();
+    return 0;
+  case D_SYS_EXIT:
+    /* back to the benchmark - never returns */
+    return_to_main();
+    return 0;
+  default:
+    g_syscall_errors++;
+    return 0;
+  }
+}
+
+/*
+ * Any other trap taken by syscall_trap_handler - count it and quit the
+ * measurement
+ * mcause - trap cause
+ */
+void
+syscall_unexpected_trap(unsigned long mcause)
+{
+  (void)mcause;
+  g_syscall_errors++;
+  /* back to the benchmark - never returns */
+  return_to_main();
+}
+
+/*
+ * ecall with up to two arguments - register wide, pointers fit on rv64
+ */
+static inline unsigned long
+syscall2(unsigned long number, unsigned long arg0, unsigned long arg1)
+{
+  register unsigned long a0 asm ("a0") = arg0;
+  register unsigned long a1 asm ("a1") = arg1;
+  register unsigned long a7 asm ("a7") = number;
+
+  asm volatile ("ecall" : "+r"(a0) : "r"(a1), "r"(a7) : "memory");
+
+  return a0;
+}
+
+/* user side of the services */
+static void __attribute__ ((noinline))
+sys_null(void)
+{
+  syscall2(D_SYS_NULL, 0, 0);
+}
+
+static unsigned int __attribute__ ((noinline))
+sys_semaphore_give(semaphoreCB_t* p_sem)
+{
+  return syscall2(D_SYS_SEMAPHORE_GIVE, (unsigned long)p_sem, 0);
+}
+
+static int __attribute__ ((noinline))
+sys_queue_send(queueCB_t* p_queue, unsigned int *p_item)
+{
+  return syscall2(D_SYS_QUEUE_SEND, (unsigned long)p_queue, (unsigned long)p_item);
+}
+
+static void __attribute__ ((noinline))
+sys_task_yield(void)
+{
+  syscall2(D_SYS_TASK_YIELD, 0, 0);
+}
+
+static void __attribute__ ((noinline))
+sys_exit(void)
+{
+  syscall2(D_SYS_EXIT, 0, 0);
+}
+
+/* direct counterpart of sys_null */
+static void __attribute__ ((noinline))
+null_service(void)
+{
+  asm volatile ("" : : : "memory");
+}
+
+static const syscallOps_t g_syscall_direct_ops = {
+  null_service, semaphore_give, queue_send, task_yield, return_to_main
+};
+
+static const syscallOps_t g_syscall_ecall_ops = {
+  sys_null, sys_semaphore_give, sys_queue_send, sys_task_yield, sys_exit
+};
+
+/*
+ * Measuring task - every service D_SYSCALL_NUM_OF_ROUNDS times through
+ * g_p_syscall_ops; the averages go to g_syscall_measured
+ */
+static void
+syscall_measure(void)
+{
+  const syscallOps_t* p_ops = g_p_syscall_ops;
+  unsigned int round, item = 0;
+  unsigned int null_cycles = 0, give_cycles = 0, send_cycles = 0, yield_cycles = 0;
+  unsigned int to_handler = 0, service = 0, to_caller = 0;
+  cycles_t start, end;
+
+  for (round = 0 ; round < D_SYSCALL_NUM_OF_ROUNDS ; round++)
+  {
+    /* null service */
+    M_READ_USER_CYCLE_COUNTER(start);
+    p_ops->null();
+    M_READ_USER_CYCLE_COUNTER(end);
+    null_cycles += end - start;
+    to_handler += g_syscall_cycles_entry - start;
+    service += g_syscall_cycles_exit - g_syscall_cycles_entry;
+    to_caller += end - g_syscall_cycles_exit;
+
+    /* semaphore_give - nobody pending, the count is taken back */
+    M_READ_USER_CYCLE_COUNTER(start);
+    p_ops->semaphore_give(&g_syscall_sem);
+    M_READ_USER_CYCLE_COUNTER(end);
+    give_cycles += end - start;
+    g_syscall_errors += (g_syscall_sem.counter != 1);
+    g_syscall_sem.counter = 0;
+
+    /* queue_send - nobody pending, the queue is emptied */
+    M_READ_USER_CYCLE_COUNTER(start);
+    p_ops->queue_send(&g_syscall_queue, &item);
+    M_READ_USER_CYCLE_COUNTER(end);
+    send_cycles += end - start;
+    g_syscall_errors += (g_syscall_queue.num_of_items != 1);
+    g_syscall_queue.num_of_items = g_syscall_queue.push_index = g_syscall_queue.pop_index = 0;
+
+    /* task_yield - to the partner and back, two yields */
+    M_READ_USER_CYCLE_COUNTER(start);
+    p_ops->task_yield();
+    M_READ_USER_CYCLE_COUNTER(end);
+    yield_cycles += (end - start)/2;
+  }
+
+  g_syscall_measured[D_SYS_NULL] = null_cycles/D_SYSCALL_NUM_OF_ROUNDS;
+  g_syscall_measured[D_SYS_SEMAPHORE_GIVE] = give_cycles/D_SYSCALL_NUM_OF_ROUNDS;
+  g_syscall_measured[D_SYS_QUEUE_SEND] = send_cycles/D_SYSCALL_NUM_OF_ROUNDS;
+  g_syscall_measured[D_SYS_TASK_YIELD] = yield_cycles/D_SYSCALL_NUM_OF_ROUNDS;
+  /* only meaningful through ecall - the trap handler takes the stamps */
+  g_syscall_measured_breakdown.to_handler_cycles = to_handler/D_SYSCALL_NUM_OF_ROUNDS;
+  g_syscall_measured_breakdown.service_cycles = service/D_SYSCALL_NUM_OF_ROUNDS;
+  g_syscall_measured_breakdown.to_caller_cycles = to_caller/D_SYSCALL_NUM_OF_ROUNDS;
+
+  /* quit the measurement */
+  p_ops->exit();
+}
+
+/*
+ * Yield partner - bounce every yield back
+ */
+static void
+syscall_partner(void)
+{
+  while (1)
+  {
+    g_p_syscall_ops->task_yield();
+  }
+}
+
+void syscall_direct_task_func(void)
+{
+  syscall_measure();
+}
+
+void syscall_direct_partner_func(void)
+{
+  syscall_partner();
+}
+
+/* user mode tasks start in machine mode - drop to user mode first */
+void syscall_user_task_entry(void)
+{
+  enter_user_mode(syscall_measure);
+}
+
+void syscall_user_partner_entry(void)
+{
+  enter_user_mode(syscall_partner);
+}
+
+/*
+ * Run a measurement with a pair of tasks
+ * p_ops - services of the measurement
+ * task_func, partner_func - task functions
+ */
+static void
+syscall_run(const syscallOps_t* p_ops, task_handler task_func, task_handler partner_func)
+{
+  g_p_syscall_ops = p_ops;
+  init_scheduler();
+  init_semaphore(&g_syscall_sem);
+  g_syscall_sem.max_count = 2;
+  init_queue(&g_syscall_queue);
+  init_task(&g_syscall_task, task_func, syscall_task_stack, D_SYSCALL_STACK_SIZE);
+  init_task(&g_syscall_partner, partner_func, syscall_partner_stack, D_SYSCALL_STACK_SIZE);
+  add_task_to_list(&ready_tasks_list, &g_syscall_task);
+  add_task_to_list(&ready_tasks_list, &g_syscall_partner);
+  invoke_first_task();
+}
+
+void
+syscall_benchmark(void)
+{
+  syscallResult_t* p_results[D_SYSCALL_NUM_OF_SERVICES] = {
+    &g_syscall_null, &g_syscall_semaphore_give, &g_syscall_queue_send, &g_syscall_task_yield
+  };
+  unsigned int i;
+  unsigned long mtvec, mstatus;
+
+  g_syscall_errors = 0;
+  g_syscall_ecalls = 0;
+
+  /* direct calls from machine mode tasks */
+  syscall_run(&g_syscall_direct_ops, syscall_direct_task_func, syscall_direct_partner_func);
+  g_syscall_errors += (g_syscall_ecalls != 0);
+  for (i = 0 ; i < D_SYSCALL_NUM_OF_SERVICES ; i++)
+  {
+    p_results[i]->direct_cycles = g_syscall_measured[i];
+  }
+
+  /* ecall from user mode tasks */
+  M_READ_CSR(mtvec, mtvec);
+  M_READ_CSR(mstatus, mstatus);
+  M_WRITE_CSR(mtvec, syscall_trap_handler);
+#ifdef D_CORE_HAS_USER_MODE
+  /* user mode may read the counters and access all memory; with
+     supervisor mode scounteren must allow the counters as well */
+  M_WRITE_CSR(mcounteren, D_COUNTEREN_ALL);
+#ifdef D_CORE_HAS_SUPERVISOR_MODE
+  M_WRITE_CSR(scounteren, D_COUNTEREN_ALL);
+#endif /* D_CORE_HAS_SUPERVISOR_MODE */
+  M_WRITE_CSR(pmpaddr0, ~0UL);
+  M_WRITE_CSR(pmpcfg0, D_PMPCFG_NAPOT_RWX);
+#endif /* D_CORE_HAS_USER_MODE */
+  syscall_run(&g_syscall_ecall_ops, syscall_user_task_entry, syscall_user_partner_entry);
+  /* sys_exit returned here from the trap - restore the trap state */
+  M_WRITE_CSR(mtvec, mtvec);
+  M_WRITE_CSR(mstatus, mstatus);
+
+  for (i = 0 ; i < D_SYSCALL_NUM_OF_SERVICES ; i++)
+  {
+    p_results[i]->ecall_cycles = g_syscall_measured[i];
+    p_results[i]->overhead_cycles = g_syscall_measured[i] - p_results[i]->direct_cycles;
+  }
+  g_syscall_null_breakdown = g_syscall_measured_breakdown;
+
+  /* every round - null, give, send, two yields and the exit */
+  g_syscall_errors += (g_syscall_ecalls < D_SYSCALL_NUM_OF_ROUNDS*5 + 1);
+#ifdef D_CORE_HAS_USER_MODE
+  g_syscall_errors += (g_syscall_user_mode != 1);
+#endif /* D_CORE_HAS_USER_MODE */
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,279 @@
+
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#elif defined(D_ARM)
+ #include "context-switch-latency-port-arm.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+
+/*
+ * Task lifecycle benchmark - tasks are created at run time from a pool of
+ * control blocks and stacks. Measured are the task_create call, the first
+ * dispatch of the created task, a task deleting itself until the next task
+ * runs and the delete of a ready task that never ran. A churn workload then
+ * keeps the pool busy spawning short-lived workers that exit by themselves.
+ */
+
+#define D_TASK_POOL_SIZE      8
+#define D_TASK_NUM_OF_ROUNDS  8
+#define D_TASK_CHURN_TASKS    64
+
+/* cost of a single operation over D_TASK_NUM_OF_ROUNDS rounds */
+typedef struct taskCostResult
+{
+  /* min cpu cycles */
+  unsigned int min_cycles;
+  /* max cpu cycles */
+  unsigned int max_cycles;
+  /* average cpu cycles */
+  unsigned int avg_cycles;
+}taskCostResult_t;
+
+/* churn workload results */
+typedef struct taskChurnResult
+{
+  /* number of workers created and deleted */
+  unsigned int num_of_tasks;
+  /* max number of workers alive at the same time */
+  unsigned int max_alive;
+  /* task_create calls failed on an exhausted pool */
+  unsigned int pool_exhausted;
+  /* cpu cycles per worker - spawn, run and exit */
+  unsigned int cycles_per_task;
+  /* workers per second at D_CORE_CLOCK_HZ */
+  unsigned int tasks_per_sec;
+}taskChurnResult_t;
+
+/* tasks handlers functions */
+static void task_creator_func(void);
+static void task_lifecycle_func(void);
+static void task_churn_supervisor_func(void);
+static void task_churn_worker_func(void);
+static void task_never_run_func(void);
+
+/* benchmark results - all operations include the D_STACK_WATERMARK stack
+   painting of init_task if enabled */
+taskCostResult_t g_task_create_cycles;
+taskCostResult_t g_task_first_dispatch_cycles;
+taskCostResult_t g_task_delete_self_cycles;
+taskCostResult_t g_task_delete_ready_cycles;
+taskChurnResult_t g_task_churn_result;
+unsigned int g_task_errors;
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_task_stack_usage_creator;
+stackUsage_t g_task_stack_usage_worker;
+#endif /* D_STACK_WATERMARK */
+
+/* task pool storage */
+static taskCB_t g_task_pool_tcbs[D_TASK_POOL_SIZE];
+unsigned int task_pool_stacks[D_TASK_POOL_SIZE][D_STACK_SIZE];
+static taskPoolCB_t g_task_pool;
+
+/* the creator/supervisor is a static task */
+unsigned int task_creator_stack[D_STACK_SIZE];
+static taskCB_t g_task_creator_task;
+
+static unsigned int g_task_alive;
+static volatile cycles_t g_task_cycles_start, g_task_cycles_end;
+
+/*
+ * Add a measurement to an operation cost
+ * p_cost - cost to update
+ * cycles - measured cpu cycles
+ * round - measurement index, the average is final after the last round
+ */
+static void
+task_update_cost(taskCostResult_t* p_cost, unsigned int cycles, unsigned int round)
+{
+  if (round == 0 || cycles < p_cost->min_cycles)
+  {
+    p_cost->min_cycles = cycles;
+  }
+  if (round == 0 || cycles > p_cost->max_cycles)
+  {
+    p_cost->max_cycles = cycles;
+  }
+  /* accumulate the sum, divide it once all rounds are done */
+  p_cost->avg_cycles = (round == 0 ? 0 : p_cost->avg_cycles) + cycles;
+  if (round == D_TASK_NUM_OF_ROUNDS - 1)
+  {
+    p_cost->avg_cycles /= D_TASK_NUM_OF_ROUNDS;
+  }
+}
+
+/*
+ * Created task - report its first dispatch and delete itself
+ */
+void task_lifecycle_func(void)
+{
+  /* read cpu cycle - end measure first dispatch */
+  M_READ_CYCLE_COUNTER(g_task_cycles_end);
+  g_task_cycles_end -= g_task_cycles_start;
+  g_task_alive++;
+
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(g_p_current_task, &g_task_stack_usage_worker);
+#endif /* D_STACK_WATERMARK */
+
+  /* read cpu cycle - start measure delete self */
+  M_READ_CYCLE_COUNTER(g_task_cycles_start);
+  task_delete(&g_task_pool, g_p_current_task);
+}
+
+/*
+ * Created and deleted before it is dispatched
+ */
+void task_never_run_func(void)
+{
+  g_task_errors++;
+  return_to_main();
+}
+
+/*
+ * Creator task - create, dispatch and delete a task per round
+ */
+void task_creator_func(void)
+{
+  unsigned int round;
+  cycles_t start, end;
+  taskCB_t* p_task;
+
+  for (round = 0 ; round < D_TASK_NUM_OF_ROUNDS ; round++)
+  {
+    /* create - the new task is ready */
+    M_READ_CYCLE_COUNTER(start);
+    p_task = task_create(&g_task_pool, task_lifecycle_func);
+    M_READ_CYCLE_COUNTER(end);
+    g_task_errors += (p_task == 0);
+    task_update_cost(&g_task_create_cycles, end - start, round);
+
+    /* first dispatch - the new task deletes itself and we resume */
+    g_task_alive = 0;
+    M_READ_CYCLE_COUNTER(g_task_cycles_start);
+    task_yield();
+    M_READ_CYCLE_COUNTER(end);
+    g_task_errors += (g_task_alive != 1);
+    task_update_cost(&g_task_first_dispatch_cycles, g_task_cycles_end, round);
+    task_update_cost(&g_task_delete_self_cycles, end - g_task_cycles_start, round);
+
+    /* delete a ready task */
+    p_task = task_create(&g_task_pool, task_never_run_func);
+    M_READ_CYCLE_COUNTER(start);
+    task_delete(&g_task_pool, p_task);
+    M_READ_CYCLE_COUNTER(end);
+    task_update_cost(&g_task_delete_ready_cycles, end - start, round);
+  }
+
+  /* every block is back in the pool */
+  g_task_errors += (g_task_pool.tcb_pool.free_blocks != D_TASK_POOL_SIZE);
+  g_task_errors += (g_task_pool.stack_pool.free_blocks != D_TASK_POOL_SIZE);
+
+  /* quit the measurement */
+  return_to_main();
+}
+
+/*
+ * Churn worker - do a little work across a switch and exit
+ */
+void task_churn_worker_func(void)
+{
+  /* let the other workers and the supervisor run */
+  task_yield();
+
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(g_p_current_task, &g_task_stack_usage_worker);
+#endif /* D_STACK_WATERMARK */
+
+  g_task_alive--;
+  task_delete(&g_task_pool, g_p_current_task);
+}
+
+/*
+ * Churn supervisor - keep the pool full of workers until
+ * D_TASK_CHURN_TASKS were spawned and all of them exited
+ */
+void task_churn_supervisor_func(void)
+{
+  unsigned int spawned = 0;
+
+  /* read cpu cycle - start measure */
+  M_READ_CYCLE_COUNTER(g_task_cycles_start);
+
+  while (spawned < D_TASK_CHURN_TASKS || g_task_alive != 0)
+  {
+    /* spawn while the pool has room */
+    if (spawned < D_TASK_CHURN_TASKS)
+    {
+      if (task_create(&g_task_pool, task_churn_worker_func) != 0)
+      {
+        spawned++;
+        g_task_alive++;
+        if (g_task_alive > g_task_churn_result.max_alive)
+        {
+          g_task_churn_result.max_alive = g_task_alive;
+        }
+        continue;
+      }
+      g_task_churn_result.pool_exhausted++;
+    }
+    /* reap - workers run and exit */
+    task_yield();
+  }
+
+  /* read cpu cycle - end measure */
+  M_READ_CYCLE_COUNTER(g_task_cycles_end);
+
+  g_task_errors += (g_task_pool.tcb_pool.free_blocks != D_TASK_POOL_SIZE);
+  g_task_errors += (g_task_pool.stack_pool.free_blocks != D_TASK_POOL_SIZE);
+
+  /* quit the measurement */
+  return_to_main();
+}
+
+void
+task_lifecycle_benchmark(void)
+{
+  unsigned int cycles;
+
+  g_task_errors = 0;
+
+  /* create, dispatch and delete costs */
+  init_task_pool(&g_task_pool, g_task_pool_tcbs, &task_pool_stacks[0][0], D_STACK_SIZE, D_TASK_POOL_SIZE);
+  init_scheduler();
+  init_task(&g_task_creator_task, task_creator_func, task_creator_stack, D_STACK_SIZE);
+  add_task_to_list(&ready_tasks_list, &g_task_creator_task);
+  invoke_first_task();
+
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(&g_task_creator_task, &g_task_stack_usage_creator);
+#endif /* D_STACK_WATERMARK */
+
+  /* churn workload */
+  g_task_churn_result.max_alive = 0;
+  g_task_churn_result.pool_exhausted = 0;
+  g_task_alive = 0;
+  init_task_pool(&g_task_pool, g_task_pool_tcbs, &task_pool_stacks[0][0], D_STACK_SIZE, D_TASK_POOL_SIZE);
+  init_scheduler();
+  init_task(&g_task_creator_task, task_churn_supervisor_func, task_creator_stack, D_STACK_SIZE);
+  add_task_to_list(&ready_tasks_list, &g_task_creator_task);
+  invoke_first_task();
+
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(&g_task_creator_task, &g_task_stack_usage_creator);
+#endif /* D_STACK_WATERMARK */
+
+  cycles = g_task_cycles_end - g_task_cycles_start;
+  g_task_churn_result.num_of_tasks = D_TASK_CHURN_TASKS;
+  g_task_churn_result.cycles_per_task = cycles/D_TASK_CHURN_TASKS;
+  g_task_churn_result.tasks_per_sec = g_task_churn_result.cycles_per_task ? D_CORE_CLOCK_HZ/g_task_churn_result.cycles_per_task : 0;
+  g_task_errors += (g_task_churn_result.max_alive != D_TASK_POOL_SIZE);
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
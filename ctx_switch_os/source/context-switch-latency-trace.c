@@ -0,0 +1,80 @@
+
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+#include "context-switch-latency-trace.h"
+
+/*
+ * Kernel event trace - the ring buffer, and the cost of tracing measured
+ * by the benchmark itself
+ */
+
+/* events per overhead measurement */
+#define D_TRACE_OVERHEAD_EVENTS  8
+
+traceBuffer_t g_trace;
+traceOverhead_t g_trace_overhead;
+
+/*
+ * Empty the trace buffer
+ */
+void
+trace_init(void)
+{
+  g_trace.index = 0;
+  g_trace.num_of_events = D_TRACE_BUFFER_SIZE;
+  g_trace.task_cb_size = sizeof(taskCB_t);
+  g_trace.core_clock_hz = D_CORE_CLOCK_HZ;
+}
+
+/*
+ * Measure the cycles of a single event - D_TRACE_OVERHEAD_EVENTS events
+ * back to back less the cost of reading the cycle counter
+ */
+void __attribute__ ((noinline))
+trace_measure_overhead(void)
+{
+  cycles_t start, end, empty;
+
+  /* cost of the measurement itself */
+  M_READ_CYCLE_COUNTER(start);
+  M_READ_CYCLE_COUNTER(end);
+  empty = end - start;
+
+  M_READ_CYCLE_COUNTER(start);
+  M_TRACE(D_TRACE_CALL, 0, 0, g_p_current_task);
+  M_TRACE(D_TRACE_RETURN, 0, 0, g_p_current_task);
+  M_TRACE(D_TRACE_CALL, 0, 0, g_p_current_task);
+  M_TRACE(D_TRACE_RETURN, 0, 0, g_p_current_task);
+  M_TRACE(D_TRACE_CALL, 0, 0, g_p_current_task);
+  M_TRACE(D_TRACE_RETURN, 0, 0, g_p_current_task);
+  M_TRACE(D_TRACE_CALL, 0, 0, g_p_current_task);
+  M_TRACE(D_TRACE_RETURN, 0, 0, g_p_current_task);
+  M_READ_CYCLE_COUNTER(end);
+
+  g_trace_overhead.event_cycles = (end - start - empty)/D_TRACE_OVERHEAD_EVENTS;
+
+  /* the measurement events aren't part of the trace */
+  trace_init();
+}
+
+/*
+ * Account the events written since trace_init
+ */
+void
+trace_update_overhead(void)
+{
+  g_trace_overhead.num_of_events = g_trace.index;
+  g_trace_overhead.num_of_dropped = g_trace.index > D_TRACE_BUFFER_SIZE ? g_trace.index - D_TRACE_BUFFER_SIZE : 0;
+  g_trace_overhead.total_cycles = g_trace_overhead.event_cycles*g_trace.index;
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
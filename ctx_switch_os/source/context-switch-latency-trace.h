@@ -0,0 +1,130 @@
+#ifndef __CONTEXT_SWITCH_LATENCY_TRACE_H__
+#define __CONTEXT_SWITCH_LATENCY_TRACE_H__
+
+/*
+ * Kernel event trace - a RAM ring buffer of timestamped events, enabled by
+ * D_TRACE. Each event is three words: cycle counter, info and the task
+ * control block it refers to. info holds the event type (bits 7:0), the
+ * primitive id (bits 15:8) and an event value (bits 31:16).
+ * Included by C and assembly sources.
+ */
+
+/* number of events kept - a power of 2, at most 2048 (andi immediate) */
+#ifndef D_TRACE_BUFFER_SIZE
+#define D_TRACE_BUFFER_SIZE      512
+#endif /* D_TRACE_BUFFER_SIZE */
+
+/* event types */
+#define D_TRACE_SWITCH_OUT       1
+#define D_TRACE_SWITCH_IN        2
+#define D_TRACE_CALL             3
+#define D_TRACE_RETURN           4
+#define D_TRACE_BLOCK            5
+#define D_TRACE_UNBLOCK          6
+#define D_TRACE_ISR_ENTER        7
+#define D_TRACE_ISR_EXIT         8
+/* kernel entry stub (context_switch) enter/exit */
+#define D_TRACE_PSP_ENTER        9
+#define D_TRACE_PSP_EXIT         10
+
+/* primitive ids */
+#define D_TRACE_ID_EVENT_GET         1
+#define D_TRACE_ID_EVENT_SET         2
+#define D_TRACE_ID_SEMAPHORE_TAKE    3
+#define D_TRACE_ID_SEMAPHORE_GIVE    4
+#define D_TRACE_ID_QUEUE_RECEIVE     5
+#define D_TRACE_ID_QUEUE_SEND        6
+#define D_TRACE_ID_QUEUE_SEND_BATCH  7
+#define D_TRACE_ID_TASK_YIELD        8
+#define D_TRACE_ID_TASK_CREATE       9
+#define D_TRACE_ID_TASK_DELETE       10
+
+/* traceBuffer_t layout - used by the assembly macro */
+#define D_TRACE_INDEX_OFFSET     0
+#define D_TRACE_EVENTS_OFFSET    16
+/* timestamp, info and a task pointer - padded to 16 bytes on rv64 */
+#if __riscv_xlen == 64
+#define D_TRACE_EVENT_SIZE       16
+#else
+#define D_TRACE_EVENT_SIZE       12
+#endif /* __riscv_xlen */
+
+#ifndef __ASSEMBLER__
+
+/* trace event */
+typedef struct traceEvent
+{
+  /* cycle counter */
+  unsigned int  timestamp;
+  /* type | id << 8 | value << 16 */
+  unsigned int  info;
+  /* task control block the event refers to */
+  void         *p_task;
+}traceEvent_t;
+
+/* trace buffer - dumped as is by 'make run TRACE=1' */
+typedef struct traceBuffer
+{
+  /* number of events ever written - the next one goes to index % size */
+  unsigned int  index;
+  /* D_TRACE_BUFFER_SIZE */
+  unsigned int  num_of_events;
+  /* sizeof(taskCB_t) - task names of task arrays */
+  unsigned int  task_cb_size;
+  /* D_CORE_CLOCK_HZ - timestamps to time */
+  unsigned int  core_clock_hz;
+  traceEvent_t  events[D_TRACE_BUFFER_SIZE];
+}traceBuffer_t;
+
+/* tracing cost */
+typedef struct traceOverhead
+{
+  /* cpu cycles per event */
+  unsigned int  event_cycles;
+  /* events written by the benchmark */
+  unsigned int  num_of_events;
+  /* events overwritten before the dump */
+  unsigned int  num_of_dropped;
+  /* cpu cycles spent tracing - event_cycles*num_of_events */
+  unsigned int  total_cycles;
+}traceOverhead_t;
+
+#ifdef D_TRACE
+extern traceBuffer_t g_trace;
+
+/*
+ * Write a trace event
+ * info - type | id << 8 | value << 16
+ * p_task - task the event refers to
+ */
+static inline void
+trace_event(unsigned int info, void* p_task)
+{
+  traceEvent_t* p_event = &g_trace.events[g_trace.index++ & (D_TRACE_BUFFER_SIZE - 1)];
+
+  M_READ_CYCLE_COUNTER(p_event->timestamp);
+  p_event->info = info;
+  p_event->p_task = p_task;
+}
+
+void trace_init(void);
+void trace_measure_overhead(void);
+void trace_update_overhead(void);
+
+  #define M_TRACE(type, id, value, p_task) trace_event((type) | ((id) << 8) | ((value) << 16), (p_task))
+#else
+  #define M_TRACE(type, id, value, p_task)
+#endif /* D_TRACE */
+
+#define M_TRACE_SWITCH_OUT(p_task)       M_TRACE(D_TRACE_SWITCH_OUT, 0, 0, p_task)
+#define M_TRACE_SWITCH_IN(p_task)        M_TRACE(D_TRACE_SWITCH_IN, 0, 0, p_task)
+#define M_TRACE_CALL(id)                 M_TRACE(D_TRACE_CALL, id, 0, g_p_current_task)
+#define M_TRACE_RETURN(id)               M_TRACE(D_TRACE_RETURN, id, 0, g_p_current_task)
+#define M_TRACE_BLOCK(id, p_task)        M_TRACE(D_TRACE_BLOCK, id, 0, p_task)
+#define M_TRACE_UNBLOCK(id, p_task)      M_TRACE(D_TRACE_UNBLOCK, id, 0, p_task)
+#define M_TRACE_ISR_ENTER(irq)           M_TRACE(D_TRACE_ISR_ENTER, 0, irq, g_p_current_task)
+#define M_TRACE_ISR_EXIT(irq)            M_TRACE(D_TRACE_ISR_EXIT, 0, irq, g_p_current_task)
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* __CONTEXT_SWITCH_LATENCY_TRACE_H__ */
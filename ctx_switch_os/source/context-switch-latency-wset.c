@@ -0,0 +1,282 @@
+#include "context-switch-latency.h"
+#ifdef D_RISCV
+ #include "context-switch-latency-port-rv.h"
+#elif defined(D_ARM)
+ #include "context-switch-latency-port-arm.h"
+#else
+ #error "missing core definition"
+#endif /* D_RISCV */
+
+/*
+ * Working set benchmark - the indirect cost of a switch. Every thread owns
+ * a private data working set, a ring of cache lines walked in sequential or
+ * random order, and a private block of straight-line code. After each
+ * switch in, a thread times its first pass over its working set (cold, the
+ * lines the other threads evicted are refilled) and a second pass right
+ * after it (warm). The slowdown after a switch is cold - warm, measured
+ * against the direct switch cost for 1 to 8 threads and 512 bytes to
+ * D_WSET_MAX_BYTES per thread.
+ */
+
+#define D_WSET_MAX_THREADS     8
+/* 1, 2, 4, 8 threads */
+#define D_WSET_NUM_OF_COUNTS   4
+/* 512, 1K, ... D_WSET_MAX_BYTES per thread */
+#define D_WSET_MIN_BYTES       512
+#ifndef D_WSET_MAX_BYTES
+#define D_WSET_MAX_BYTES       16384
+#endif /* D_WSET_MAX_BYTES */
+#define D_WSET_NUM_OF_SIZES    6
+/* walk step - one access per cache line */
+#ifndef D_WSET_LINE_BYTES
+#define D_WSET_LINE_BYTES      32
+#endif /* D_WSET_LINE_BYTES */
+/* private code per thread, 0 for data only */
+#ifndef D_WSET_CODE_BYTES
+#define D_WSET_CODE_BYTES      1024
+#endif /* D_WSET_CODE_BYTES */
+#define D_WSET_NUM_OF_ROUNDS   8
+
+/* access patterns */
+#define D_WSET_SEQUENTIAL      0
+#define D_WSET_RANDOM          1
+#define D_WSET_NUM_OF_PATTERNS 2
+
+#define D_WSET_LINE_WORDS      (D_WSET_LINE_BYTES/sizeof(unsigned int))
+#define D_WSET_MAX_WORDS       (D_WSET_MAX_BYTES/sizeof(unsigned int))
+
+/* cost of a switch in, averaged over D_WSET_NUM_OF_ROUNDS rounds of every
+   thread */
+typedef struct wsetResult
+{
+  /* number of threads */
+  unsigned int num_of_threads;
+  /* bytes of data per thread */
+  unsigned int data_bytes;
+  /* cpu cycles from task_yield to the next thread running - direct cost */
+  unsigned int switch_cycles;
+  /* cpu cycles of the first pass after the switch in */
+  unsigned int cold_cycles;
+  /* cpu cycles of the next pass */
+  unsigned int warm_cycles;
+  /* cold - warm - indirect cost */
+  unsigned int slowdown_cycles;
+}wsetResult_t;
+
+/* tasks handlers functions */
+static void wset_thread_func(void);
+
+/* benchmark results - [pattern][thread counts x sizes] */
+wsetResult_t g_wset_results[D_WSET_NUM_OF_PATTERNS][D_WSET_NUM_OF_COUNTS*D_WSET_NUM_OF_SIZES];
+unsigned int g_wset_errors;
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_wset_stack_usage;
+#endif /* D_STACK_WATERMARK */
+
+/* threads, stacks and working sets */
+static taskCB_t g_wset_tasks[D_WSET_MAX_THREADS];
+unsigned int wset_stacks[D_WSET_MAX_THREADS][D_STACK_SIZE];
+static unsigned int g_wset_data[D_WSET_MAX_THREADS][D_WSET_MAX_WORDS] __attribute__ ((aligned (D_WSET_LINE_BYTES)));
+/* finished threads wait here forever */
+static semaphoreCB_t g_wset_park_sem;
+
+static unsigned int g_wset_num_of_threads;
+static unsigned int g_wset_num_of_lines;
+static unsigned int g_wset_next_id;
+static unsigned int g_wset_done;
+static unsigned int g_wset_switches;
+static unsigned int g_wset_switch_sum, g_wset_cold_sum, g_wset_warm_sum;
+static volatile cycles_t g_wset_switch_start;
+
+/*
+ * Private code of each thread - D_WSET_CODE_BYTES of straight-line code
+ */
+#define M_WSET_CODE_FUNC(id) \
+  static void __attribute__ ((noinline)) wset_code_##id(void) { M_RUN_NOPS(D_WSET_CODE_BYTES/4); }
+
+M_WSET_CODE_FUNC(0)
+M_WSET_CODE_FUNC(1)
+M_WSET_CODE_FUNC(2)
+M_WSET_CODE_FUNC(3)
+M_WSET_CODE_FUNC(4)
+M_WSET_CODE_FUNC(5)
+M_WSET_CODE_FUNC(6)
+M_WSET_CODE_FUNC(7)
+
+static void (* const g_wset_code[D_WSET_MAX_THREADS])(void) =
+{
+  wset_code_0, wset_code_1, wset_code_2, wset_code_3,
+  wset_code_4, wset_code_5, wset_code_6, wset_code_7
+};
+
+/*
+ * Link the first num_of_lines lines of a working set into a ring - word 0
+ * of a line holds the word index of the next line
+ */
+static void
+wset_build_ring(unsigned int* p_data, unsigned int num_of_lines, unsigned int pattern, unsigned int seed)
+{
+  unsigned int i, j, tmp;
+  /* visiting order, the ring starts at line 0 */
+  static unsigned int order[D_WSET_MAX_BYTES/D_WSET_LINE_BYTES];
+
+  for (i = 0 ; i < num_of_lines ; i++)
+  {
+    order[i] = i;
+  }
+  if (pattern == D_WSET_RANDOM)
+  {
+    /* shuffle lines 1 to n-1 - lcg, same order on every run */
+    for (i = num_of_lines - 1 ; i > 1 ; i--)
+    {
+      seed = seed*1664525 + 1013904223;
+      j = 1 + (seed >> 8) % i;
+      tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+  }
+  for (i = 0 ; i < num_of_lines ; i++)
+  {
+    p_data[order[i]*D_WSET_LINE_WORDS] = order[(i + 1) % num_of_lines]*D_WSET_LINE_WORDS;
+    p_data[order[i]*D_WSET_LINE_WORDS + 1] = 0;
+  }
+}
+
+/*
+ * One pass over a working set - the thread code, then a read and a write
+ * in every line of the ring
+ * return cpu cycles
+ */
+static unsigned int __attribute__ ((noinline))
+wset_pass(unsigned int id)
+{
+  cycles_t start, end;
+  unsigned int *p_data = g_wset_data[id];
+  unsigned int i, index = 0;
+
+  M_READ_CYCLE_COUNTER(start);
+  g_wset_code[id]();
+  for (i = 0 ; i < g_wset_num_of_lines ; i++)
+  {
+    /* the next line depends on this load */
+    p_data[index + 1]++;
+    index = p_data[index];
+  }
+  M_READ_CYCLE_COUNTER_END(end);
+
+  /* back at line 0 after a full ring */
+  g_wset_errors += (index != 0);
+
+  return end - start;
+}
+
+/*
+ * Thread - a warm-up pass, then D_WSET_NUM_OF_ROUNDS rounds of yield,
+ * cold pass and warm pass
+ */
+void wset_thread_func(void)
+{
+  unsigned int round, id, cold, warm;
+  cycles_t now;
+
+  /* the threads start in creation order */
+  id = g_wset_next_id++;
+  wset_pass(id);
+  for (round = 0 ; round < D_WSET_NUM_OF_ROUNDS ; round++)
+  {
+    M_READ_CYCLE_COUNTER(g_wset_switch_start);
+    task_yield();
+    M_READ_CYCLE_COUNTER(now);
+    cold = wset_pass(id);
+    warm = wset_pass(id);
+    g_wset_switch_sum += now - g_wset_switch_start;
+    g_wset_cold_sum += cold;
+    g_wset_warm_sum += warm;
+    g_wset_switches++;
+  }
+  /* the last thread to finish ends it */
+  if (++g_wset_done == g_wset_num_of_threads)
+  {
+    return_to_main();
+  }
+  /* the switch from here is measured as well */
+  M_READ_CYCLE_COUNTER(g_wset_switch_start);
+  semaphore_take(&g_wset_park_sem, D_WAIT_FOREVER);
+}
+
+/*
+ * Run num_of_threads threads with data_bytes working sets of a pattern
+ * p_result - averages per switch in
+ */
+static void
+wset_run(unsigned int num_of_threads, unsigned int data_bytes, unsigned int pattern, wsetResult_t* p_result)
+{
+  unsigned int i;
+
+  g_wset_num_of_threads = num_of_threads;
+  g_wset_num_of_lines = data_bytes/D_WSET_LINE_BYTES;
+  g_wset_next_id = 0;
+  g_wset_done = 0;
+  g_wset_switches = 0;
+  g_wset_switch_sum = 0;
+  g_wset_cold_sum = 0;
+  g_wset_warm_sum = 0;
+  init_semaphore(&g_wset_park_sem);
+  init_scheduler();
+  for (i = 0 ; i < num_of_threads ; i++)
+  {
+    wset_build_ring(g_wset_data[i], g_wset_num_of_lines, pattern, i + 1);
+    init_task(&g_wset_tasks[i], wset_thread_func, wset_stacks[i], D_STACK_SIZE);
+    add_task_to_list(&ready_tasks_list, &g_wset_tasks[i]);
+  }
+  invoke_first_task();
+
+  g_wset_errors += (g_wset_switches != num_of_threads*D_WSET_NUM_OF_ROUNDS);
+#ifdef D_STACK_WATERMARK
+  update_task_stack_usage(&g_wset_tasks[0], &g_wset_stack_usage);
+#endif /* D_STACK_WATERMARK */
+
+  p_result->num_of_threads = num_of_threads;
+  p_result->data_bytes = data_bytes;
+  p_result->switch_cycles = g_wset_switch_sum/g_wset_switches;
+  p_result->cold_cycles = g_wset_cold_sum/g_wset_switches;
+  p_result->warm_cycles = g_wset_warm_sum/g_wset_switches;
+  p_result->slowdown_cycles = 0;
+  if (p_result->cold_cycles > p_result->warm_cycles)
+  {
+    p_result->slowdown_cycles = p_result->cold_cycles - p_result->warm_cycles;
+  }
+}
+
+/*
+ * Working set benchmark - every pattern, thread count and size
+ */
+void wset_benchmark(void)
+{
+  unsigned int pattern, count, size;
+
+  g_wset_errors = 0;
+  for (pattern = 0 ; pattern < D_WSET_NUM_OF_PATTERNS ; pattern++)
+  {
+    for (count = 0 ; count < D_WSET_NUM_OF_COUNTS ; count++)
+    {
+      for (size = 0 ; size < D_WSET_NUM_OF_SIZES ; size++)
+      {
+        if ((D_WSET_MIN_BYTES << size) > D_WSET_MAX_BYTES)
+        {
+          break;
+        }
+        wset_run(1 << count, D_WSET_MIN_BYTES << size, pattern,
+                 &g_wset_results[pattern][count*D_WSET_NUM_OF_SIZES + size]);
+      }
+    }
+  }
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
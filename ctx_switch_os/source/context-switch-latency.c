@@ -2,96 +2,39 @@
 #include "context-switch-latency.h"
 #ifdef D_RISCV
  #include "context-switch-latency-port-rv.h"
+#elif defined(D_ARM)
+ #include "context-switch-latency-port-arm.h"
 #else 
  #error "missing core definition" 
 #endif /* D_RISCV */
+#include "context-switch-latency-trace.h"
+#include "context-switch-latency-critical.h"
+#include "context-switch-latency-isr.h"
+
+#include <string.h>
 
 #define D_LOOP_COUNT     2
 #define D_NUM_OF_TASKS   2
-#define D_STACK_SIZE     64
 #define D_EVENT_BITS     0x51
-#define D_AND            1
-#define D_OR             2
-#define D_CLEAR_BITS     4
-#define D_WAIT_FOREVER   0
-#define D_MAX_QUEUE_SIZE 5
-
-/* task handler function definition */
-typedef void (*task_handler)(void);
+/* idle stack in words - an isr frame and a switch nest on it while idle */
+#ifdef D_ISR_DEFER
+#define D_IDLE_STACK_SIZE (4*D_STACK_SIZE)
+#else
+#define D_IDLE_STACK_SIZE D_STACK_SIZE
+#endif /* D_ISR_DEFER */
+
 /* tasks stack */
 unsigned int task0_stack[D_STACK_SIZE];
 unsigned int task1_stack[D_STACK_SIZE];
-unsigned int main_stack;
-
-/* task list node */
-typedef struct taskNode_t
-{
-  /* owner of this node */
-  void *p_owner;
-  /* next task node */
-  struct taskNode_t *pNextTaskNode;
-}taskNode_t;
-
-/* task list */
-typedef struct taskList
-{
-  /* link to the first task node */
-  taskNode_t *pNextTaskNode;
-  /* task pointed by this node */
-  unsigned int node_count;
-}taskList_t;
-
-/* task control block */
-typedef struct taskCB
-{
-  /* task stack address */
-  void         *pStack;
-  /* task handler function */
-  task_handler  func;
-  /* task node */
-  taskNode_t node;
-}taskCB_t;
-
-/* semaphore control block */
-typedef struct semaphoreCB
-{
-  /* semaphore counter */
-  unsigned int  counter;
-  /* semaphore max count */
-  unsigned int  max_count;
-  /* pending tasks */
-  unsigned int  pending_tasks;
-}semaphoreCB_t;
-
-/* event control block */
-typedef struct eventCB
-{
-  /* event bits */
-  unsigned int  expected_bits;
-  /* wait condition */
-  unsigned int  expected_bits_state;
-  /* pending tasks list */
-  unsigned int  pending_tasks;
-}eventCB_t;
-
-/* event control block */
-typedef struct queueCB
-{
-  /* queue */
-  unsigned int queue[D_MAX_QUEUE_SIZE];
-  /* queue push index */
-  unsigned int  push_index;
-  /* queue pop index */
-  unsigned int  pop_index;
-  /* queue number of items in the queue */
-  unsigned int  num_of_items;
-  /* pending task */
-  unsigned int  pending_tasks;
-}queueCB_t;
+unsigned int idle_stack[D_IDLE_STACK_SIZE];
+void* main_stack;
+/* main stack bounds - provided by the linker script */
+extern unsigned int _heap_end[], _sp[];
 
 /* tasks handlers functions */
 static void task0_func(void);
 static void task1_func(void);
+static void idle_task_func(void);
 
 /* global variables */
 taskCB_t *g_p_current_task;
@@ -103,17 +46,39 @@ static volatile cycles_t g_num_of_cycles_task_yield_end;
 static semaphoreCB_t g_sem;
 static eventCB_t     g_event;
 static queueCB_t     g_queue;
-static taskList_t    ready_tasks_list, pending_tasks_list;
+taskList_t           ready_tasks_list;
+#ifdef D_CRITICAL_SECTIONS
+/* critical section nesting and the interrupts state it restores */
+unsigned int         g_critical_nesting;
+unsigned int         g_critical_int_state;
+#endif /* D_CRITICAL_SECTIONS */
+#ifdef D_ISR_DEFER
+/* deferred switch state */
+volatile unsigned int g_isr_nesting;
+volatile unsigned int g_isr_reschedule;
+volatile unsigned int g_switch_committed;
+unsigned int          g_isr_switches;
+#endif /* D_ISR_DEFER */
+#ifdef D_SCHED_EDF
+/* scheduling mode - D_SCHED_POLICY_*, FIFO once init_scheduler ran */
+unsigned int          g_sched_policy;
+#endif /* D_SCHED_EDF */
+#ifdef D_STACK_WATERMARK
+stackUsage_t g_stack_usage_tasks[D_NUM_OF_TASKS];
+stackUsage_t g_stack_usage_idle;
+stackUsage_t g_stack_usage_main;
+#endif /* D_STACK_WATERMARK */
 
 taskCB_t g_tasks_list[D_NUM_OF_TASKS] = {
 		{0, task0_func, { 0, 0 }},
 		{0, task1_func, { 0, 0 }},
 };
 
+/* idle task - never placed in the ready list */
+taskCB_t g_idle_task = {0, idle_task_func, { 0, 0 }};
+
 void add_task_to_list(taskList_t* pList, taskCB_t* p_task)
 {
-  taskNode_t *p_node;
-
   /* is the list empty */
   if (pList->node_count == 0)
   {
@@ -122,18 +87,13 @@ void add_task_to_list(taskList_t* pList, taskCB_t* p_task)
   }
   else
   {
-    /* loop until we find the last item */
-    p_node = pList->pNextTaskNode;
-    while (p_node->pNextTaskNode)
-    {
-      p_node = p_node->pNextTaskNode;
-    }
     /* last item should point to current task */
-    p_node->pNextTaskNode = &p_task->node;
+    pList->pLastTaskNode->pNextTaskNode = &p_task->node;
   }
 
   /* now this is the last item in the list */
   p_task->node.pNextTaskNode = 0;
+  pList->pLastTaskNode = &p_task->node;
 
   /* increment nodes count */
   pList->node_count++;
@@ -167,6 +127,125 @@ taskNode_t* remove_head_from_list(taskList_t* pList)
   return p_node;
 }
 
+/*
+ * remove a node from the middle of a given list
+ * pList  - the list to remove from
+ * p_prev - the node preceding p_node, 0 if p_node is the list head
+ * p_node - the node to remove
+ */
+void remove_node_from_list(taskList_t* pList, taskNode_t* p_prev, taskNode_t* p_node)
+{
+  /* unlink the node */
+  if (p_prev == 0)
+  {
+    pList->pNextTaskNode = p_node->pNextTaskNode;
+  }
+  else
+  {
+    p_prev->pNextTaskNode = p_node->pNextTaskNode;
+  }
+  /* was it the last node */
+  if (pList->pLastTaskNode == p_node)
+  {
+    pList->pLastTaskNode = p_prev;
+  }
+  /* clear the 'next node' of the removed node */
+  p_node->pNextTaskNode = 0;
+  /* decrement nodes count */
+  pList->node_count--;
+}
+
+/*
+ * Make a task ready - the FIFO ready list, or the ready structure of the
+ * fixed-priority or EDF mode
+ */
+static inline void
+add_ready_task(taskCB_t* p_task)
+{
+#ifdef D_SCHED_EDF
+  if (g_sched_policy != D_SCHED_POLICY_FIFO)
+  {
+    sched_add_ready(p_task);
+    return;
+  }
+#endif /* D_SCHED_EDF */
+  add_task_to_list(&ready_tasks_list, p_task);
+}
+
+/*
+ * Number of ready tasks
+ */
+static inline unsigned int
+num_of_ready_tasks(void)
+{
+#ifdef D_SCHED_EDF
+  if (g_sched_policy != D_SCHED_POLICY_FIFO)
+  {
+    return sched_num_of_ready();
+  }
+#endif /* D_SCHED_EDF */
+  return ready_tasks_list.node_count;
+}
+
+/*
+ * Remove the next task to run from the ready tasks - there is one
+ */
+static inline taskCB_t*
+take_ready_task(void)
+{
+#ifdef D_SCHED_EDF
+  if (g_sched_policy != D_SCHED_POLICY_FIFO)
+  {
+    return sched_take_ready();
+  }
+#endif /* D_SCHED_EDF */
+  return (taskCB_t*)remove_head_from_list(&ready_tasks_list)->p_owner;
+}
+
+/*
+ * Give the cpu to the ready tasks, the running task goes behind them -
+ * called in a critical section, left before the switch. From an isr the
+ * switch is only marked; isr_switch does it once for every wake up
+ */
+static inline void
+reschedule(void)
+{
+  if (M_IN_ISR())
+  {
+#ifdef D_ISR_DEFER
+    g_isr_reschedule = 1;
+#endif /* D_ISR_DEFER */
+    M_CRITICAL_EXIT();
+    return;
+  }
+  /* add g_p_current_task to the ready task list (needed for the simulation) */
+  add_ready_task(g_p_current_task);
+  M_SWITCH_COMMIT();
+  M_CRITICAL_EXIT();
+  /* switch to other task */
+  M_CONTEXT_SWITCH();
+}
+
+/*
+ * wake the head task pending a given wait list and switch to it - called
+ * in a critical section, left before the switch
+ * p_wait_list - the object wait list
+ * trace_id - primitive waking the task (D_TRACE_ID_*)
+ */
+static void
+wake_pending_task(taskList_t* p_wait_list, unsigned int trace_id __attribute__ ((unused)))
+{
+  taskNode_t* p_node;
+
+  /* remove the pending task from the list */
+  p_node = remove_head_from_list(p_wait_list);
+  M_TRACE_UNBLOCK(trace_id, p_node->p_owner);
+  /* add the removed node to the ready task list */
+  add_ready_task(p_node->p_owner);
+  /* switch to other task */
+  reschedule();
+}
+
 /*
  * Read event bits
  * p_event - event handle
@@ -174,76 +253,118 @@ taskNode_t* remove_head_from_list(taskList_t* pList)
  * bits_condition - can be D_AND/D_OR and D_CLEAR_BITS
  * wait_time - wait timeout (support D_WAIT_FOREVER only as we have no actual timer)
  */
-static unsigned int __attribute__ ((noinline))
+unsigned int __attribute__ ((noinline))
 event_get(eventCB_t *p_event, unsigned int get_bits, unsigned int bits_condition, unsigned int wait_time)
 {
   unsigned int bits;
-  /* loop until event received as expected */
-  while (1)
+
+  M_TRACE_CALL(D_TRACE_ID_EVENT_GET);
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_EVENT_GET);
+
+  /* get the set bits */
+  bits = p_event->expected_bits & get_bits;
+  /* if all/some bits are set */
+  if ((bits_condition & D_AND && bits == get_bits) || ((bits_condition & D_OR && bits)))
   {
-    /* get the set bits */
-    bits = p_event->expected_bits & get_bits;
-    /* if all/some bits are set */
-    if ((bits_condition & D_AND && bits == get_bits) || ((bits_condition & D_OR && bits)))
-    {
-      /* do we need to clear the bits */
-      if (bits_condition & D_CLEAR_BITS)
-      {
-         p_event->expected_bits &= ~bits;
-      }
-      /* we got what we wanted */
-      break;
-    }
-    /* for a zero wait_time, we only switch context w/o
-       any real timer */
-    else if (wait_time == 0)
+    /* do we need to clear the bits */
+    if (bits_condition & D_CLEAR_BITS)
     {
-      /* add current task to be pending */
-      add_task_to_list(&pending_tasks_list, g_p_current_task);
-      /* mark we have a waiting list */
-      p_event->pending_tasks++;
-      /* switch to other task */
-      context_switch();
-      /* we completed the event_set */
-      M_READ_CYCLE_COUNTER(g_num_of_cycles_event_set_end);
-      g_num_of_cycles_event_set_end -= g_num_of_cycles_start;
-    }
-    else
-    {
-      return 0;
+       p_event->expected_bits &= ~bits;
     }
+    M_CRITICAL_EXIT();
+  }
+  /* for a zero wait_time, we only switch context w/o
+     any real timer */
+  else if (wait_time == D_WAIT_FOREVER)
+  {
+    /* record what we are waiting for - event_set evaluates it */
+    g_p_current_task->event_bits = get_bits;
+    g_p_current_task->event_condition = bits_condition;
+    /* add current task to the event wait list */
+    add_task_to_list(&p_event->pending_tasks, g_p_current_task);
+    M_TRACE_BLOCK(D_TRACE_ID_EVENT_GET, g_p_current_task);
+    M_SWITCH_COMMIT();
+    M_CRITICAL_EXIT();
+    /* switch to other task */
+    M_CONTEXT_SWITCH();
+    /* we completed the event_set */
+    M_READ_CYCLE_COUNTER(g_num_of_cycles_event_set_end);
+    g_num_of_cycles_event_set_end -= g_num_of_cycles_start;
+    /* event_set handed over the bits that released us */
+    bits = g_p_current_task->event_bits;
+  }
+  else
+  {
+    M_CRITICAL_EXIT();
+    M_TRACE_RETURN(D_TRACE_ID_EVENT_GET);
+    return 0;
   }
 
+  M_TRACE_RETURN(D_TRACE_ID_EVENT_GET);
   /* return the bits we got */
   return bits;
 }
 
 /*
- * Set an event bits
+ * Set an event bits - wake every pending task whose condition is met
  * p_event - event handle
  * set_bits - bits to set
  */
-static void __attribute__ ((noinline))
+void __attribute__ ((noinline))
 event_set(eventCB_t *p_event, unsigned int set_bits)
 {
-  taskNode_t* p_node;
+  taskNode_t *p_node, *p_prev, *p_next;
+  taskCB_t *p_task;
+  unsigned int bits, clear_bits = 0, woken = 0;
+
+  M_TRACE_CALL(D_TRACE_ID_EVENT_SET);
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_EVENT_SET);
 
   /* set the bits */
   p_event->expected_bits |= set_bits;
-  /* check if there are pending tasks */
-  if (p_event->pending_tasks != 0)
-  {
-    /* remove the pending task from the list */
-    p_node = remove_head_from_list(&pending_tasks_list);
-    /* add the removed node to the ready task list */
-    add_task_to_list(&ready_tasks_list, p_node->p_owner);
-    /* add g_p_current_task to the ready task list (needed for the simulation) */
-    add_task_to_list(&ready_tasks_list, g_p_current_task);
-    /* if no other pending tasks */
-    p_event->pending_tasks--;
+
+  /* evaluate each pending task against the new bits */
+  p_prev = 0;
+  for (p_node = p_event->pending_tasks.pNextTaskNode ; p_node != 0 ; p_node = p_next)
+  {
+    p_next = p_node->pNextTaskNode;
+    p_task = p_node->p_owner;
+    bits = p_event->expected_bits & p_task->event_bits;
+    /* if all/some bits are set */
+    if ((p_task->event_condition & D_AND && bits == p_task->event_bits) ||
+        ((p_task->event_condition & D_OR && bits)))
+    {
+      /* bits are cleared once all tasks were evaluated */
+      if (p_task->event_condition & D_CLEAR_BITS)
+      {
+        clear_bits |= bits;
+      }
+      /* hand over the bits and make the task ready */
+      p_task->event_bits = bits;
+      remove_node_from_list(&p_event->pending_tasks, p_prev, p_node);
+      M_TRACE_UNBLOCK(D_TRACE_ID_EVENT_SET, p_task);
+      add_ready_task(p_task);
+      woken++;
+    }
+    else
+    {
+      p_prev = p_node;
+    }
+  }
+
+  /* were any tasks released */
+  if (woken != 0)
+  {
+    p_event->expected_bits &= ~clear_bits;
     /* switch to other task */
-    context_switch();
+    reschedule();
   }
+  else
+  {
+    M_CRITICAL_EXIT();
+  }
+
+  M_TRACE_RETURN(D_TRACE_ID_EVENT_SET);
 }
 
 /*
@@ -252,17 +373,22 @@ event_set(eventCB_t *p_event, unsigned int set_bits)
  * wait_time - wait timeout in case semaphore isn't available
  *            (support D_WAIT_FOREVER only as we have no actual timer)
  */
-static unsigned int __attribute__ ((noinline))
+unsigned int __attribute__ ((noinline))
 semaphore_take(semaphoreCB_t* p_sem, unsigned int wait_time)
 {
+  M_TRACE_CALL(D_TRACE_ID_SEMAPHORE_TAKE);
+
   /* loop until semaphore is available */
   while (1)
   {
+    M_CRITICAL_ENTER(D_CRITICAL_SITE_SEMAPHORE_TAKE);
     /* is semaphore available */
     if (p_sem->counter && p_sem->counter <= p_sem->max_count)
     {
       /* decrement counter */
       p_sem->counter--;
+      M_CRITICAL_EXIT();
+      M_TRACE_RETURN(D_TRACE_ID_SEMAPHORE_TAKE);
       /* semaphore is taken */
       return 1;
     }
@@ -270,12 +396,13 @@ semaphore_take(semaphoreCB_t* p_sem, unsigned int wait_time)
        any real timer */
     else if (wait_time == D_WAIT_FOREVER)
     {
-      /* add current task to be pending */
-      add_task_to_list(&pending_tasks_list, g_p_current_task);
-      /* mark we have a waiting list */
-      p_sem->pending_tasks++;
+      /* add current task to the semaphore wait list */
+      add_task_to_list(&p_sem->pending_tasks, g_p_current_task);
+      M_TRACE_BLOCK(D_TRACE_ID_SEMAPHORE_TAKE, g_p_current_task);
+      M_SWITCH_COMMIT();
+      M_CRITICAL_EXIT();
       /* switch to other task */
-      context_switch();
+      M_CONTEXT_SWITCH();
       /* measure semaphore_give cycles */
       M_READ_CYCLE_COUNTER(g_num_of_cycles_semaphore_give_end);
       g_num_of_cycles_semaphore_give_end -= g_num_of_cycles_start;
@@ -283,9 +410,11 @@ semaphore_take(semaphoreCB_t* p_sem, unsigned int wait_time)
     /* no wait time */
     else
     {
+      M_CRITICAL_EXIT();
       break;
     }
   }
+  M_TRACE_RETURN(D_TRACE_ID_SEMAPHORE_TAKE);
   /* semaphore not available */
   return 0;
 }
@@ -294,10 +423,11 @@ semaphore_take(semaphoreCB_t* p_sem, unsigned int wait_time)
  * Release a semaphore
  * p_sem - semaphore handle
  */
-static unsigned int __attribute__ ((noinline))
+unsigned int __attribute__ ((noinline))
 semaphore_give(semaphoreCB_t* p_sem)
 {
-  taskNode_t* p_node;
+  M_TRACE_CALL(D_TRACE_ID_SEMAPHORE_GIVE);
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_SEMAPHORE_GIVE);
 
   /* verify semaphore counter */
   if (p_sem->counter < p_sem->max_count)
@@ -305,22 +435,21 @@ semaphore_give(semaphoreCB_t* p_sem)
     /* increment counter */
     p_sem->counter++;
     /* if tasks are pending this semaphore */
-    if (p_sem->pending_tasks != 0)
+    if (p_sem->pending_tasks.node_count != 0)
     {
-      /* remove the pending task from the list */
-      p_node = remove_head_from_list(&pending_tasks_list);
-      /* add the removed node to the ready task list */
-      add_task_to_list(&ready_tasks_list, p_node->p_owner);
-      /* add g_p_current_task to the ready task list (needed for the simulation) */
-      add_task_to_list(&ready_tasks_list, g_p_current_task);
-      /* decrement pending tasks */
-      p_sem->pending_tasks--;
-      /* switch to other task */
-      context_switch();
+      /* wake the first pending task and switch to it */
+      wake_pending_task(&p_sem->pending_tasks, D_TRACE_ID_SEMAPHORE_GIVE);
+    }
+    else
+    {
+      M_CRITICAL_EXIT();
     }
+    M_TRACE_RETURN(D_TRACE_ID_SEMAPHORE_GIVE);
     /* semaphore given */
     return 1;
   }
+  M_CRITICAL_EXIT();
+  M_TRACE_RETURN(D_TRACE_ID_SEMAPHORE_GIVE);
   /* semaphore not given */
   return 0;
 }
@@ -331,12 +460,15 @@ semaphore_give(semaphoreCB_t* p_sem)
  * p_item - the read item
  * wait_time - wait timeout (support D_WAIT_FOREVER only as we have no actual timer)
  */
-static int __attribute__ ((noinline))
+int __attribute__ ((noinline))
 queue_receive(queueCB_t* p_queue, unsigned int *p_item, unsigned int wait_time)
 {
+  M_TRACE_CALL(D_TRACE_ID_QUEUE_RECEIVE);
+
   /* loop until we get a queue item */
   while (1)
   {
+    M_CRITICAL_ENTER(D_CRITICAL_SITE_QUEUE_RECEIVE);
     /* check if the queue is none empty */
     if (p_queue->num_of_items != 0)
     {
@@ -346,28 +478,33 @@ queue_receive(queueCB_t* p_queue, unsigned int *p_item, unsigned int wait_time)
       p_queue->pop_index = (p_queue->pop_index + 1) % D_MAX_QUEUE_SIZE;
       /* decrement number of items in the queue */
       p_queue->num_of_items--;
+      M_CRITICAL_EXIT();
+      M_TRACE_RETURN(D_TRACE_ID_QUEUE_RECEIVE);
       return 1;
     }
     /* for a zero wait_time, we only switch context w/o
        any real timer */
     else if (wait_time == D_WAIT_FOREVER)
     {
-      /* add current task to be pending */
-      add_task_to_list(&pending_tasks_list, g_p_current_task);
-      /* mark we have a waiting task */
-      p_queue->pending_tasks++;
+      /* add current task to the queue wait list */
+      add_task_to_list(&p_queue->pending_tasks, g_p_current_task);
+      M_TRACE_BLOCK(D_TRACE_ID_QUEUE_RECEIVE, g_p_current_task);
+      M_SWITCH_COMMIT();
+      M_CRITICAL_EXIT();
       /* switch to other task */
-      context_switch();
+      M_CONTEXT_SWITCH();
       /* measure queue_send cycles */
       M_READ_CYCLE_COUNTER(g_num_of_cycles_queue_send_end);
       g_num_of_cycles_queue_send_end -= g_num_of_cycles_start;
     }
     else
     {
+      M_CRITICAL_EXIT();
       break;
     }
   }
 
+  M_TRACE_RETURN(D_TRACE_ID_QUEUE_RECEIVE);
   /* fail to get a queue item */
   return 0;
 }
@@ -377,55 +514,156 @@ queue_receive(queueCB_t* p_queue, unsigned int *p_item, unsigned int wait_time)
  * p_queue - queue handle
  * p_item - the item to write
  */
-static int __attribute__ ((noinline))
+int __attribute__ ((noinline))
 queue_send(queueCB_t* p_queue, unsigned int *p_item)
 {
-  taskNode_t* p_node;
+  M_TRACE_CALL(D_TRACE_ID_QUEUE_SEND);
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_QUEUE_SEND);
 
   /* check if the queue is full */
   if (p_queue->num_of_items == D_MAX_QUEUE_SIZE)
   {
+    M_CRITICAL_EXIT();
+    M_TRACE_RETURN(D_TRACE_ID_QUEUE_SEND);
     return 0;
   }
 
   /* write queue item */
   p_queue->queue[p_queue->push_index] = *p_item;
   /* increment push index */
-  p_queue->push_index = (p_queue->pop_index + 1) % D_MAX_QUEUE_SIZE;
+  p_queue->push_index = (p_queue->push_index + 1) % D_MAX_QUEUE_SIZE;
   /* increment number of items in the queue */
   p_queue->num_of_items++;
 
   /* if tasks are pending this queue */
-  if (p_queue->pending_tasks != 0)
-  {
-    /* remove the pending task from the list */
-    p_node = remove_head_from_list(&pending_tasks_list);
-    /* add the removed node to the ready task list */
-    add_task_to_list(&ready_tasks_list, p_node->p_owner);
-    /* add g_p_current_task to the ready task list (needed for the simulation) */
-    add_task_to_list(&ready_tasks_list, g_p_current_task);
-    /* decrement pending tasks */
-    p_queue->pending_tasks--;
-    /* switch to other task */
-    context_switch();
+  if (p_queue->pending_tasks.node_count != 0)
+  {
+    /* wake the first pending task and switch to it */
+    wake_pending_task(&p_queue->pending_tasks, D_TRACE_ID_QUEUE_SEND);
     /* measure yield cycles */
     M_READ_CYCLE_COUNTER(g_num_of_cycles_task_yield_end);
     g_num_of_cycles_task_yield_end -= g_num_of_cycles_start;
   }
+  else
+  {
+    M_CRITICAL_EXIT();
+  }
 
+  M_TRACE_RETURN(D_TRACE_ID_QUEUE_SEND);
   return 1;
 }
 
+/*
+ * Read an item from a message queue
+ * p_queue - message queue handle
+ * p_item - the read item (item_size bytes)
+ * wait_time - wait timeout (support D_WAIT_FOREVER only as we have no actual timer)
+ */
+int __attribute__ ((noinline))
+msg_queue_receive(msgQueueCB_t* p_queue, void *p_item, unsigned int wait_time)
+{
+  M_TRACE_CALL(D_TRACE_ID_QUEUE_RECEIVE);
+
+  /* loop until we get a queue item */
+  while (1)
+  {
+    M_CRITICAL_ENTER(D_CRITICAL_SITE_QUEUE_RECEIVE);
+    /* check if the queue is none empty */
+    if (p_queue->num_of_items != 0)
+    {
+      /* read queue item */
+      memcpy(p_item, (unsigned char*)p_queue->p_storage + p_queue->pop_index*p_queue->item_size, p_queue->item_size);
+      /* increment pop index */
+      p_queue->pop_index = (p_queue->pop_index + 1) % p_queue->max_items;
+      /* decrement number of items in the queue */
+      p_queue->num_of_items--;
+      M_CRITICAL_EXIT();
+      M_TRACE_RETURN(D_TRACE_ID_QUEUE_RECEIVE);
+      return 1;
+    }
+    /* for a zero wait_time, we only switch context w/o
+       any real timer */
+    else if (wait_time == D_WAIT_FOREVER)
+    {
+      /* add current task to the queue wait list */
+      add_task_to_list(&p_queue->pending_tasks, g_p_current_task);
+      M_TRACE_BLOCK(D_TRACE_ID_QUEUE_RECEIVE, g_p_current_task);
+      M_SWITCH_COMMIT();
+      M_CRITICAL_EXIT();
+      /* switch to other task */
+      M_CONTEXT_SWITCH();
+    }
+    else
+    {
+      M_CRITICAL_EXIT();
+      break;
+    }
+  }
+
+  M_TRACE_RETURN(D_TRACE_ID_QUEUE_RECEIVE);
+  /* fail to get a queue item */
+  return 0;
+}
+
+/*
+ * Write several items to a message queue with a single wake up (and
+ * context switch)
+ * p_queue - message queue handle
+ * p_items - the items to write (num_of_items consecutive items)
+ * num_of_items - number of items to write
+ * return the number of items written
+ */
+unsigned int __attribute__ ((noinline))
+msg_queue_send_batch(msgQueueCB_t* p_queue, void *p_items, unsigned int num_of_items)
+{
+  unsigned int count;
+
+  M_TRACE_CALL(D_TRACE_ID_QUEUE_SEND_BATCH);
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_QUEUE_SEND_BATCH);
+
+  /* write as many items as the queue can hold */
+  for (count = 0 ; count < num_of_items ; count++)
+  {
+    /* check if the queue is full */
+    if (p_queue->num_of_items == p_queue->max_items)
+    {
+      break;
+    }
+    /* write queue item */
+    memcpy((unsigned char*)p_queue->p_storage + p_queue->push_index*p_queue->item_size,
+           (unsigned char*)p_items + count*p_queue->item_size, p_queue->item_size);
+    /* increment push index */
+    p_queue->push_index = (p_queue->push_index + 1) % p_queue->max_items;
+    /* increment number of items in the queue */
+    p_queue->num_of_items++;
+  }
+
+  /* wake a pending task once for the whole batch */
+  if (count != 0 && p_queue->pending_tasks.node_count != 0)
+  {
+    /* wake the first pending task and switch to it */
+    wake_pending_task(&p_queue->pending_tasks, D_TRACE_ID_QUEUE_SEND_BATCH);
+  }
+  else
+  {
+    M_CRITICAL_EXIT();
+  }
+
+  M_TRACE_RETURN(D_TRACE_ID_QUEUE_SEND_BATCH);
+  return count;
+}
+
 /*
  * Yield CPU time to another task
  */
-static void __attribute__ ((noinline))
+void __attribute__ ((noinline))
 task_yield(void)
 {
-  /* add g_p_current_task to the ready task list (needed for the simulation) */
-  add_task_to_list(&ready_tasks_list, g_p_current_task);
+  M_TRACE_CALL(D_TRACE_ID_TASK_YIELD);
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_TASK_YIELD);
   /* switch to other task */
-  context_switch();
+  reschedule();
+  M_TRACE_RETURN(D_TRACE_ID_TASK_YIELD);
 }
 
 /*
@@ -465,6 +703,31 @@ void task1_func(void)
   return_to_main();
 }
 
+/*
+ * Idle task function - runs when no other task is ready; only interrupts
+ * make a task ready again, so it is reached in D_ISR_DEFER builds only (the
+ * other benchmarks always leave a task ready). The wake-from-wfi latency
+ * is measured by irq_latency (D_CORE_HAS_WFI)
+ */
+void idle_task_func(void)
+{
+#ifdef D_ISR_DEFER
+  /* the switch that first runs the idle task has interrupts masked */
+  M_ENABLE_INTERRUPTS();
+#endif /* D_ISR_DEFER */
+  while (1)
+  {
+    /* sleep until an interrupt arrives */
+    M_WAIT_FOR_INTERRUPT();
+    /* did the interrupt make a task ready */
+    if (num_of_ready_tasks() != 0)
+    {
+      /* switch to the ready task; we return here once nothing is ready */
+      M_CONTEXT_SWITCH();
+    }
+  }
+}
+
 /*
  * Select the next running task
  * p_task_sp - current task sp
@@ -472,20 +735,75 @@ void task1_func(void)
  */
 void* select_next_task(void* p_task_sp)
 {
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_SCHEDULER);
   /* if a task is already running */
   if (g_p_current_task != 0)
   {
     /* save current task sp */
     g_p_current_task->pStack = p_task_sp;
+    M_TRACE_SWITCH_OUT(g_p_current_task);
   }
 
-  /* get the next ready task */
-  g_p_current_task = (taskCB_t*)remove_head_from_list(&ready_tasks_list)->p_owner;
+  /* if no task is ready - idle */
+  if (num_of_ready_tasks() == 0)
+  {
+    g_p_current_task = &g_idle_task;
+  }
+  else
+  {
+    /* get the next ready task */
+    g_p_current_task = take_ready_task();
+  }
+  M_TRACE_SWITCH_IN(g_p_current_task);
+#ifdef D_ISR_DEFER
+  /* this switch serves any reschedule the isrs marked */
+  g_switch_committed = 0;
+  g_isr_reschedule = 0;
+#endif /* D_ISR_DEFER */
+#ifdef D_PMP_TASKS
+  /* isolated task - load its regions; other tasks run in machine mode
+     where unlocked regions don't apply, so they keep the loaded ones */
+  if (g_p_current_task->p_pmp != 0)
+  {
+    pmp_switch(g_p_current_task->p_pmp);
+  }
+#endif /* D_PMP_TASKS */
+  M_CRITICAL_EXIT();
 
   /* return sp of the newly selected task */
   return g_p_current_task->pStack;
 }
 
+#ifdef D_ISR_DEFER
+/*
+ * Deferred switch - called with interrupts masked on the way out of the
+ * outermost isr or in the pended interrupt. Switches to the tasks the isrs
+ * made ready, once for all of their wake ups, unless the interrupted task
+ * is committed to a switch of its own
+ */
+void
+isr_switch(void)
+{
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_SCHEDULER);
+  if (g_isr_reschedule == 0 || g_switch_committed != 0 || g_p_current_task == 0)
+  {
+    M_CRITICAL_EXIT();
+    return;
+  }
+  /* the interrupted task goes behind the woken ones - the idle task is
+     never in the ready list */
+  if (g_p_current_task != &g_idle_task)
+  {
+    add_ready_task(g_p_current_task);
+  }
+  g_switch_committed = 1;
+  g_isr_switches++;
+  M_CRITICAL_EXIT();
+  /* switch to other task - the interrupted one resumes here */
+  context_switch();
+}
+#endif /* D_ISR_DEFER */
+
 int
 verify_benchmark (int res __attribute ((unused)))
 {
@@ -520,7 +838,7 @@ void init_semaphore(semaphoreCB_t* p_sem)
 {
    p_sem->counter = 0;
    p_sem->max_count = 1;
-   p_sem->pending_tasks = 0;
+   p_sem->pending_tasks.node_count = 0;
 }
 
 /*
@@ -530,7 +848,7 @@ void init_event(eventCB_t* p_event)
 {
   p_event->expected_bits = 0;
   p_event->expected_bits_state = 0;
-  p_event->pending_tasks = 0;
+  p_event->pending_tasks.node_count = 0;
 }
 
 /*
@@ -541,7 +859,300 @@ void init_queue(queueCB_t* p_queue)
   p_queue->push_index = 0;
   p_queue->pop_index = 0;
   p_queue->num_of_items = 0;
-  p_queue->pending_tasks = 0;
+  p_queue->pending_tasks.node_count = 0;
+}
+
+/*
+ * initialize message queue
+ * p_storage - queue storage, at least max_items*item_size bytes
+ * item_size - item size in bytes
+ * max_items - max number of items in the queue
+ */
+void init_msg_queue(msgQueueCB_t* p_queue, void* p_storage, unsigned int item_size, unsigned int max_items)
+{
+  p_queue->p_storage = p_storage;
+  p_queue->item_size = item_size;
+  p_queue->max_items = max_items;
+  p_queue->push_index = 0;
+  p_queue->pop_index = 0;
+  p_queue->num_of_items = 0;
+  p_queue->pending_tasks.node_count = 0;
+}
+
+/*
+ * initialize a memory pool of fixed-size blocks
+ * p_storage - pool storage, at least num_of_blocks*block_size bytes
+ * block_size - block size in bytes (word aligned, at least a pointer)
+ * num_of_blocks - number of blocks in the pool
+ */
+void init_pool(memPoolCB_t* p_pool, void* p_storage, unsigned int block_size, unsigned int num_of_blocks)
+{
+  unsigned char* p_block = p_storage;
+
+  p_pool->block_size = block_size;
+  p_pool->free_blocks = num_of_blocks;
+  p_pool->p_free_list = 0;
+  /* chain the blocks - last block first so allocation starts at p_storage */
+  while (num_of_blocks--)
+  {
+    *(void**)(p_block + num_of_blocks*block_size) = p_pool->p_free_list;
+    p_pool->p_free_list = p_block + num_of_blocks*block_size;
+  }
+}
+
+/*
+ * Allocate a block from a memory pool
+ * p_pool - pool handle
+ * return the block address, 0 if the pool is empty
+ */
+void* __attribute__ ((noinline))
+pool_alloc(memPoolCB_t* p_pool)
+{
+  void* p_block;
+
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_POOL);
+  p_block = p_pool->p_free_list;
+  /* is the pool empty */
+  if (p_block != 0)
+  {
+    /* unlink the head block */
+    p_pool->p_free_list = *(void**)p_block;
+    p_pool->free_blocks--;
+  }
+  M_CRITICAL_EXIT();
+
+  return p_block;
+}
+
+/*
+ * Return a block to a memory pool
+ * p_pool - pool handle
+ * p_block - block to free (allocated from p_pool)
+ */
+void __attribute__ ((noinline))
+pool_free(memPoolCB_t* p_pool, void* p_block)
+{
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_POOL);
+  /* link the block as the new head */
+  *(void**)p_block = p_pool->p_free_list;
+  p_pool->p_free_list = p_block;
+  p_pool->free_blocks++;
+  M_CRITICAL_EXIT();
+}
+
+/*
+ * initialize a task control block and its stack
+ * func - task handler function
+ * p_stack - task stack
+ * stack_size - task stack size in words
+ */
+void init_task(taskCB_t* p_task, task_handler func, unsigned int* p_stack, unsigned int stack_size)
+{
+#ifdef D_STACK_WATERMARK
+  unsigned int i;
+
+  /* paint the stack - the task frame is written over it below */
+  for (i = 0 ; i < stack_size ; i++)
+  {
+    p_stack[i] = D_STACK_PAINT;
+  }
+#endif /* D_STACK_WATERMARK */
+  p_task->p_stack_base = p_stack;
+  p_task->stack_size = stack_size;
+  p_task->func = func;
+  p_task->pStack = initialize_task_stack(func, (unsigned char*)p_stack + 4*stack_size - sizeof(void*));
+  p_task->node.p_owner = p_task;
+#ifdef D_PMP_TASKS
+  p_task->p_pmp = 0;
+#endif /* D_PMP_TASKS */
+}
+
+/*
+ * initialize a task pool - tasks created at run time take their control
+ * block and stack from it
+ * p_tcbs - num_of_tasks control blocks
+ * p_stacks - num_of_tasks stacks of stack_size words each
+ * stack_size - stack size in words
+ * num_of_tasks - max number of tasks alive at the same time
+ */
+void init_task_pool(taskPoolCB_t* p_pool, taskCB_t* p_tcbs, unsigned int* p_stacks, unsigned int stack_size, unsigned int num_of_tasks)
+{
+  init_pool(&p_pool->tcb_pool, p_tcbs, sizeof(taskCB_t), num_of_tasks);
+  init_pool(&p_pool->stack_pool, p_stacks, stack_size*sizeof(unsigned int), num_of_tasks);
+  p_pool->stack_size = stack_size;
+}
+
+/*
+ * Create a task and make it ready
+ * p_pool - task pool to take the control block and stack from
+ * func - task handler function
+ * return the task handle, 0 if the pool is exhausted
+ */
+taskCB_t* __attribute__ ((noinline))
+task_create(taskPoolCB_t* p_pool, task_handler func)
+{
+  taskCB_t* p_task;
+  unsigned int* p_stack;
+
+  M_TRACE_CALL(D_TRACE_ID_TASK_CREATE);
+
+  /* allocate a control block and a stack */
+  p_task = pool_alloc(&p_pool->tcb_pool);
+  if (p_task == 0)
+  {
+    M_TRACE_RETURN(D_TRACE_ID_TASK_CREATE);
+    return 0;
+  }
+  p_stack = pool_alloc(&p_pool->stack_pool);
+  if (p_stack == 0)
+  {
+    pool_free(&p_pool->tcb_pool, p_task);
+    M_TRACE_RETURN(D_TRACE_ID_TASK_CREATE);
+    return 0;
+  }
+
+  /* build the initial frame and add the task to the ready list */
+  init_task(p_task, func, p_stack, p_pool->stack_size);
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_TASK_CREATE);
+  add_ready_task(p_task);
+  M_CRITICAL_EXIT();
+
+  M_TRACE_RETURN(D_TRACE_ID_TASK_CREATE);
+  return p_task;
+}
+
+/*
+ * Delete a task - either the running task (never returns) or a ready one;
+ * tasks pending an object, and ready tasks of the fixed-priority and EDF
+ * modes, are not supported
+ * p_pool - task pool the task was created from
+ * p_task - task handle
+ */
+void __attribute__ ((noinline))
+task_delete(taskPoolCB_t* p_pool, taskCB_t* p_task)
+{
+  taskNode_t *p_node, *p_prev = 0;
+
+  M_TRACE_CALL(D_TRACE_ID_TASK_DELETE);
+
+  /* is the running task deleting itself */
+  if (p_task == g_p_current_task)
+  {
+    M_CRITICAL_ENTER(D_CRITICAL_SITE_TASK_DELETE);
+    /* the stack is used until the switch below - nothing allocates
+       from the pool before then */
+    pool_free(&p_pool->stack_pool, p_task->p_stack_base);
+    pool_free(&p_pool->tcb_pool, p_task);
+    /* no task to save the context of */
+    g_p_current_task = 0;
+    M_SWITCH_COMMIT();
+    M_CRITICAL_EXIT();
+    /* switch to other task */
+    M_CONTEXT_SWITCH();
+  }
+
+  /* find the task in the ready list */
+  M_CRITICAL_ENTER(D_CRITICAL_SITE_TASK_DELETE);
+  for (p_node = ready_tasks_list.pNextTaskNode ; p_node != 0 && p_node != &p_task->node ; p_node = p_node->pNextTaskNode)
+  {
+    p_prev = p_node;
+  }
+  if (p_node != 0)
+  {
+    remove_node_from_list(&ready_tasks_list, p_prev, p_node);
+  }
+  M_CRITICAL_EXIT();
+
+  /* release the stack and the control block */
+  pool_free(&p_pool->stack_pool, p_task->p_stack_base);
+  pool_free(&p_pool->tcb_pool, p_task);
+  M_TRACE_RETURN(D_TRACE_ID_TASK_DELETE);
+}
+
+#ifdef D_STACK_WATERMARK
+/*
+ * Count the stack bytes used since the stack was painted
+ * p_stack - stack lowest address (stacks grow down)
+ * stack_size - stack size in words
+ * return the high-water mark in bytes
+ */
+static unsigned int
+stack_high_water_mark(unsigned int* p_stack, unsigned int stack_size)
+{
+  unsigned int i;
+
+  /* untouched words are at the bottom of the stack */
+  for (i = 0 ; i < stack_size && p_stack[i] == D_STACK_PAINT ; i++);
+
+  return (stack_size - i)*sizeof(unsigned int);
+}
+
+/*
+ * Update a stack usage report with the high-water mark of a task stack
+ * p_task - task handle (initialized by init_task)
+ * p_usage - report to update
+ */
+void update_task_stack_usage(taskCB_t* p_task, stackUsage_t* p_usage)
+{
+  unsigned int used = stack_high_water_mark(p_task->p_stack_base, p_task->stack_size);
+
+  p_usage->stack_size = p_task->stack_size*sizeof(unsigned int);
+  if (used > p_usage->max_used)
+  {
+    p_usage->max_used = used;
+  }
+}
+
+/*
+ * Paint the unused part of the main stack - from the stack limit up to
+ * the current sp of this (leaf) function
+ */
+void __attribute__ ((noinline))
+paint_main_stack(void)
+{
+  unsigned int *p_word, *p_sp;
+
+  M_READ_STACK_POINTER(p_sp);
+  for (p_word = _heap_end ; p_word < p_sp ; p_word++)
+  {
+    *p_word = D_STACK_PAINT;
+  }
+}
+
+/*
+ * Update a stack usage report with the high-water mark of the main stack
+ * p_usage - report to update
+ */
+void update_main_stack_usage(stackUsage_t* p_usage)
+{
+  unsigned int used = stack_high_water_mark(_heap_end, _sp - _heap_end);
+
+  p_usage->stack_size = (_sp - _heap_end)*sizeof(unsigned int);
+  if (used > p_usage->max_used)
+  {
+    p_usage->max_used = used;
+  }
+}
+#endif /* D_STACK_WATERMARK */
+
+/*
+ * initialize the scheduler - empty lists, no running task
+ */
+void init_scheduler(void)
+{
+  /* clear the ready list (from previous run) */
+  while (ready_tasks_list.node_count)
+  {
+    remove_head_from_list(&ready_tasks_list);
+  }
+#ifdef D_SCHED_EDF
+  /* FIFO unless the benchmark selects another mode */
+  g_sched_policy = D_SCHED_POLICY_FIFO;
+#endif /* D_SCHED_EDF */
+  /* initialize the idle task stack */
+  init_task(&g_idle_task, idle_task_func, idle_stack, D_IDLE_STACK_SIZE);
+  /* no task is running */
+  g_p_current_task = 0;
 }
 
 static int __attribute__ ((noinline))
@@ -550,33 +1161,95 @@ benchmark_body (int rpt)
   unsigned char i, j;
   unsigned int* stack_array[D_NUM_OF_TASKS] = { task0_stack, task1_stack };
 
+#ifdef D_STACK_WATERMARK
+  paint_main_stack();
+#endif /* D_STACK_WATERMARK */
+
+#ifdef D_TRACE
+  /* measure the cost of an event, start with an empty trace */
+  trace_init();
+  trace_measure_overhead();
+#endif /* D_TRACE */
+#ifdef D_CRITICAL_STATS
+  critical_init();
+#endif /* D_CRITICAL_STATS */
+
+  /* optional benchmarks run first - they go through the instrumented
+     primitives and would overwrite the results measured below */
+#ifdef D_MSG_PASSING_BENCH
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_MSG);
+  msg_passing_benchmark();
+#endif /* D_MSG_PASSING_BENCH */
+#ifdef D_EVENT_BROADCAST_BENCH
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_EVENT);
+  event_broadcast_benchmark();
+#endif /* D_EVENT_BROADCAST_BENCH */
+#ifdef D_TASK_LIFECYCLE_BENCH
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_TASK);
+  task_lifecycle_benchmark();
+#endif /* D_TASK_LIFECYCLE_BENCH */
+#ifdef D_SYSCALL_BENCH
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_SYSCALL);
+  syscall_benchmark();
+#endif /* D_SYSCALL_BENCH */
+#ifdef D_PMP_TASKS
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_PMP);
+  pmp_benchmark();
+#endif /* D_PMP_TASKS */
+#ifdef D_CORO_BENCH
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_CORO);
+  coro_benchmark();
+#endif /* D_CORO_BENCH */
+#ifdef D_WSET_BENCH
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_WSET);
+  wset_benchmark();
+#endif /* D_WSET_BENCH */
+#ifdef D_SMP
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_SMP);
+  smp_benchmark();
+#endif /* D_SMP */
+#ifdef D_ISR_DEFER
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_ISR);
+  isr_defer_benchmark();
+#endif /* D_ISR_DEFER */
+#ifdef D_SCHED_EDF
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_EDF);
+  edf_benchmark();
+#endif /* D_SCHED_EDF */
+
+  M_CRITICAL_BENCHMARK(D_CRITICAL_BENCH_MAIN);
   for (j = 0 ; j < rpt ; j++)
   {
-    /* clear the ready list (from previous run) */
-    while (ready_tasks_list.node_count)
-    {
-      remove_head_from_list(&ready_tasks_list);
-    }
+    init_scheduler();
     /* initialize the task and stack of each task */
     for (i = 0 ; i < D_NUM_OF_TASKS ; i++)
     {
-      g_tasks_list[i].pStack = initialize_task_stack(g_tasks_list[i].func, (unsigned char*)stack_array[i] + 4*(D_STACK_SIZE - 1));
-      g_tasks_list[i].node.p_owner = &g_tasks_list[i];
+      init_task(&g_tasks_list[i], g_tasks_list[i].func, stack_array[i], D_STACK_SIZE);
       add_task_to_list(&ready_tasks_list, &g_tasks_list[i]);
     }
 
-    /* task 0 is ready for execution */
-    //add_task_to_list(&ready_tasks_list, &g_tasks_list[0]);
-    /* task 1 is pending */
-    //add_task_to_list(&pending_tasks_list, &g_tasks_list[1]);
-    g_p_current_task = 0;
-
     init_semaphore(&g_sem);
     init_event(&g_event);
     init_queue(&g_queue);
     invoke_first_task();
+
+#ifdef D_STACK_WATERMARK
+    for (i = 0 ; i < D_NUM_OF_TASKS ; i++)
+    {
+      update_task_stack_usage(&g_tasks_list[i], &g_stack_usage_tasks[i]);
+    }
+    update_task_stack_usage(&g_idle_task, &g_stack_usage_idle);
+#endif /* D_STACK_WATERMARK */
   }
 
+#ifdef D_STACK_WATERMARK
+  update_main_stack_usage(&g_stack_usage_main);
+#endif /* D_STACK_WATERMARK */
+
+#ifdef D_TRACE
+  trace_update_overhead();
+#endif /* D_TRACE */
+
   return 0;
 }
 
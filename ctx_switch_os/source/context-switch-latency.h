@@ -3,10 +3,273 @@
 
 typedef unsigned int cycles_t;
 
+/* stack size in 32 bit words - twice as many on rv64 for 64 bit frames */
+#if __riscv_xlen == 64
+#define D_STACK_SIZE     128
+#else
+#define D_STACK_SIZE     64
+#endif /* __riscv_xlen */
+#define D_AND            1
+#define D_OR             2
+#define D_CLEAR_BITS     4
+#define D_WAIT_FOREVER   0
+#define D_MAX_QUEUE_SIZE 5
+/* unused stack words pattern - high-water mark detection */
+#define D_STACK_PAINT    0xA5A5A5A5
+
+/* core clock - used to convert cycles to rates */
+#ifndef D_CORE_CLOCK_HZ
+#define D_CORE_CLOCK_HZ  50000000
+#endif /* D_CORE_CLOCK_HZ */
+
+/* task handler function definition */
+typedef void (*task_handler)(void);
+
+#ifdef D_PMP_TASKS
+/* max pmp entries of a task */
+#define D_PMP_MAX_ENTRIES  16
+/* pmp region permissions */
+#define D_PMP_R            0x01
+#define D_PMP_W            0x02
+#define D_PMP_X            0x04
+/* entries per pmpcfg register - 4 on rv32, 8 on rv64 */
+#if __riscv_xlen == 64
+#define D_PMP_ENTRIES_PER_CFG  8
+#else
+#define D_PMP_ENTRIES_PER_CFG  4
+#endif /* __riscv_xlen */
+/* pmp rewrite strategies */
+#define D_PMP_FULL_REWRITE 0
+#define D_PMP_DIFF_REWRITE 1
+
+/* pmp regions of an isolated task - programmed when the task is switched in */
+typedef struct pmpRegionSet
+{
+  /* pmp entries in use, from entry 0 */
+  unsigned int  num_of_entries;
+  /* pmpaddr values */
+  unsigned long addr[D_PMP_MAX_ENTRIES];
+  /* pmpcfg values - D_PMP_ENTRIES_PER_CFG entries per register; unused
+     entries are off */
+  unsigned long cfg[D_PMP_MAX_ENTRIES/D_PMP_ENTRIES_PER_CFG];
+}pmpRegionSet_t;
+#endif /* D_PMP_TASKS */
+
+/* task list node */
+typedef struct taskNode_t
+{
+  /* owner of this node */
+  void *p_owner;
+  /* next task node */
+  struct taskNode_t *pNextTaskNode;
+}taskNode_t;
+
+/* task list */
+typedef struct taskList
+{
+  /* link to the first task node */
+  taskNode_t *pNextTaskNode;
+  /* link to the last task node */
+  taskNode_t *pLastTaskNode;
+  /* task pointed by this node */
+  unsigned int node_count;
+}taskList_t;
+
+/* task control block */
+typedef struct taskCB
+{
+  /* task stack address */
+  void         *pStack;
+  /* task handler function */
+  task_handler  func;
+  /* task node */
+  taskNode_t node;
+  /* event bits waited for - the received bits once released */
+  unsigned int  event_bits;
+  /* event wait condition - D_AND/D_OR and D_CLEAR_BITS */
+  unsigned int  event_condition;
+  /* stack lowest address */
+  unsigned int *p_stack_base;
+  /* stack size in words */
+  unsigned int  stack_size;
+#ifdef D_PMP_TASKS
+  /* pmp regions - 0 if the task isn't isolated */
+  pmpRegionSet_t *p_pmp;
+#endif /* D_PMP_TASKS */
+#ifdef D_SCHED_EDF
+  /* absolute deadline of the current job - key of the EDF mode */
+  unsigned int  deadline;
+  /* priority, 0 is the highest - key of the fixed-priority mode */
+  unsigned int  priority;
+#endif /* D_SCHED_EDF */
+}taskCB_t;
+
+/* semaphore control block */
+typedef struct semaphoreCB
+{
+  /* semaphore counter */
+  unsigned int  counter;
+  /* semaphore max count */
+  unsigned int  max_count;
+  /* pending tasks list */
+  taskList_t    pending_tasks;
+}semaphoreCB_t;
+
+/* event control block */
+typedef struct eventCB
+{
+  /* event bits */
+  unsigned int  expected_bits;
+  /* wait condition */
+  unsigned int  expected_bits_state;
+  /* pending tasks list */
+  taskList_t    pending_tasks;
+}eventCB_t;
+
+/* queue control block */
+typedef struct queueCB
+{
+  /* queue */
+  unsigned int queue[D_MAX_QUEUE_SIZE];
+  /* queue push index */
+  unsigned int  push_index;
+  /* queue pop index */
+  unsigned int  pop_index;
+  /* queue number of items in the queue */
+  unsigned int  num_of_items;
+  /* pending tasks list */
+  taskList_t    pending_tasks;
+}queueCB_t;
+
+/* message queue control block - items of any size, copied in and out */
+typedef struct msgQueueCB
+{
+  /* queue storage - max_items items of item_size bytes */
+  void         *p_storage;
+  /* item size in bytes */
+  unsigned int  item_size;
+  /* max number of items in the queue */
+  unsigned int  max_items;
+  /* queue push index */
+  unsigned int  push_index;
+  /* queue pop index */
+  unsigned int  pop_index;
+  /* queue number of items in the queue */
+  unsigned int  num_of_items;
+  /* pending tasks list */
+  taskList_t    pending_tasks;
+}msgQueueCB_t;
+
+/* fixed-size blocks memory pool control block */
+typedef struct memPoolCB
+{
+  /* first free block - each free block holds the address of the next one */
+  void         *p_free_list;
+  /* block size in bytes */
+  unsigned int  block_size;
+  /* number of free blocks */
+  unsigned int  free_blocks;
+}memPoolCB_t;
+
+/* task pool control block - control blocks and stacks of created tasks */
+typedef struct taskPoolCB
+{
+  /* taskCB_t blocks */
+  memPoolCB_t   tcb_pool;
+  /* stack blocks */
+  memPoolCB_t   stack_pool;
+  /* stack size in words */
+  unsigned int  stack_size;
+}taskPoolCB_t;
+
+#ifdef D_STACK_WATERMARK
+/* stack usage report */
+typedef struct stackUsage
+{
+  /* stack size in bytes */
+  unsigned int  stack_size;
+  /* max stack bytes ever used (high-water mark) */
+  unsigned int  max_used;
+}stackUsage_t;
+#endif /* D_STACK_WATERMARK */
+
+/* kernel global variables */
+extern taskCB_t   *g_p_current_task;
+extern taskList_t  ready_tasks_list;
+#ifdef D_SCHED_EDF
+/* scheduling modes - the ready list is FIFO unless a benchmark selects
+   one of the others */
+#define D_SCHED_POLICY_FIFO 0
+#define D_SCHED_POLICY_FP   1
+#define D_SCHED_POLICY_EDF  2
+extern unsigned int g_sched_policy;
+#endif /* D_SCHED_EDF */
+#ifdef D_STACK_WATERMARK
+extern stackUsage_t g_stack_usage_main;
+#endif /* D_STACK_WATERMARK */
+
 /* functions implemented int context-switch-latency-rv.S */
 void return_to_main(void);
 void context_switch(void);
 void invoke_first_task(void);
 void* initialize_task_stack(void* p_func_handler, void* p_stack_address);
 
+/* functions implemented in context-switch-latency.c */
+void add_task_to_list(taskList_t* pList, taskCB_t* p_task);
+taskNode_t* remove_head_from_list(taskList_t* pList);
+void remove_node_from_list(taskList_t* pList, taskNode_t* p_prev, taskNode_t* p_node);
+void init_scheduler(void);
+void init_task(taskCB_t* p_task, task_handler func, unsigned int* p_stack, unsigned int stack_size);
+void init_semaphore(semaphoreCB_t* p_sem);
+void init_event(eventCB_t* p_event);
+void init_queue(queueCB_t* p_queue);
+void init_msg_queue(msgQueueCB_t* p_queue, void* p_storage, unsigned int item_size, unsigned int max_items);
+void init_pool(memPoolCB_t* p_pool, void* p_storage, unsigned int block_size, unsigned int num_of_blocks);
+unsigned int event_get(eventCB_t *p_event, unsigned int get_bits, unsigned int bits_condition, unsigned int wait_time);
+void event_set(eventCB_t *p_event, unsigned int set_bits);
+unsigned int semaphore_take(semaphoreCB_t* p_sem, unsigned int wait_time);
+unsigned int semaphore_give(semaphoreCB_t* p_sem);
+int queue_receive(queueCB_t* p_queue, unsigned int *p_item, unsigned int wait_time);
+int queue_send(queueCB_t* p_queue, unsigned int *p_item);
+int msg_queue_receive(msgQueueCB_t* p_queue, void *p_item, unsigned int wait_time);
+unsigned int msg_queue_send_batch(msgQueueCB_t* p_queue, void *p_items, unsigned int num_of_items);
+void task_yield(void);
+void* pool_alloc(memPoolCB_t* p_pool);
+void pool_free(memPoolCB_t* p_pool, void* p_block);
+void init_task_pool(taskPoolCB_t* p_pool, taskCB_t* p_tcbs, unsigned int* p_stacks, unsigned int stack_size, unsigned int num_of_tasks);
+taskCB_t* task_create(taskPoolCB_t* p_pool, task_handler func);
+void task_delete(taskPoolCB_t* p_pool, taskCB_t* p_task);
+#ifdef D_STACK_WATERMARK
+void update_task_stack_usage(taskCB_t* p_task, stackUsage_t* p_usage);
+void paint_main_stack(void);
+void update_main_stack_usage(stackUsage_t* p_usage);
+#endif /* D_STACK_WATERMARK */
+#ifdef D_PMP_TASKS
+/* functions implemented in context-switch-latency-pmp.c */
+void pmp_init_set(pmpRegionSet_t* p_set);
+unsigned int pmp_add_napot(pmpRegionSet_t* p_set, void* p_base, unsigned int size, unsigned int perm);
+unsigned int pmp_add_tor(pmpRegionSet_t* p_set, void* p_base, void* p_top, unsigned int perm);
+void pmp_switch(pmpRegionSet_t* p_set);
+void pmp_reset(void);
+void pmp_benchmark(void);
+#endif /* D_PMP_TASKS */
+#ifdef D_SCHED_EDF
+/* functions implemented in context-switch-latency-edf.c */
+void sched_init(unsigned int policy);
+void sched_add_ready(taskCB_t* p_task);
+taskCB_t* sched_take_ready(void);
+unsigned int sched_num_of_ready(void);
+#endif /* D_SCHED_EDF */
+
+/* optional benchmarks */
+void msg_passing_benchmark(void);
+void event_broadcast_benchmark(void);
+void task_lifecycle_benchmark(void);
+void syscall_benchmark(void);
+void coro_benchmark(void);
+void wset_benchmark(void);
+void smp_benchmark(void);
+void isr_defer_benchmark(void);
+void edf_benchmark(void);
+
 #endif /* __CONTEXT_SWITCH_LATENCY_H__ */
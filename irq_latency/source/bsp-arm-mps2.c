@@ -0,0 +1,304 @@
+#include "int-latency.h"
+
+/*
+ * QEMU mps2 boards (an385 Cortex-M3, an505 Cortex-M33) - the external
+ * interrupt lines are NVIC lines firmware sets pending; the board gives
+ * D_ARM_NUM_OF_EXT_IRQS of them from D_ARM_EXT_IRQ_BASE (in one 32 bit
+ * pending register), and the CMSDK timer at D_ARM_TIMER_BASE (line
+ * D_ARM_TIMER_IRQ) as the wake-up and periodic interrupt
+ */
+
+/* NVIC */
+#define D_NVIC_ISER_ADDR       0xE000E100
+#define D_NVIC_ICER_ADDR       0xE000E180
+#define D_NVIC_ISPR_ADDR       0xE000E200
+#define D_NVIC_ICPR_ADDR       0xE000E280
+#define D_NVIC_IABR_ADDR       0xE000E300
+#define D_NVIC_IPR_ADDR        0xE000E400
+#define D_SCB_VTOR_ADDR        0xE000ED08
+/* priority of the single external and wake-up lines - mid range */
+#define D_NVIC_DEFAULT_PRIORITY 0x80
+/* register and bit of an NVIC line */
+#define M_NVIC_REG(base, irq)  ((base) + 4*((irq)/32))
+#define M_NVIC_BIT(irq)        (1u << ((irq)%32))
+/* CMSDK timer - counts VALUE down to 0 at the core clock, then reloads */
+#define D_TIMER_CTRL_ADDR      (D_ARM_TIMER_BASE + 0x0)
+#define D_TIMER_VALUE_ADDR     (D_ARM_TIMER_BASE + 0x4)
+#define D_TIMER_RELOAD_ADDR    (D_ARM_TIMER_BASE + 0x8)
+#define D_TIMER_INTCLEAR_ADDR  (D_ARM_TIMER_BASE + 0xC)
+#define D_TIMER_CTRL_ENABLE    0x1
+#define D_TIMER_CTRL_IRQ_EN    0x8
+#define M_READ_REGISTER_32(reg)          (*(volatile unsigned int *)(void*)(reg))
+#define M_WRITE_REGISTER_32(reg, value)  ((*(volatile unsigned int *)(void*)(reg)) = (value))
+#define M_WRITE_REGISTER_08(reg, value)  ((*(volatile unsigned char *)(void*)(reg)) = (value))
+#define M_READ_REGISTER_08(reg)          (*(volatile unsigned char *)(void*)(reg))
+
+/* the set pending write has reached the NVIC and the interrupt is taken
+   before the next instruction */
+#define M_BARRIER() asm volatile("dsb\n isb" : : : "memory")
+
+/* source lines of the dispatch benchmark - enabled and already claimed */
+static unsigned int g_enabled_sources, g_claimed_sources;
+
+/*
+*   enable external interrupts
+*/
+void bsp_enble_external_interrupt(void)
+{
+  M_WRITE_REGISTER_08(D_NVIC_IPR_ADDR + D_ARM_EXT_IRQ_BASE, D_NVIC_DEFAULT_PRIORITY);
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ICPR_ADDR, D_ARM_EXT_IRQ_BASE), M_NVIC_BIT(D_ARM_EXT_IRQ_BASE));
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ISER_ADDR, D_ARM_EXT_IRQ_BASE), M_NVIC_BIT(D_ARM_EXT_IRQ_BASE));
+}
+
+/*
+*   Trigger the external interrupt
+*/
+void bsp_trigger_external_interrupt(void)
+{
+  /* set the line pending */
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ISPR_ADDR, D_ARM_EXT_IRQ_BASE), M_NVIC_BIT(D_ARM_EXT_IRQ_BASE));
+  M_BARRIER();
+}
+
+volatile cycles_t cycles;
+
+/*
+*   This function is responsible for sampling cpu cycles for 'triggering
+*   an external interrupt' operation; it will trigger the interrupt
+*   and sample the current value of the cpu cycles. The measure start
+*   point is prior to calling this function so that we'll get the cost
+*   in cycles of 'triggering external interrupt' operation
+*
+*   p_cycles - value of sampled cpu cycles
+*/
+void bsp_trigger_external_interrupt_sample_cycles(volatile cycles_t* p_cycles)
+{
+  /* triggers the external interrupt */
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ISPR_ADDR, D_ARM_EXT_IRQ_BASE), M_NVIC_BIT(D_ARM_EXT_IRQ_BASE));
+  /* read the value of the cycle counter */
+  M_READ_CYCLE_COUNTER_END(cycles);
+  M_BARRIER();
+
+  *p_cycles = cycles;
+}
+
+/*
+*   Clear the external interrupt indication
+*/
+void bsp_clear_external_interrupt_indication(void)
+{
+  /* clear the pending state - the core cleared it on entry, this drops a
+     trigger made with interrupts masked */
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ICPR_ADDR, D_ARM_EXT_IRQ_BASE), M_NVIC_BIT(D_ARM_EXT_IRQ_BASE));
+}
+
+/*
+*   Number of external interrupt sources that can be triggered together
+*/
+unsigned int bsp_get_num_of_external_interrupt_sources(void)
+{
+  return D_ARM_NUM_OF_EXT_IRQS;
+}
+
+/*
+*   Enable an external interrupt source at a given priority
+*
+*   index    - source index, 0 .. bsp_get_num_of_external_interrupt_sources() - 1
+*   priority - 1 (lowest) .. 7
+*   return the source id reported by bsp_claim_external_interrupt
+*/
+unsigned int bsp_enable_external_interrupt_source(unsigned int index, unsigned int priority)
+{
+  unsigned int irq = D_ARM_EXT_IRQ_BASE + index;
+
+  /* NVIC - a lower value is a higher priority; the top 3 bits are
+     implemented on every core */
+  M_WRITE_REGISTER_08(D_NVIC_IPR_ADDR + irq, (8 - priority) << 5);
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ICPR_ADDR, irq), M_NVIC_BIT(irq));
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ISER_ADDR, irq), M_NVIC_BIT(irq));
+  g_enabled_sources |= (1u << index);
+
+  /* source ids start at 1 - 0 is 'none pending' */
+  return index + 1;
+}
+
+/*
+*   Trigger several external interrupt sources at once; returns once
+*   the interrupt controller signals a pending interrupt
+*
+*   index_mask - bit n set triggers source index n
+*/
+void bsp_trigger_external_interrupt_sources(unsigned int index_mask)
+{
+  /* a new burst - nothing claimed yet */
+  g_claimed_sources = 0;
+  /* the lines of the board share one pending register - set them with
+     a single write; pending is visible once the write completes */
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ISPR_ADDR, D_ARM_EXT_IRQ_BASE),
+                      (index_mask & g_enabled_sources) << (D_ARM_EXT_IRQ_BASE%32));
+  M_BARRIER();
+}
+
+/*
+*   Claim the highest priority pending external interrupt - the NVIC has
+*   no claim register; the line being serviced is active, the rest are
+*   pending, and the highest priority of those not claimed yet is taken.
+*   Its pending state is cleared so it is not taken again once the
+*   dispatch returns
+*
+*   return the claimed source id, 0 if no source is pending
+*/
+unsigned int bsp_claim_external_interrupt(void)
+{
+  unsigned int lines, index, irq, best = 0, best_priority = 0x100, priority;
+
+  lines = M_READ_REGISTER_32(M_NVIC_REG(D_NVIC_ISPR_ADDR, D_ARM_EXT_IRQ_BASE)) |
+          M_READ_REGISTER_32(M_NVIC_REG(D_NVIC_IABR_ADDR, D_ARM_EXT_IRQ_BASE));
+  lines = (lines >> (D_ARM_EXT_IRQ_BASE%32)) & g_enabled_sources & ~g_claimed_sources;
+
+  for (index = 0 ; index < D_ARM_NUM_OF_EXT_IRQS ; index++)
+  {
+    if (lines & (1u << index))
+    {
+      /* ties go to the lower line, as the NVIC does */
+      priority = M_READ_REGISTER_08(D_NVIC_IPR_ADDR + D_ARM_EXT_IRQ_BASE + index);
+      if (priority < best_priority)
+      {
+        best_priority = priority;
+        best = index + 1;
+      }
+    }
+  }
+
+  if (best != 0)
+  {
+    irq = D_ARM_EXT_IRQ_BASE + best - 1;
+    g_claimed_sources |= (1u << (best - 1));
+    M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ICPR_ADDR, irq), M_NVIC_BIT(irq));
+  }
+
+  return best;
+}
+
+/*
+*   Complete a claimed external interrupt - the line was pended by
+*   firmware, there is no source to deassert
+*
+*   source_id - id returned by bsp_claim_external_interrupt
+*/
+void bsp_complete_external_interrupt(unsigned int source_id)
+{
+  unsigned int irq = D_ARM_EXT_IRQ_BASE + source_id - 1;
+
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ICPR_ADDR, irq), M_NVIC_BIT(irq));
+}
+
+/*
+*   Clear the wake-up interrupt indication
+*/
+void bsp_clear_wakeup_interrupt_indication(void)
+{
+  /* stop the timer so it won't fire again */
+  M_WRITE_REGISTER_32(D_TIMER_CTRL_ADDR, 0);
+  M_WRITE_REGISTER_32(D_TIMER_INTCLEAR_ADDR, 1);
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ICPR_ADDR, D_ARM_TIMER_IRQ), M_NVIC_BIT(D_ARM_TIMER_IRQ));
+}
+
+/*
+*   enable the wake-up interrupt (timer)
+*/
+void bsp_enable_wakeup_interrupt(void)
+{
+  /* make sure the timer isn't pending before it is armed */
+  bsp_clear_wakeup_interrupt_indication();
+  M_WRITE_REGISTER_08(D_NVIC_IPR_ADDR + D_ARM_TIMER_IRQ, D_NVIC_DEFAULT_PRIORITY);
+  M_WRITE_REGISTER_32(M_NVIC_REG(D_NVIC_ISER_ADDR, D_ARM_TIMER_IRQ), M_NVIC_BIT(D_ARM_TIMER_IRQ));
+}
+
+/*
+*   Arm the wake-up interrupt so it asserts 'delay' cpu cycles from now
+*
+*   delay    - number of cpu cycles from now until the interrupt asserts
+*   p_cycles - value of cpu cycles at which the interrupt asserts
+*/
+void bsp_trigger_wakeup_interrupt_delayed(unsigned int delay, volatile cycles_t* p_cycles)
+{
+  M_WRITE_REGISTER_32(D_TIMER_CTRL_ADDR, 0);
+  M_WRITE_REGISTER_32(D_TIMER_RELOAD_ADDR, delay);
+  M_WRITE_REGISTER_32(D_TIMER_VALUE_ADDR, delay);
+  /* sample the cycles and start the timer back to back */
+  M_READ_CYCLE_COUNTER_END(cycles);
+  M_WRITE_REGISTER_32(D_TIMER_CTRL_ADDR, D_TIMER_CTRL_ENABLE | D_TIMER_CTRL_IRQ_EN);
+
+  /* cpu cycle at which the timer reaches 0 and asserts the interrupt */
+  *p_cycles = cycles + delay;
+}
+
+/*
+*   Start a periodic interrupt on the wake-up interrupt (timer);
+*   bsp_enable_wakeup_interrupt must be called first
+*
+*   period - number of cpu cycles between interrupts
+*/
+void bsp_start_periodic_interrupt(unsigned int period)
+{
+  /* the timer reloads by itself - period - 1 down to 0 and back */
+  M_WRITE_REGISTER_32(D_TIMER_CTRL_ADDR, 0);
+  M_WRITE_REGISTER_32(D_TIMER_RELOAD_ADDR, period - 1);
+  M_WRITE_REGISTER_32(D_TIMER_VALUE_ADDR, period - 1);
+  M_WRITE_REGISTER_32(D_TIMER_INTCLEAR_ADDR, 1);
+  M_WRITE_REGISTER_32(D_TIMER_CTRL_ADDR, D_TIMER_CTRL_ENABLE | D_TIMER_CTRL_IRQ_EN);
+}
+
+/*
+*   Arm the next period - called from the interrupt handler; the reload
+*   keeps the period, only the timer interrupt is cleared
+*/
+void bsp_rearm_periodic_interrupt(void)
+{
+  M_WRITE_REGISTER_32(D_TIMER_INTCLEAR_ADDR, 1);
+  /* the write reaches the timer before the exception returns */
+  M_BARRIER();
+}
+
+/*
+*   Register a trap handler or vector table
+*
+*   p_ints_handler - address of trap handler or vector table
+*   is_vector      - 0, p_ints_handler is a trap handler
+*                    1, p_ints_handler is vector table
+*                    The NVIC always vectors - every handler of
+*                    psp-int-arm.S is a vector table, is_vector is unused
+*/
+void bsp_set_interrupts_handler(void *p_ints_handler, unsigned int is_vector)
+{
+  (void)is_vector;
+
+  M_WRITE_REGISTER_32(D_SCB_VTOR_ADDR, (unsigned int)p_ints_handler);
+  M_BARRIER();
+}
+
+/*
+*   global enable interrupts
+*/
+void bsp_enable_interrupts(void)
+{
+  /* clear PRIMASK */
+  asm volatile ("cpsie i" : : : "memory");
+}
+
+/*
+*   global disable interrupts
+*/
+void bsp_disable_interrupts(void)
+{
+  /* set PRIMASK */
+  asm volatile ("cpsid i" : : : "memory");
+}
+
+/*
+*   bsp specific initialization
+*/
+void bsp_init(void)
+{
+}
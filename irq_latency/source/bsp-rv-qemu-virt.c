@@ -0,0 +1,324 @@
+#include "int-latency.h"
+
+/* QEMU virt has no external interrupt line firmware can raise - the PLIC
+   pending bits are read only - so the CLINT software interrupt (msip of
+   hart 0, mcause 3) is the external interrupt, see D_PSP_EXT_INT_CAUSE */
+#define D_CLINT_MSIP_ADDR      0x02000000
+#define D_CLINT_MTIMECMP_ADDR  0x02004000
+#define D_CLINT_MTIME_ADDR     0x0200BFF8
+/* mtime runs at 10MHz; with -icount shift=0 the core runs an instruction,
+   counted as a cycle, every ns */
+#define D_CYCLES_PER_MTIME_TICK 100
+/* msip is the only source - its claim id */
+#define D_MSIP_SOURCE_ID       1
+#define M_READ_REGISTER_32(reg)          (*(volatile unsigned int *)(void*)(reg))
+#define M_WRITE_REGISTER_32(reg, value)  ((*(volatile unsigned int *)(void*)(reg)) = (value))
+#define D_MSTATUS_MIE_MASK     0x00000008
+#define D_MIE_MSIE_MASK        0x00000008
+#define D_MIE_MTIE_MASK        0x00000080
+#define D_MIP_MSIP_MASK        0x00000008
+
+#define _WRITE_CSR_(reg, val) ({ \
+  if (__builtin_constant_p(val) && (unsigned long)(val) < 32) \
+    asm volatile ("csrw " #reg ", %0" :: "i"(val)); \
+  else \
+    asm volatile ("csrw " #reg ", %0" :: "r"(val)); })
+#define _WRITE_CSR_INTERMEDIATE_(reg, val) _WRITE_CSR_(reg, val)
+#define M_WRITE_CSR(csr, val)   _WRITE_CSR_INTERMEDIATE_(csr, val)
+
+#define _READ_CSR_(reg, var) asm volatile ("csrr %0, " #reg : "=r"(var))
+#define _READ_CSR_INTERMEDIATE_(reg, var) _READ_CSR_(reg, var)
+#define M_READ_CSR(csr, var)    _READ_CSR_INTERMEDIATE_(csr, var)
+
+#define M_CLEAR_CSR_BITS(reg, bits) ({\
+  if (__builtin_constant_p(bits) && (unsigned long)(bits) < 32) \
+    asm volatile ("csrc " #reg ", %0" :: "i"(bits)); \
+  else \
+    asm volatile ("csrc " #reg ", %0" :: "r"(bits)); })
+
+#define M_SET_CSR_BITS(reg, bits) ({\
+    if (__builtin_constant_p(bits) && (unsigned long)(bits) < 32) \
+      asm volatile ("csrs " #reg ", %0" :: "i"(bits)); \
+    else \
+      asm volatile ("csrs " #reg ", %0" :: "r"(bits)); })
+
+/* fence instruction */
+#define M_FENCE() asm volatile("fence")
+
+/*
+*   Read mtime - retry if the high word changed between the reads
+*/
+static unsigned long long bsp_read_mtime(void)
+{
+  unsigned int mtime_low, mtime_high;
+
+  do
+  {
+    mtime_high = M_READ_REGISTER_32(D_CLINT_MTIME_ADDR + 4);
+    mtime_low = M_READ_REGISTER_32(D_CLINT_MTIME_ADDR);
+  } while (mtime_high != M_READ_REGISTER_32(D_CLINT_MTIME_ADDR + 4));
+
+  return ((unsigned long long)mtime_high << 32) | mtime_low;
+}
+
+/*
+*   Write mtimecmp without passing through a value smaller than the target
+*/
+static void bsp_write_mtimecmp(unsigned long long cmp)
+{
+  M_WRITE_REGISTER_32(D_CLINT_MTIMECMP_ADDR + 4, 0xFFFFFFFF);
+  M_WRITE_REGISTER_32(D_CLINT_MTIMECMP_ADDR, (unsigned int)cmp);
+  M_WRITE_REGISTER_32(D_CLINT_MTIMECMP_ADDR + 4, (unsigned int)(cmp >> 32));
+}
+
+/*
+*   enable external interrupts
+*/
+void bsp_enble_external_interrupt(void)
+{
+  /* make sure msip isn't pending before it is enabled */
+  M_WRITE_REGISTER_32(D_CLINT_MSIP_ADDR, 0);
+  /* enable software interrupts in mie csr */
+  M_SET_CSR_BITS(mie, D_MIE_MSIE_MASK);
+}
+
+/*
+*   Trigger the external interrupt
+*/
+void bsp_trigger_external_interrupt(void)
+{
+  /* trigger the external interrupt */
+  M_WRITE_REGISTER_32(D_CLINT_MSIP_ADDR, 1);
+  M_FENCE();
+}
+
+/*
+*   This function is responsible for ampling cpu cycles for 'triggering
+*   an external interrupt' operation; it will trigger the interrupt
+*   and sample the current value of the cpu cycles. The measure start
+*   point is prior to calling this function so that we'll get the cost
+*   in cycles of 'triggering external interrupt' operation
+*
+*   p_cycles - value of sampled cpu cycles
+*/
+void bsp_trigger_external_interrupt_sample_cycles(volatile cycles_t* p_cycles)
+{
+  cycles_t now;
+
+  /* triggers the external interrupt */
+  M_WRITE_REGISTER_32(D_CLINT_MSIP_ADDR, 1);
+  /* read the value of mcycles register - QEMU raises msip on the store,
+     there is no pipeline delay to add */
+  M_READ_CYCLE_COUNTER_REG(now);
+  M_FENCE();
+
+  *p_cycles = now;
+}
+
+/*
+*   Clear the external interrupt indication
+*/
+void bsp_clear_external_interrupt_indication(void)
+{
+  /* clear the external interrupt indication */
+  M_WRITE_REGISTER_32(D_CLINT_MSIP_ADDR, 0);
+}
+
+/*
+*   Number of external interrupt sources that can be triggered together
+*/
+unsigned int bsp_get_num_of_external_interrupt_sources(void)
+{
+  /* msip only - larger bursts are reported empty */
+  return 1;
+}
+
+/*
+*   Enable an external interrupt source at a given priority
+*
+*   index    - source index, 0 .. bsp_get_num_of_external_interrupt_sources() - 1
+*   priority - 1 (lowest) .. 7, msip has no priority
+*   return the source id reported by bsp_claim_external_interrupt
+*/
+unsigned int bsp_enable_external_interrupt_source(unsigned int index, unsigned int priority)
+{
+  bsp_enble_external_interrupt();
+
+  return D_MSIP_SOURCE_ID;
+}
+
+/*
+*   Trigger several external interrupt sources at once; returns once
+*   the interrupt is pending
+*
+*   index_mask - bit n set triggers source index n
+*/
+void bsp_trigger_external_interrupt_sources(unsigned int index_mask)
+{
+  unsigned long mip;
+
+  if (index_mask & 1)
+  {
+    bsp_trigger_external_interrupt();
+    /* wait for mip to reflect it */
+    do
+    {
+      M_READ_CSR(mip, mip);
+    } while ((mip & D_MIP_MSIP_MASK) == 0);
+  }
+}
+
+/*
+*   Claim the pending external interrupt
+*
+*   return the claimed source id, 0 if no source is pending
+*/
+unsigned int bsp_claim_external_interrupt(void)
+{
+  unsigned long mip;
+
+  M_READ_CSR(mip, mip);
+
+  return (mip & D_MIP_MSIP_MASK) ? D_MSIP_SOURCE_ID : 0;
+}
+
+/*
+*   Complete a claimed external interrupt - clear msip so mip stops
+*   reporting it
+*
+*   source_id - id returned by bsp_claim_external_interrupt
+*/
+void bsp_complete_external_interrupt(unsigned int source_id)
+{
+  bsp_clear_external_interrupt_indication();
+  /* read back - msip is low before the next claim */
+  (void)M_READ_REGISTER_32(D_CLINT_MSIP_ADDR);
+}
+
+/*
+*   Clear the wake-up interrupt indication
+*/
+void bsp_clear_wakeup_interrupt_indication(void)
+{
+  /* push mtimecmp to its max value so the timer won't fire again */
+  M_WRITE_REGISTER_32(D_CLINT_MTIMECMP_ADDR + 4, 0xFFFFFFFF);
+  M_WRITE_REGISTER_32(D_CLINT_MTIMECMP_ADDR, 0xFFFFFFFF);
+}
+
+/*
+*   enable the wake-up interrupt (machine timer)
+*/
+void bsp_enable_wakeup_interrupt(void)
+{
+  /* make sure the timer isn't pending before it is armed */
+  bsp_clear_wakeup_interrupt_indication();
+  /* enable timer interrupts in mie csr */
+  M_SET_CSR_BITS(mie, D_MIE_MTIE_MASK);
+}
+
+/*
+*   Arm the wake-up interrupt so it asserts 'delay' cpu cycles from now
+*
+*   delay    - number of cpu cycles from now until the interrupt asserts
+*   p_cycles - value of cpu cycles at which the interrupt asserts
+*/
+void bsp_trigger_wakeup_interrupt_delayed(unsigned int delay, volatile cycles_t* p_cycles)
+{
+  unsigned long long mtime, start;
+  unsigned int ticks;
+  cycles_t now;
+
+  /* number of timer ticks until the interrupt asserts */
+  ticks = (delay + D_CYCLES_PER_MTIME_TICK - 1) / D_CYCLES_PER_MTIME_TICK;
+
+  /* a tick is D_CYCLES_PER_MTIME_TICK cycles - wait for the next one and
+     sample mcycle just before the read that sees it, so the cycle of the
+     tick is known to a loop iteration */
+  start = bsp_read_mtime();
+  do
+  {
+    M_READ_CYCLE_COUNTER_REG(now);
+    mtime = bsp_read_mtime();
+  } while (mtime == start);
+
+  bsp_write_mtimecmp(mtime + ticks);
+  M_FENCE();
+
+  /* cpu cycle at which the timer asserts the interrupt */
+  *p_cycles = now + ticks * D_CYCLES_PER_MTIME_TICK;
+}
+
+/* periodic interrupt - period in timer ticks and the next compare value */
+static unsigned int g_periodic_ticks;
+static unsigned long long g_periodic_cmp;
+
+/*
+*   Start a periodic interrupt on the wake-up interrupt (machine timer);
+*   bsp_enable_wakeup_interrupt must be called first
+*
+*   period - number of cpu cycles between interrupts
+*/
+void bsp_start_periodic_interrupt(unsigned int period)
+{
+  g_periodic_ticks = (period + D_CYCLES_PER_MTIME_TICK - 1) / D_CYCLES_PER_MTIME_TICK;
+  g_periodic_cmp = bsp_read_mtime() + g_periodic_ticks;
+  bsp_write_mtimecmp(g_periodic_cmp);
+}
+
+/*
+*   Arm the next period - called from the interrupt handler; the period
+*   is kept from the previous compare value so handler latency doesn't drift it
+*/
+void bsp_rearm_periodic_interrupt(void)
+{
+  g_periodic_cmp += g_periodic_ticks;
+  bsp_write_mtimecmp(g_periodic_cmp);
+}
+
+/*
+*   Register a trap handler or vector table
+*
+*   p_ints_handler - address of trap handler or vector table
+*   is_vector      - 0, p_ints_handler is a trap handler
+*                    1, p_ints_handler is vector table
+*/
+void bsp_set_interrupts_handler(void *p_ints_handler, unsigned int is_vector)
+{
+  unsigned long ints_handler;
+
+  /* is_vector can be 0 or 1 only */
+  if (is_vector == 0 || is_vector == 1)
+  {
+    /* prepare the value of mtvec */
+    ints_handler = ((unsigned long)p_ints_handler) | is_vector;
+    /* write the value of mtvec */
+    M_WRITE_CSR(mtvec, ints_handler);
+  }
+}
+
+/*
+*   global enable interrupts
+*/
+void bsp_enable_interrupts(void)
+{
+  /* set mie bit in mstatus */
+  M_SET_CSR_BITS(mstatus, D_MSTATUS_MIE_MASK);
+}
+
+/*
+*   global disable interrupts
+*/
+void bsp_disable_interrupts(void)
+{
+  /* clear mie bit in mstatus */
+  M_CLEAR_CSR_BITS(mstatus, D_MSTATUS_MIE_MASK);
+}
+
+/*
+*   bsp specific initialization
+*/
+void bsp_init(void)
+{
+  /* nothing to initialize - msip and mtimecmp are cleared when their
+     interrupts are enabled */
+}
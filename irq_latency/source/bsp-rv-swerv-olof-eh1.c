@@ -1,18 +1,32 @@
 #include "int-latency.h"
 
 #define D_EXT_INT_IRQ3         3
+#define D_EXT_INT_IRQ4         4
 #define D_PIC_MEIPL_ADDR       0xF00C0000
 #define D_PIC_MEIE_ADDR        0xF00C2000
 #define D_PIC_MPICCFG_ADDR     0xF00C3000
 #define D_PIC_MEIGWCTRL_ADDR   0xF00C4000
 #define D_PIC_MEIGWCLR_ADDR    0xF00C5000
 #define D_TRIGGER_EXT_INT_ADDR 0x8000100B
+#define D_CSR_MEIVT            0xBC8
 #define D_CSR_MEIPT            0xBC9
+#define D_CSR_MEICPCT          0xBCA
 #define D_CSR_MEICIDPL         0xBCB
 #define D_CSR_MEICURPL         0xBCC
+#define D_CSR_MEIHAP           0xFC8
+/* meihap holds the claim id in bits 9:2 */
+#define D_MEIHAP_CLAIMID_SHIFT 2
+#define D_MEIHAP_CLAIMID_MASK  0xFF
+#define D_MTIME_ADDR           0x80001020
+#define D_MTIMECMP_ADDR        0x80001028
+/* swervolf mtime is clocked by the core clock */
+#define D_CYCLES_PER_MTIME_TICK 1
+#define M_READ_REGISTER_32(reg)          (*(volatile unsigned int *)(void*)(reg))
 #define M_WRITE_REGISTER_32(reg, value)  ((*(volatile unsigned int *)(void*)(reg)) = (value))
 #define M_WRITE_REGISTER_08(reg, value)  ((*(volatile unsigned char *)(void*)(reg)) = (value))
+#define M_READ_REGISTER_08(reg)          (*(volatile unsigned char *)(void*)(reg))
 #define D_MSTATUS_MIE_MASK     0x00000008
+#define D_MIE_MTIE_MASK        0x00000080
 #define D_MIE_MEIE_MASK        0x00000800
 
 #define _WRITE_CSR_(reg, val) ({ \
@@ -23,6 +37,10 @@
 #define _WRITE_CSR_INTERMEDIATE_(reg, val) _WRITE_CSR_(reg, val)
 #define M_WRITE_CSR(csr, val)   _WRITE_CSR_INTERMEDIATE_(csr, val)
 
+#define _READ_CSR_(reg, var) asm volatile ("csrr %0, " #reg : "=r"(var))
+#define _READ_CSR_INTERMEDIATE_(reg, var) _READ_CSR_(reg, var)
+#define M_READ_CSR(csr, var)    _READ_CSR_INTERMEDIATE_(csr, var)
+
 #define M_CLEAR_CSR_BITS(reg, bits) ({\
   if (__builtin_constant_p(bits) && (unsigned long)(bits) < 32) \
     asm volatile ("csrc " #reg ", %0" :: "i"(bits)); \
@@ -38,6 +56,11 @@
 /* fence instruction */
 #define M_FENCE() asm volatile("fence")
 
+/* swervolf external interrupt lines firmware can trigger - all are
+   triggered through the same byte register */
+static const unsigned int g_sw_ext_int_irqs[] = { D_EXT_INT_IRQ3, D_EXT_INT_IRQ4 };
+#define D_NUM_OF_SW_EXT_INTS   (sizeof(g_sw_ext_int_irqs)/sizeof(g_sw_ext_int_irqs[0]))
+
 /* 
 *   enable external interrupts
 */
@@ -97,6 +120,209 @@ void bsp_clear_external_interrupt_indication(void)
   M_WRITE_REGISTER_32(D_TRIGGER_EXT_INT_ADDR, 0);
 }
 
+/* 
+*   Number of external interrupt sources that can be triggered together
+*/
+unsigned int bsp_get_num_of_external_interrupt_sources(void)
+{
+  return D_NUM_OF_SW_EXT_INTS;
+}
+
+/* 
+*   Enable an external interrupt source at a given priority
+* 
+*   index    - source index, 0 .. bsp_get_num_of_external_interrupt_sources() - 1
+*   priority - 1 (lowest) .. 7
+*   return the source id reported by bsp_claim_external_interrupt
+*/
+unsigned int bsp_enable_external_interrupt_source(unsigned int index, unsigned int priority)
+{
+  unsigned int irq = g_sw_ext_int_irqs[index];
+
+  /* claim ids are read from meihap - keep the vector table base at 0 */
+  M_WRITE_CSR(D_CSR_MEIVT, 0);
+  M_WRITE_REGISTER_32(D_PIC_MPICCFG_ADDR, 0);
+  M_WRITE_CSR(D_CSR_MEIPT, 0);
+  M_WRITE_CSR(D_CSR_MEICURPL, 0);
+  /* level triggered, active high */
+  M_WRITE_REGISTER_32(D_PIC_MEIGWCTRL_ADDR + (irq*4), 0);
+  M_WRITE_REGISTER_32(D_PIC_MEIGWCLR_ADDR + (irq*4), 0);
+  M_WRITE_REGISTER_32(D_PIC_MEIPL_ADDR + (irq*4), priority);
+  M_WRITE_REGISTER_32(D_PIC_MEIE_ADDR + (irq*4), 1);
+  /* enable external interrupts in mie csr */
+  M_SET_CSR_BITS(mie, D_MIE_MEIE_MASK);
+
+  return irq;
+}
+
+/* 
+*   Trigger several external interrupt sources at once; returns once
+*   the interrupt controller signals a pending interrupt
+* 
+*   index_mask - bit n set triggers source index n
+*/
+void bsp_trigger_external_interrupt_sources(unsigned int index_mask)
+{
+  unsigned int i, mip;
+  unsigned char irqs = 0;
+
+  for (i = 0 ; i < D_NUM_OF_SW_EXT_INTS ; i++)
+  {
+    if (index_mask & (1 << i))
+    {
+      irqs |= (1 << g_sw_ext_int_irqs[i]);
+    }
+  }
+
+  /* trigger all sources with a single write */
+  M_WRITE_REGISTER_08(D_TRIGGER_EXT_INT_ADDR, irqs);
+  M_FENCE();
+  /* wait for the pic to forward them */
+  do
+  {
+    M_READ_CSR(mip, mip);
+  } while ((mip & D_MIE_MEIE_MASK) == 0);
+}
+
+/* 
+*   Claim the highest priority pending external interrupt
+* 
+*   return the claimed source id, 0 if no source is pending
+*/
+unsigned int bsp_claim_external_interrupt(void)
+{
+  unsigned int meihap;
+
+  /* capture the claim id and priority of the highest priority source */
+  M_WRITE_CSR(D_CSR_MEICPCT, 0);
+  M_READ_CSR(D_CSR_MEIHAP, meihap);
+
+  return (meihap >> D_MEIHAP_CLAIMID_SHIFT) & D_MEIHAP_CLAIMID_MASK;
+}
+
+/* 
+*   Complete a claimed external interrupt - deassert the source so the
+*   pic stops reporting it
+* 
+*   source_id - id returned by bsp_claim_external_interrupt
+*/
+void bsp_complete_external_interrupt(unsigned int source_id)
+{
+  /* deassert the line - the gateway is level triggered */
+  M_WRITE_REGISTER_08(D_TRIGGER_EXT_INT_ADDR,
+                      M_READ_REGISTER_08(D_TRIGGER_EXT_INT_ADDR) & ~(1 << source_id));
+  /* read back - the line is low before the next claim */
+  (void)M_READ_REGISTER_08(D_TRIGGER_EXT_INT_ADDR);
+  M_WRITE_REGISTER_32(D_PIC_MEIGWCLR_ADDR + (source_id*4), 0);
+}
+
+/* 
+*   Clear the wake-up interrupt indication 
+*/
+void bsp_clear_wakeup_interrupt_indication(void)
+{
+  /* push mtimecmp to its max value so the timer won't fire again */
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR + 4, 0xFFFFFFFF);
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR, 0xFFFFFFFF);
+}
+
+/* 
+*   enable the wake-up interrupt (machine timer)
+*/
+void bsp_enable_wakeup_interrupt(void)
+{
+  /* make sure the timer isn't pending before it is armed */
+  bsp_clear_wakeup_interrupt_indication();
+  /* enable timer interrupts in mie csr */
+  M_SET_CSR_BITS(mie, D_MIE_MTIE_MASK);
+}
+
+/* 
+*   Arm the wake-up interrupt so it asserts 'delay' cpu cycles from now
+* 
+*   delay    - number of cpu cycles from now until the interrupt asserts
+*   p_cycles - value of cpu cycles at which the interrupt asserts 
+*/
+void bsp_trigger_wakeup_interrupt_delayed(unsigned int delay, volatile cycles_t* p_cycles)
+{
+  unsigned int mtime_low, mtime_high, mtimecmp_low, mtimecmp_high, ticks;
+  cycles_t now;
+
+  /* number of timer ticks until the interrupt asserts */
+  ticks = (delay + D_CYCLES_PER_MTIME_TICK - 1) / D_CYCLES_PER_MTIME_TICK;
+
+  /* sample mcycle and mtime back to back - mcycle first, so the assert
+     cycle isn't late; retry if mtime high word changed */
+  do
+  {
+    mtime_high = M_READ_REGISTER_32(D_MTIME_ADDR + 4);
+    M_READ_CYCLE_COUNTER_REG(now);
+    mtime_low = M_READ_REGISTER_32(D_MTIME_ADDR);
+  } while (mtime_high != M_READ_REGISTER_32(D_MTIME_ADDR + 4));
+
+  /* calculate the compare value - propagate the carry to the high word */
+  mtimecmp_low = mtime_low + ticks;
+  mtimecmp_high = mtime_high + (mtimecmp_low < mtime_low);
+
+  /* write mtimecmp without passing through a value smaller than the target */
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR + 4, 0xFFFFFFFF);
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR, mtimecmp_low);
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR + 4, mtimecmp_high);
+  M_FENCE();
+
+  /* cpu cycle at which the timer asserts the interrupt */
+  *p_cycles = now + ticks * D_CYCLES_PER_MTIME_TICK;
+}
+
+/* periodic interrupt - period in timer ticks and the next compare value */
+static unsigned int g_periodic_ticks, g_periodic_cmp_low, g_periodic_cmp_high;
+
+/* 
+*   Write mtimecmp without passing through a value smaller than the target
+*/
+static void bsp_write_mtimecmp(unsigned int cmp_low, unsigned int cmp_high)
+{
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR + 4, 0xFFFFFFFF);
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR, cmp_low);
+  M_WRITE_REGISTER_32(D_MTIMECMP_ADDR + 4, cmp_high);
+}
+
+/* 
+*   Start a periodic interrupt on the wake-up interrupt (machine timer);
+*   bsp_enable_wakeup_interrupt must be called first
+* 
+*   period - number of cpu cycles between interrupts
+*/
+void bsp_start_periodic_interrupt(unsigned int period)
+{
+  unsigned int mtime_low, mtime_high;
+
+  g_periodic_ticks = (period + D_CYCLES_PER_MTIME_TICK - 1) / D_CYCLES_PER_MTIME_TICK;
+
+  do
+  {
+    mtime_high = M_READ_REGISTER_32(D_MTIME_ADDR + 4);
+    mtime_low = M_READ_REGISTER_32(D_MTIME_ADDR);
+  } while (mtime_high != M_READ_REGISTER_32(D_MTIME_ADDR + 4));
+
+  g_periodic_cmp_low = mtime_low + g_periodic_ticks;
+  g_periodic_cmp_high = mtime_high + (g_periodic_cmp_low < mtime_low);
+  bsp_write_mtimecmp(g_periodic_cmp_low, g_periodic_cmp_high);
+}
+
+/* 
+*   Arm the next period - called from the interrupt handler; the period
+*   is kept from the previous compare value so handler latency doesn't drift it
+*/
+void bsp_rearm_periodic_interrupt(void)
+{
+  unsigned int cmp_low = g_periodic_cmp_low + g_periodic_ticks;
+
+  g_periodic_cmp_high += (cmp_low < g_periodic_cmp_low);
+  g_periodic_cmp_low = cmp_low;
+  bsp_write_mtimecmp(g_periodic_cmp_low, g_periodic_cmp_high);
+}
+
 /* 
 *   Register a trap handler or vector table
 * 
@@ -107,13 +333,13 @@ void bsp_clear_external_interrupt_indication(void)
 */
 void bsp_set_interrupts_handler(void *p_ints_handler, unsigned int is_vector)
 {
-  unsigned int ints_handler;
+  unsigned long ints_handler;
 
   /* is_vector can be 0 or 1 only */
   if (is_vector == 0 || is_vector == 1)
   {
     /* prepare the calue of mtvec */
-    ints_handler = ((unsigned int)p_ints_handler) | is_vector;
+    ints_handler = ((unsigned long)p_ints_handler) | is_vector;
     /* write the value of mtvec */
     M_WRITE_CSR(mtvec, ints_handler);
   }
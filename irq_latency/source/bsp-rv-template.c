@@ -1,6 +1,7 @@
 #include "int-latency.h"
 
 #define D_MSTATUS_MIE_MASK     0x00000008
+#define D_MIE_MTIE_MASK        0x00000080
 #define D_MIE_MEIE_MASK        0x00000800
 
 #define _WRITE_CSR_(reg, val) ({ \
@@ -85,6 +86,131 @@ void bsp_clear_external_interrupt_indication(void)
 
 }
 
+/* 
+*   Number of external interrupt sources that can be triggered together
+*/
+unsigned int bsp_get_num_of_external_interrupt_sources(void)
+{
+  /* TODO: return the number of external interrupt lines firmware can trigger */
+  return 0;
+}
+
+/* 
+*   Enable an external interrupt source at a given priority
+* 
+*   index    - source index, 0 .. bsp_get_num_of_external_interrupt_sources() - 1
+*   priority - 1 (lowest) .. 7
+*   return the source id reported by bsp_claim_external_interrupt
+*/
+unsigned int bsp_enable_external_interrupt_source(unsigned int index, unsigned int priority)
+{
+  /* TODO: map index to a source id, write its priority and enable it;
+     for a standard PLIC: priority at base + 4*id, enable bit id at
+     base + 0x2000 (context 0) and the context threshold at base + 0x200000 */
+
+  /* enable external interrupts in mie scr */
+  M_SET_CSR_BITS(mie, D_MIE_MEIE_MASK);
+
+  return 0;
+}
+
+/* 
+*   Trigger several external interrupt sources at once; returns once
+*   the interrupt controller signals a pending interrupt
+* 
+*   index_mask - bit n set triggers source index n
+*/
+void bsp_trigger_external_interrupt_sources(unsigned int index_mask)
+{
+  /* TODO: trigger the sources of index_mask, then wait for mip.MEIP */
+
+  /* TODO: uncomment the following line if fence instruction is required */
+  /* M_FENCE(); */
+}
+
+/* 
+*   Claim the highest priority pending external interrupt
+* 
+*   return the claimed source id, 0 if no source is pending
+*/
+unsigned int bsp_claim_external_interrupt(void)
+{
+  /* TODO: for a standard PLIC read the claim register (base + 0x200004) */
+  return 0;
+}
+
+/* 
+*   Complete a claimed external interrupt
+* 
+*   source_id - id returned by bsp_claim_external_interrupt
+*/
+void bsp_complete_external_interrupt(unsigned int source_id)
+{
+  /* TODO: deassert the source; for a standard PLIC write source_id back
+     to the claim/complete register (base + 0x200004) */
+}
+
+/* 
+*   Clear the wake-up interrupt indication 
+*/
+void bsp_clear_wakeup_interrupt_indication(void)
+{
+  /* TODO: write here the code that pushes mtimecmp out so the timer won't fire again */
+
+}
+
+/* 
+*   enable the wake-up interrupt (machine timer)
+*/
+void bsp_enable_wakeup_interrupt(void)
+{
+  /* make sure the timer isn't pending before it is armed */
+  bsp_clear_wakeup_interrupt_indication();
+  /* enable timer interrupts in mie csr */
+  M_SET_CSR_BITS(mie, D_MIE_MTIE_MASK);
+}
+
+/* 
+*   Arm the wake-up interrupt so it asserts 'delay' cpu cycles from now
+* 
+*   delay    - number of cpu cycles from now until the interrupt asserts
+*   p_cycles - value of cpu cycles at which the interrupt asserts 
+*/
+void bsp_trigger_wakeup_interrupt_delayed(unsigned int delay, volatile cycles_t* p_cycles)
+{
+  cycles_t now;
+
+  /* read the value of mcycles register - right before mtime */
+  M_READ_CYCLE_COUNTER_REG(now);
+
+  /* TODO: read mtime, write mtimecmp = mtime + delay (converted to timer ticks) */
+
+  /* TODO: uncomment the following line if fence instruction is required */
+  /* M_FENCE(); */
+
+  /* cpu cycle at which the timer asserts the interrupt */
+  *p_cycles = now + delay;
+}
+
+/* 
+*   Start a periodic interrupt on the wake-up interrupt (machine timer);
+*   bsp_enable_wakeup_interrupt must be called first
+* 
+*   period - number of cpu cycles between interrupts
+*/
+void bsp_start_periodic_interrupt(unsigned int period)
+{
+  /* TODO: keep the period in timer ticks, write mtimecmp = mtime + period */
+}
+
+/* 
+*   Arm the next period - called from the interrupt handler
+*/
+void bsp_rearm_periodic_interrupt(void)
+{
+  /* TODO: advance mtimecmp by one period from its previous value */
+}
+
 /* 
 *   Register a trap handler or vector table
 * 
@@ -95,13 +221,13 @@ void bsp_clear_external_interrupt_indication(void)
 */
 void bsp_set_interrupts_handler(void *p_ints_handler, unsigned int is_vector)
 {
-  unsigned int ints_handler;
+  unsigned long ints_handler;
 
   /* is_vector can be 0 or 1 only */
   if (is_vector == 0 || is_vector == 1)
   {
     /* prepare the calue of mtvec */
-    ints_handler = ((unsigned int)p_ints_handler) | is_vector;
+    ints_handler = ((unsigned long)p_ints_handler) | is_vector;
     /* write the value of mtvec */
     M_WRITE_CSR(mtvec, ints_handler);
   }
@@ -52,4 +52,75 @@ void bsp_set_interrupts_handler(void *p_ints_handler, unsigned int is_vector);
 */
 void bsp_trigger_external_interrupt_sample_cycles(volatile cycles_t* p_cycles);
 
+/* 
+*   enable the wake-up interrupt (machine timer) used to measure
+*   the latency of waking the core from wfi
+*/
+void bsp_enable_wakeup_interrupt(void);
+
+/* 
+*   Arm the wake-up interrupt so it asserts 'delay' cpu cycles from now;
+*   the caller is expected to be idle (wfi) or busy by the time it fires
+* 
+*   delay    - number of cpu cycles from now until the interrupt asserts
+*   p_cycles - value of cpu cycles at which the interrupt asserts 
+*/
+void bsp_trigger_wakeup_interrupt_delayed(unsigned int delay, volatile cycles_t* p_cycles);
+
+/* 
+*   Clear the wake-up interrupt indication - called from the interrupt handler
+*/
+void bsp_clear_wakeup_interrupt_indication(void);
+
+/* 
+*   Start a periodic interrupt on the wake-up interrupt (machine timer);
+*   bsp_enable_wakeup_interrupt must be called first, stopped by
+*   bsp_clear_wakeup_interrupt_indication
+* 
+*   period - number of cpu cycles between interrupts
+*/
+void bsp_start_periodic_interrupt(unsigned int period);
+
+/* 
+*   Arm the next period - called from the interrupt handler
+*/
+void bsp_rearm_periodic_interrupt(void);
+
+/* 
+*   Number of external interrupt sources that can be triggered together
+*   (used by the dispatch benchmark)
+*/
+unsigned int bsp_get_num_of_external_interrupt_sources(void);
+
+/* 
+*   Enable an external interrupt source at a given priority
+* 
+*   index    - source index, 0 .. bsp_get_num_of_external_interrupt_sources() - 1
+*   priority - 1 (lowest) .. 7
+*   return the source id reported by bsp_claim_external_interrupt
+*/
+unsigned int bsp_enable_external_interrupt_source(unsigned int index, unsigned int priority);
+
+/* 
+*   Trigger several external interrupt sources at once; returns once
+*   the interrupt controller signals a pending interrupt
+* 
+*   index_mask - bit n set triggers source index n
+*/
+void bsp_trigger_external_interrupt_sources(unsigned int index_mask);
+
+/* 
+*   Claim the highest priority pending external interrupt
+* 
+*   return the claimed source id, 0 if no source is pending
+*/
+unsigned int bsp_claim_external_interrupt(void);
+
+/* 
+*   Complete a claimed external interrupt
+* 
+*   source_id - id returned by bsp_claim_external_interrupt
+*/
+void bsp_complete_external_interrupt(unsigned int source_id);
+
 #endif /* __INT_LATENCY_BSP_H__ */
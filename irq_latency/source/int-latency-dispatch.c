@@ -0,0 +1,203 @@
+
+#include "int-latency.h"
+#include "int-latency-bsp.h"
+
+/*
+ * External interrupt dispatch benchmark - N sources at different
+ * priorities are made pending while interrupts are masked; once unmasked
+ * a single trap claims each source from the interrupt controller, looks up
+ * its handler in the table of registered handlers, calls it and completes
+ * the source, until nothing is pending. Measured from the unmask to each
+ * handler entry and to the end of the drain.
+ */
+
+#define D_EXT_INT_MAX_SOURCES        32
+#define D_EXT_INT_NUM_OF_COUNTS      6
+#define D_EXT_INT_NUM_OF_PRIORITIES  7
+/* handlers table size - highest source id + 1 */
+#define D_EXT_INT_NUM_OF_IDS         64
+
+/* external interrupt handler - called with the claimed source id */
+typedef void (*extIntHandler_t)(unsigned int source_id);
+
+/* measurement results of a single burst size */
+typedef struct extIntBurstResult
+{
+  /* number of sources pending together */
+  unsigned int num_of_sources;
+  /* number of handlers called - 0 if the bsp can't trigger that many */
+  unsigned int num_of_handled;
+  /* cpu cycles from unmask to trap entry */
+  unsigned int cycles_to_trap_entry;
+  /* cpu cycles from unmask to the last source completed */
+  unsigned int cycles_to_drain;
+}extIntBurstResult_t;
+
+/* per source results of the largest burst */
+typedef struct extIntSourceResult
+{
+  /* interrupt controller source id */
+  unsigned int source_id;
+  /* source priority - 1 (lowest) .. D_EXT_INT_NUM_OF_PRIORITIES */
+  unsigned int priority;
+  /* position in the dispatch order - 1 is the first handled */
+  unsigned int dispatch_order;
+  /* cpu cycles from unmask to handler entry */
+  unsigned int cycles_to_handler;
+}extIntSourceResult_t;
+
+/* trap handler implemented in psp-int-rv.S */
+void psp_trap_handler_dispatch(void);
+/* trap entry cycles - written by the trap handler */
+extern volatile cycles_t g_num_of_cycles;
+
+/* benchmark results */
+volatile extIntBurstResult_t g_ext_int_burst_results[D_EXT_INT_NUM_OF_COUNTS];
+volatile extIntSourceResult_t g_ext_int_source_results[D_EXT_INT_MAX_SOURCES];
+volatile unsigned int g_ext_int_dispatch_errors;
+
+static const unsigned int g_ext_int_counts[D_EXT_INT_NUM_OF_COUNTS] = { 1, 2, 4, 8, 16, 32 };
+
+/* registered handlers */
+static extIntHandler_t g_ext_int_handlers[D_EXT_INT_NUM_OF_IDS];
+/* source id to source index */
+static unsigned int g_ext_int_index_of[D_EXT_INT_NUM_OF_IDS];
+
+/* not static - M_READ_CYCLE_COUNTER refers to them by symbol name */
+volatile cycles_t g_ext_int_cycles_start, g_ext_int_cycles_handler, g_ext_int_cycles_drained;
+static volatile unsigned int g_ext_int_handled;
+
+/*
+ * Register the handler of an external interrupt source
+ * source_id - interrupt controller source id
+ * handler - handler function, 0 to unregister
+ */
+void
+register_external_interrupt_handler(unsigned int source_id, extIntHandler_t handler)
+{
+  if (source_id < D_EXT_INT_NUM_OF_IDS)
+  {
+    g_ext_int_handlers[source_id] = handler;
+  }
+}
+
+/*
+ * Claim, dispatch and complete every pending external interrupt -
+ * called from psp_trap_handler_dispatch
+ */
+void
+external_interrupt_dispatch(void)
+{
+  unsigned int source_id;
+
+  /* the controller hands over the highest priority source first */
+  while ((source_id = bsp_claim_external_interrupt()) != 0)
+  {
+    if (source_id < D_EXT_INT_NUM_OF_IDS && g_ext_int_handlers[source_id] != 0)
+    {
+      g_ext_int_handlers[source_id](source_id);
+    }
+    else
+    {
+      /* no handler - spurious source */
+      g_ext_int_dispatch_errors++;
+    }
+    bsp_complete_external_interrupt(source_id);
+  }
+
+  /* read cpu cycle - nothing is pending */
+  M_READ_CYCLE_COUNTER(g_ext_int_cycles_drained);
+}
+
+/*
+ * Benchmark handler - record the source latency and dispatch order
+ */
+static void
+ext_int_bench_handler(unsigned int source_id)
+{
+  unsigned int index;
+
+  /* read cpu cycle */
+  M_READ_CYCLE_COUNTER(g_ext_int_cycles_handler);
+
+  index = g_ext_int_index_of[source_id];
+  g_ext_int_handled++;
+  g_ext_int_source_results[index].dispatch_order = g_ext_int_handled;
+  g_ext_int_source_results[index].cycles_to_handler = g_ext_int_cycles_handler - g_ext_int_cycles_start;
+}
+
+/*
+ * Measure the dispatch of a burst of pending sources
+ * rpt - number of measurements, the last one is reported
+ * num_of_sources - number of sources pending together
+ * p_result - burst result
+ */
+static void
+measure_dispatch_burst(int rpt, unsigned int num_of_sources, volatile extIntBurstResult_t* p_result)
+{
+  int loop_count;
+  unsigned int i, source_id, index_mask;
+
+  /* enable and register the sources - priorities rise with the index */
+  for (i = 0 ; i < num_of_sources ; i++)
+  {
+    g_ext_int_source_results[i].priority = 1 + (i % D_EXT_INT_NUM_OF_PRIORITIES);
+    source_id = bsp_enable_external_interrupt_source(i, g_ext_int_source_results[i].priority);
+    g_ext_int_source_results[i].source_id = source_id;
+    if (source_id >= D_EXT_INT_NUM_OF_IDS)
+    {
+      /* the handlers table is too small for this bsp */
+      g_ext_int_dispatch_errors++;
+      return;
+    }
+    g_ext_int_index_of[source_id] = i;
+    register_external_interrupt_handler(source_id, ext_int_bench_handler);
+  }
+  index_mask = (num_of_sources == 32) ? 0xFFFFFFFF : (1u << num_of_sources) - 1;
+
+  for (loop_count = 0 ; loop_count < rpt ; loop_count++)
+  {
+    g_ext_int_handled = 0;
+    /* make all sources pending while interrupts are masked */
+    bsp_disable_interrupts();
+    bsp_trigger_external_interrupt_sources(index_mask);
+    /* read cpu cycle - start measure */
+    M_READ_CYCLE_COUNTER(g_ext_int_cycles_start);
+    /* the burst is drained once this returns */
+    bsp_enable_interrupts();
+  }
+
+  p_result->num_of_handled = g_ext_int_handled;
+  p_result->cycles_to_trap_entry = g_num_of_cycles - g_ext_int_cycles_start;
+  p_result->cycles_to_drain = g_ext_int_cycles_drained - g_ext_int_cycles_start;
+  g_ext_int_dispatch_errors += (g_ext_int_handled != num_of_sources);
+}
+
+void
+ext_int_dispatch_benchmark(int rpt)
+{
+  unsigned int i, max_sources;
+
+  g_ext_int_dispatch_errors = 0;
+
+  /* set interrupt trap */
+  bsp_set_interrupts_handler((void*)psp_trap_handler_dispatch, 0);
+
+  max_sources = bsp_get_num_of_external_interrupt_sources();
+  for (i = 0 ; i < D_EXT_INT_NUM_OF_COUNTS ; i++)
+  {
+    g_ext_int_burst_results[i].num_of_sources = g_ext_int_counts[i];
+    /* bursts larger than the bsp can trigger are reported empty */
+    if (g_ext_int_counts[i] <= max_sources)
+    {
+      measure_dispatch_burst(rpt, g_ext_int_counts[i], &g_ext_int_burst_results[i]);
+    }
+  }
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
@@ -0,0 +1,215 @@
+
+#include "int-latency.h"
+#include "int-latency-bsp.h"
+
+/*
+ * Interrupt throughput benchmark - the external interrupt is left asserted
+ * so it re-fires as soon as the handler returns; the trap path is then
+ * taken back to back and the time between consecutive handler entries is
+ * the cost of retiring a single interrupt. Measured with the full
+ * M_PSP_PUSH/M_PSP_POP context save and a C handler, and with a handler
+ * that only saves the registers it uses. A periodic timer interrupt then
+ * loads a background loop at a sweep of rates to find the cpu left to it.
+ */
+
+/* back to back interrupts per measurement */
+#define D_IRQ_RATE_NUM_OF_IRQS     256
+#define D_IRQ_RATE_NUM_OF_PERIODS  5
+/* background loop measurement window */
+#define D_IRQ_RATE_WINDOW_CYCLES   (64*1024)
+
+/* back to back throughput of a trap path */
+typedef struct irqRateResult
+{
+  /* number of interrupts retired back to back */
+  unsigned int num_of_irqs;
+  /* average cpu cycles between consecutive handler entries */
+  unsigned int cycles_between_entries;
+  /* max sustained interrupts per second at D_CORE_CLOCK_HZ */
+  unsigned int irqs_per_sec;
+}irqRateResult_t;
+
+/* background loop under a periodic interrupt */
+typedef struct irqLoadResult
+{
+  /* cpu cycles between interrupts */
+  unsigned int period_cycles;
+  /* interrupt rate at D_CORE_CLOCK_HZ */
+  unsigned int irqs_per_sec;
+  /* interrupts taken during the measurement window */
+  unsigned int num_of_irqs;
+  /* background loop iterations during the measurement window */
+  unsigned int background_iterations;
+  /* background iterations relative to an interrupt free window */
+  unsigned int cpu_left_percent;
+}irqLoadResult_t;
+
+/* trap handlers implemented in psp-int-rv.S */
+void psp_trap_handler_rate(void);
+void psp_trap_handler_rate_lite(void);
+void psp_trap_handler_periodic(void);
+
+/* benchmark results */
+volatile irqRateResult_t g_irq_rate_full, g_irq_rate_lite;
+volatile irqLoadResult_t g_irq_load_results[D_IRQ_RATE_NUM_OF_PERIODS];
+volatile unsigned int g_irq_background_iterations_idle;
+volatile unsigned int g_irq_rate_errors;
+
+static const unsigned int g_irq_rate_periods[D_IRQ_RATE_NUM_OF_PERIODS] = { 4096, 2048, 1024, 512, 256 };
+
+/* not static - psp_trap_handler_rate_lite refers to them by symbol name */
+volatile unsigned int g_irq_rate_count, g_irq_rate_count_target;
+volatile cycles_t g_irq_rate_cycles_first, g_irq_rate_cycles_last;
+static volatile unsigned int g_irq_periodic_count;
+
+/*
+ * Rate measurement handler - called from psp_trap_handler_rate; the
+ * source stays asserted until the target count is reached
+ */
+void
+interrupt_handler_rate(void)
+{
+  g_irq_rate_count++;
+  /* read cpu cycle - the first and the latest entry */
+  if (g_irq_rate_count == 1)
+  {
+    M_READ_CYCLE_COUNTER_REG(g_irq_rate_cycles_first);
+  }
+  if (g_irq_rate_count <= g_irq_rate_count_target)
+  {
+    M_READ_CYCLE_COUNTER_REG(g_irq_rate_cycles_last);
+  }
+  if (g_irq_rate_count == g_irq_rate_count_target)
+  {
+    /* clear interrupt indication - stop re-firing */
+    bsp_clear_external_interrupt_indication();
+  }
+}
+
+/*
+ * Periodic interrupt handler - called from psp_trap_handler_periodic
+ */
+void
+interrupt_handler_periodic(void)
+{
+  g_irq_periodic_count++;
+  bsp_rearm_periodic_interrupt();
+}
+
+/*
+ * Measure back to back interrupts through a trap path
+ * p_ints_handler - trap handler
+ * p_result - throughput result
+ */
+static void
+measure_irq_rate(void* p_ints_handler, volatile irqRateResult_t* p_result)
+{
+  unsigned int cycles;
+
+  /* set interrupt trap */
+  bsp_set_interrupts_handler(p_ints_handler, 0);
+
+  g_irq_rate_count = 0;
+  g_irq_rate_count_target = D_IRQ_RATE_NUM_OF_IRQS;
+
+  /* (re)enable the source - the lite handler disables it when done */
+  bsp_enble_external_interrupt();
+  /* the source stays asserted - the handler is re-entered until the target */
+  bsp_trigger_external_interrupt();
+  while (g_irq_rate_count < g_irq_rate_count_target)
+    ;
+
+  /* the full handler clears the source, the lite one only masks it */
+  bsp_clear_external_interrupt_indication();
+
+  cycles = g_irq_rate_cycles_last - g_irq_rate_cycles_first;
+  p_result->num_of_irqs = g_irq_rate_count;
+  p_result->cycles_between_entries = cycles/(D_IRQ_RATE_NUM_OF_IRQS - 1);
+  p_result->irqs_per_sec = cycles ? (unsigned int)(((unsigned long long)D_CORE_CLOCK_HZ*(D_IRQ_RATE_NUM_OF_IRQS - 1))/cycles) : 0;
+}
+
+/*
+ * Background loop - count iterations for D_IRQ_RATE_WINDOW_CYCLES cycles
+ */
+static unsigned int __attribute__ ((noinline))
+background_loop(void)
+{
+  unsigned int iterations = 0;
+  cycles_t now, end;
+
+  /* read cpu cycle */
+  M_READ_CYCLE_COUNTER_REG(now);
+  end = now + D_IRQ_RATE_WINDOW_CYCLES;
+
+  while (now < end)
+  {
+    iterations++;
+    /* read cpu cycle */
+    M_READ_CYCLE_COUNTER_REG(now);
+  }
+
+  return iterations;
+}
+
+/*
+ * Measure the background loop under a periodic interrupt
+ * period - cpu cycles between interrupts
+ * p_result - load result
+ */
+static void
+measure_irq_load(unsigned int period, volatile irqLoadResult_t* p_result)
+{
+  unsigned int iterations;
+
+  g_irq_periodic_count = 0;
+  bsp_start_periodic_interrupt(period);
+  iterations = background_loop();
+  bsp_clear_wakeup_interrupt_indication();
+
+  p_result->period_cycles = period;
+  p_result->irqs_per_sec = D_CORE_CLOCK_HZ/period;
+  p_result->num_of_irqs = g_irq_periodic_count;
+  p_result->background_iterations = iterations;
+  p_result->cpu_left_percent = (unsigned int)(((unsigned long long)iterations*100)/g_irq_background_iterations_idle);
+
+  /* the window must have been interrupted about window/period times */
+  g_irq_rate_errors += (g_irq_periodic_count < (D_IRQ_RATE_WINDOW_CYCLES/period)/2);
+}
+
+void
+irq_rate_benchmark(void)
+{
+  unsigned int i;
+
+  g_irq_rate_errors = 0;
+
+  /* back to back - full context save and a c handler */
+  measure_irq_rate((void*)psp_trap_handler_rate, &g_irq_rate_full);
+  /* back to back - only the used registers are saved */
+  measure_irq_rate((void*)psp_trap_handler_rate_lite, &g_irq_rate_lite);
+  g_irq_rate_errors += (g_irq_rate_full.num_of_irqs < D_IRQ_RATE_NUM_OF_IRQS);
+  g_irq_rate_errors += (g_irq_rate_lite.num_of_irqs != D_IRQ_RATE_NUM_OF_IRQS);
+
+  /* background loop without interrupts - the 100% reference */
+  g_irq_background_iterations_idle = background_loop();
+  if (g_irq_background_iterations_idle == 0)
+  {
+    g_irq_rate_errors++;
+    return;
+  }
+
+  /* background loop under a periodic timer interrupt */
+  bsp_set_interrupts_handler((void*)psp_trap_handler_periodic, 0);
+  bsp_enable_wakeup_interrupt();
+  for (i = 0 ; i < D_IRQ_RATE_NUM_OF_PERIODS ; i++)
+  {
+    measure_irq_load(g_irq_rate_periods[i], &g_irq_load_results[i]);
+  }
+}
+
+/*
+   Local Variables:
+   mode: C
+   c-file-style: "gnu"
+   End:
+*/
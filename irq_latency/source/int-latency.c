@@ -7,6 +7,11 @@ void psp_vect_table(void);
 void psp_trap_handler(void);
 void psp_vect_table_pure(void);
 void psp_trap_handler_pure(void);
+void psp_trap_handler_wakeup(void);
+
+/* optional benchmarks */
+void ext_int_dispatch_benchmark(int rpt);
+void irq_rate_benchmark(void);
 
 /* global variables */
 volatile unsigned int cycles_to_vect_entry = 0, cycles_to_trap_entry = 0;
@@ -15,8 +20,23 @@ volatile cycles_t g_cycles_overhead;
 volatile cycles_t g_num_of_cycles_isr_entry, g_num_of_cycles;
 static volatile cycles_t g_num_of_cycles_start;
 unsigned int g_trap_count, g_vect_count;
+volatile unsigned int cycles_wakeup_to_trap_entry_busy = 0, cycles_wakeup_to_resume_busy = 0;
+volatile unsigned int cycles_wakeup_to_trap_entry_wfi = 0, cycles_wakeup_to_resume_wfi = 0;
+volatile cycles_t g_num_of_cycles_resume;
+volatile unsigned int g_wakeup_count;
+
+#ifdef D_STACK_WATERMARK
+/* main stack (shared by the isrs) size and high-water mark in bytes */
+volatile unsigned int g_stack_size_main, g_stack_used_main;
+/* main stack bounds - provided by the linker script */
+extern unsigned int _heap_end[], _sp[];
+#endif /* D_STACK_WATERMARK */
 
 #define D_LOOP_COUNT           256
+/* unused stack words pattern - high-water mark detection */
+#define D_STACK_PAINT          0xA5A5A5A5
+/* wake-up interrupt delay - long enough for the core to reach wfi */
+#define D_WAKEUP_DELAY_CYCLES  256
 
 __attribute__ ((interrupt))
 void
@@ -41,6 +61,15 @@ interrupt_handler_from_trap(void)
   bsp_clear_external_interrupt_indication();
 }
 
+void
+interrupt_handler_from_wakeup(void)
+{
+  /* count number of wake-up interrupts */
+  g_wakeup_count++;
+  /* clear interrupt indication */
+  bsp_clear_wakeup_interrupt_indication();
+}
+
 unsigned int
 measure_int_latency(int rpt, unsigned int* p_int_count, void* p_ints_handler,
                     unsigned int is_vector, volatile cycles_t* p_measure_end)
@@ -71,6 +100,64 @@ measure_int_latency(int rpt, unsigned int* p_int_count, void* p_ints_handler,
     return 0;
 }
 
+/*
+ * Measure the wake-up latency from the interrupt assertion to trap entry
+ * and back to the waiting code, while the core is either busy or in wfi
+ * rpt                - number of measurements
+ * is_wfi             - 0, the core busy-waits for the interrupt
+ *                      1, the core waits for the interrupt in wfi
+ * p_cycles_to_resume - cycles from the interrupt to the waiting code resume
+ * return cycles from the interrupt to trap entry
+ */
+unsigned int
+measure_wakeup_latency(int rpt, unsigned int is_wfi, volatile unsigned int* p_cycles_to_resume)
+{
+    int loop_count;
+    unsigned int wakeup_count;
+
+    /* set interrupt trap */
+    bsp_set_interrupts_handler((void*)psp_trap_handler_wakeup, 0);
+
+    /* initialize interrupt counter - how many interrupts occurred */
+    g_wakeup_count = 0;
+
+    for (loop_count = 0 ; loop_count < rpt ; loop_count++)
+    {
+        wakeup_count = g_wakeup_count;
+        /* arm the interrupt - get the cpu cycle it asserts at */
+        bsp_trigger_wakeup_interrupt_delayed(D_WAKEUP_DELAY_CYCLES, &g_num_of_cycles_start);
+        /* wait for the interrupt */
+        while (wakeup_count == g_wakeup_count)
+        {
+            if (is_wfi)
+            {
+                /* masked from the check to wfi - an interrupt in between
+                   keeps it pending, so wfi doesn't sleep past it */
+                M_DISABLE_INTERRUPTS();
+                if (wakeup_count == g_wakeup_count)
+                {
+                    M_WAIT_FOR_INTERRUPT();
+                }
+                /* the pending interrupt is taken here */
+                M_ENABLE_INTERRUPTS();
+            }
+        }
+        /* read cpu cycle - waiting code resumed */
+        M_READ_CYCLE_COUNTER_REG(g_num_of_cycles_resume);
+        /* number of cycles to the waiting code */
+        *p_cycles_to_resume = g_num_of_cycles_resume - g_num_of_cycles_start;
+        /* number of cycles to trap entry */
+        g_num_of_cycles -= g_num_of_cycles_start;
+    }
+
+    if (g_wakeup_count == rpt)
+    {
+        return g_num_of_cycles;
+    }
+
+    return 0;
+}
+
 unsigned int
 measure_overhead_cycles_trigger_ext_int(int rpt)
 {
@@ -97,6 +184,39 @@ measure_overhead_cycles_trigger_ext_int(int rpt)
     return 0;
 }
 
+#ifdef D_STACK_WATERMARK
+/*
+ * Paint the unused part of the main stack - from the stack limit up to
+ * the current sp of this (leaf) function
+ */
+void __attribute__ ((noinline))
+paint_main_stack(void)
+{
+    unsigned int *p_word, *p_sp;
+
+    M_READ_STACK_POINTER(p_sp);
+    for (p_word = _heap_end ; p_word < p_sp ; p_word++)
+    {
+        *p_word = D_STACK_PAINT;
+    }
+}
+
+/*
+ * Count the main stack bytes used since it was painted
+ * return the high-water mark in bytes
+ */
+unsigned int
+main_stack_high_water_mark(void)
+{
+    unsigned int *p_word;
+
+    /* untouched words are at the bottom of the stack */
+    for (p_word = _heap_end ; p_word < _sp && *p_word == D_STACK_PAINT ; p_word++);
+
+    return (_sp - p_word)*sizeof(unsigned int);
+}
+#endif /* D_STACK_WATERMARK */
+
 int
 verify_benchmark (int res __attribute ((unused)))
 {
@@ -129,6 +249,11 @@ benchmark (void)
 static int __attribute__ ((noinline))
 benchmark_body (int rpt)
 {
+#ifdef D_STACK_WATERMARK
+  /* isrs run on the main stack - paint it before any interrupt */
+  paint_main_stack();
+#endif /* D_STACK_WATERMARK */
+
   /* initialize and enable a specific external interrupt */
   bsp_enble_external_interrupt();
 
@@ -184,6 +309,40 @@ benchmark_body (int rpt)
                                   0, &g_num_of_cycles_isr_entry);
 #endif /* D_CORE_HAS_TRAP */
 
+#ifdef D_CORE_HAS_WFI
+  /*
+   * measure from wake-up interrupt to trap entry and to the waiting code
+   */
+
+  /* initialize and enable the wake-up interrupt */
+  bsp_enable_wakeup_interrupt();
+
+  /* measure with the core busy waiting for the interrupt */
+  cycles_wakeup_to_trap_entry_busy = measure_wakeup_latency(rpt, 0, &cycles_wakeup_to_resume_busy);
+
+  /* measure with the core idle in wfi */
+  cycles_wakeup_to_trap_entry_wfi = measure_wakeup_latency(rpt, 1, &cycles_wakeup_to_resume_wfi);
+#endif /* D_CORE_HAS_WFI */
+
+#if defined(D_EXT_INT_DISPATCH_BENCH) && defined(D_CORE_HAS_TRAP)
+  /*
+   * measure claim/dispatch/complete of bursts of pending external interrupts
+   */
+  ext_int_dispatch_benchmark(rpt);
+#endif /* D_EXT_INT_DISPATCH_BENCH && D_CORE_HAS_TRAP */
+
+#if defined(D_IRQ_RATE_BENCH) && defined(D_CORE_HAS_TRAP)
+  /*
+   * measure back to back interrupt throughput and the cpu left under load
+   */
+  irq_rate_benchmark();
+#endif /* D_IRQ_RATE_BENCH && D_CORE_HAS_TRAP */
+
+#ifdef D_STACK_WATERMARK
+  g_stack_size_main = (_sp - _heap_end)*sizeof(unsigned int);
+  g_stack_used_main = main_stack_high_water_mark();
+#endif /* D_STACK_WATERMARK */
+
   return 0;
 }
 
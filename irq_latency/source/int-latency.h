@@ -1,8 +1,24 @@
 #ifndef __INT_LATENCY_H__
 #define __INT_LATENCY_H__
 
+/* core clock - converts cycles to rates */
+#ifndef D_CORE_CLOCK_HZ
+#define D_CORE_CLOCK_HZ  50000000
+#endif /* D_CORE_CLOCK_HZ */
+
 #ifdef D_RISCV
-   #ifdef D_64_BIT_CYCLES
+   #if defined(D_64_BIT_CYCLES) && __riscv_xlen == 64
+       /* rv64 - the counter csr is 64 bit wide, no high half to read */
+       typedef unsigned long long cycles_t;
+       #ifdef D_CYCLES
+          #define M_READ_CYCLE_COUNTER(var)     asm volatile ("csrr %0, mcycle" : "=r"(var));
+          #define M_READ_CYCLE_COUNTER_END(var) M_READ_CYCLE_COUNTER(var)
+       #else
+          #define M_READ_CYCLE_COUNTER(var)     asm volatile ("csrr %0, minstret" : "=r"(var));
+          #define M_READ_CYCLE_COUNTER_END(var) M_READ_CYCLE_COUNTER(var)
+       #endif /* D_CYCLES */
+       #define M_READ_CYCLE_COUNTER_REG(var)    M_READ_CYCLE_COUNTER(var)
+   #elif defined(D_64_BIT_CYCLES)
        typedef unsigned long long cycles_t;
        #ifdef D_CYCLES
           #define M_READ_CYCLE_COUNTER(var)     asm volatile ("la t4, " #var : ); \
@@ -27,6 +43,17 @@
                                                 asm volatile ("sw t6, 0(t4)"); \
                                                 asm volatile ("sw t5, 4(t4)");
        #endif /* D_CYCLES */
+       /* M_READ_CYCLE_COUNTER stores a global through t4-t6 without telling
+          the compiler - C code with live locals reads through operands */
+       #ifdef D_CYCLES
+          #define M_READ_CYCLE_COUNTER_REG(var) do { unsigned int _low, _high; \
+                                                asm volatile ("csrr %0, mcycleh\n\tcsrr %1, mcycle" : "=&r"(_high), "=r"(_low)); \
+                                                (var) = ((cycles_t)_high << 32) | _low; } while (0);
+       #else
+          #define M_READ_CYCLE_COUNTER_REG(var) do { unsigned int _low, _high; \
+                                                asm volatile ("csrr %0, minstreth\n\tcsrr %1, minstret" : "=&r"(_high), "=r"(_low)); \
+                                                (var) = ((cycles_t)_high << 32) | _low; } while (0);
+       #endif /* D_CYCLES */
    #else /* D_64_BIT_CYCLES */
        typedef unsigned int cycles_t;
        #ifdef D_CYCLES
@@ -36,7 +63,21 @@
           #define M_READ_CYCLE_COUNTER(var)     asm volatile ("csrr %0, minstret" : "=r"(var));
           #define M_READ_CYCLE_COUNTER_END(var) M_READ_CYCLE_COUNTER(var)
        #endif /* D_CYCLES */
+       #define M_READ_CYCLE_COUNTER_REG(var)    M_READ_CYCLE_COUNTER(var)
    #endif /* D_64_BIT_CYCLES */
+#elif defined(D_ARM)
+   /* Cortex-M - one 32 bit counter, D_64_BIT_CYCLES doesn't apply; DWT
+      CYCCNT, or SysTick extended by the bsp on cores (or models) without
+      the DWT (D_ARM_SYSTICK_CYCLES) */
+   typedef unsigned int cycles_t;
+   #ifdef D_ARM_SYSTICK_CYCLES
+       unsigned int bsp_read_cycles(void);
+       #define M_READ_CYCLE_COUNTER(var)     (var) = bsp_read_cycles();
+   #else
+       #define M_READ_CYCLE_COUNTER(var)     (var) = *(volatile unsigned int*)0xE0001004;
+   #endif /* D_ARM_SYSTICK_CYCLES */
+   #define M_READ_CYCLE_COUNTER_END(var)     M_READ_CYCLE_COUNTER(var)
+   #define M_READ_CYCLE_COUNTER_REG(var)     M_READ_CYCLE_COUNTER(var)
 #else
    #ifdef D_64_BIT_CYCLES
        typedef unsigned int cycles_t;
@@ -57,5 +98,29 @@
           #define M_READ_CYCLE_COUNTER_END(var)
        #endif /* D_CYCLES */
    #endif /* D_64_BIT_CYCLES */
+   #define M_READ_CYCLE_COUNTER_REG(var)
+#endif /* D_RISCV */
+
+#ifdef D_RISCV
+   /* stall the hart until an interrupt is pending */
+   #define M_WAIT_FOR_INTERRUPT()              asm volatile ("wfi" : : : "memory")
+   /* read the stack pointer */
+   #define M_READ_STACK_POINTER(var)           asm volatile ("mv %0, sp" : "=r"(var))
+   /* mask/unmask interrupts (mstatus.MIE) - wfi still wakes on a pending one */
+   #define M_DISABLE_INTERRUPTS()              asm volatile ("csrci mstatus, 8" : : : "memory")
+   #define M_ENABLE_INTERRUPTS()               asm volatile ("csrsi mstatus, 8" : : : "memory")
+#elif defined(D_ARM)
+   /* stall the core until an interrupt is pending */
+   #define M_WAIT_FOR_INTERRUPT()              asm volatile ("wfi" : : : "memory")
+   /* read the stack pointer */
+   #define M_READ_STACK_POINTER(var)           asm volatile ("mov %0, sp" : "=r"(var))
+   /* mask/unmask interrupts (PRIMASK) - wfi still wakes on a pending one */
+   #define M_DISABLE_INTERRUPTS()              asm volatile ("cpsid i" : : : "memory")
+   #define M_ENABLE_INTERRUPTS()               asm volatile ("cpsie i" : : : "memory")
+#else
+   #define M_WAIT_FOR_INTERRUPT()
+   #define M_READ_STACK_POINTER(var)           var = __builtin_frame_address(0)
+   #define M_DISABLE_INTERRUPTS()
+   #define M_ENABLE_INTERRUPTS()
 #endif /* D_RISCV */
 #endif /* __INT_LATENCY_H__ */
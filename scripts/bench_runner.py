@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+
+# Embench-RT repeated runs
+#
+# Build each benchmark/variant once, then run it REPS times with JOBS runs
+# in flight - each job owns a GDB port, a jtag_vpi port and, with --sim-cmd,
+# its own simulation instance - and report every metric with its mean and
+# 95% confidence interval.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Run every benchmark/board/variant several times in parallel and aggregate.
+
+Builds are in tree and run one at a time; the ELF and size report of each
+build are kept in OUT/<board>/<test>/<variant>/ and the runs use that copy
+(make run RUN_DIR=...), so all runs of all builds can share the job pool.
+
+--sim-cmd is a format string started once per run; {job}, {vpi_port} and
+{gdb_port} are replaced with the job slot and its ports, e.g.
+
+  --sim-cmd 'fusesoc run --target=sim swervolf --jtag_vpi_enable=1 --jtag_vpi_port={vpi_port}'
+
+OUT/samples.csv has every sample, OUT/summary.csv the statistics and
+OUT/report.txt one table per build.
+"""
+
+import argparse
+import concurrent.futures
+import csv
+import math
+import os
+import queue
+import signal
+import statistics
+import subprocess
+import sys
+import time
+
+import build_matrix
+import gdb_results
+
+ROOT = build_matrix.ROOT
+
+# two-sided 95% Student t quantiles by degrees of freedom
+T_95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+Z_95 = 1.960
+
+
+def t_95(df):
+    """95% two-sided t quantile, normal quantile past the table."""
+    return T_95[df - 1] if df <= len(T_95) else Z_95
+
+
+def summarize(samples):
+    """Statistics of the samples of one metric."""
+    n = len(samples)
+    mean = statistics.fmean(samples)
+    stdev = statistics.stdev(samples) if n > 1 else 0.0
+    ci = t_95(n - 1) * stdev / math.sqrt(n) if n > 1 else 0.0
+    return {
+        'n': n,
+        'mean': mean,
+        'ci95': ci,
+        'stdev': stdev,
+        'cv_percent': 100.0 * stdev / mean if mean else 0.0,
+        'median': statistics.median(samples),
+        'min': min(samples),
+        'max': max(samples),
+    }
+
+
+class Build:
+    """One benchmark built with one variant for one board."""
+
+    def __init__(self, board, test, variant, reps, out):
+        self.board = board
+        self.test = test
+        self.variant = variant
+        self.dir = os.path.join(out, board, test, variant.name)
+        self.reps = reps
+        self.ok = False
+        self.samples = []
+
+    @property
+    def name(self):
+        return f'{self.board}/{self.test}/{self.variant.name}'
+
+
+def build(item):
+    """Clean build, keep the artifacts in the build directory."""
+    os.makedirs(item.dir, exist_ok=True)
+    with open(os.path.join(item.dir, 'build.txt'), 'w') as log:
+        item.ok = build_matrix.build(item.board, item.test, item.variant, log)
+    if item.ok:
+        build_matrix.keep_artifacts(item.test, item.dir)
+    return item.ok
+
+
+def run(item, rep, slot, args):
+    """One run on a job slot, return its flattened results or None."""
+    gdb_port = args.gdb_port + slot
+    vpi_port = args.vpi_port + slot
+    log_path = os.path.join(item.dir, f'run{rep}.txt')
+    with open(log_path, 'w') as log:
+        sim = None
+        if args.sim_cmd:
+            cmd = args.sim_cmd.format(job=slot, vpi_port=vpi_port, gdb_port=gdb_port)
+            log.write(f'$ {cmd}\n')
+            log.flush()
+            sim = subprocess.Popen(cmd, shell=True, cwd=ROOT, stdout=log, stderr=subprocess.STDOUT,
+                                   start_new_session=True)
+            time.sleep(args.sim_wait)
+        try:
+            make_args = [f'BOARD={item.board}', f'TEST={item.test}', f'RUN_DIR={item.dir}',
+                         f'GDB_PORT={gdb_port}', 'run'] + item.variant.make_vars()
+            if not args.hw:
+                make_args += ['SIM=1', f'VPI_PORT={vpi_port}']
+            ok, output = build_matrix.make(make_args, log, timeout=args.timeout)
+        finally:
+            if sim is not None:
+                os.killpg(sim.pid, signal.SIGTERM)
+                sim.wait()
+    if not ok:
+        return None
+    return gdb_results.flatten(gdb_results.parse_output(output))
+
+
+def run_all(builds, args):
+    """All repetitions of all builds, args.jobs at a time."""
+    slots = queue.Queue()
+    for slot in range(args.jobs):
+        slots.put(slot)
+
+    def job(item, rep):
+        slot = slots.get()
+        try:
+            return item, rep, run(item, rep, slot, args)
+        finally:
+            slots.put(slot)
+
+    failed = 0
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        futures = [pool.submit(job, item, rep) for item in builds if item.ok for rep in range(args.reps)]
+        for done, future in enumerate(concurrent.futures.as_completed(futures), 1):
+            item, rep, results = future.result()
+            status = 'ok' if results is not None else 'failed'
+            print(f'> [{done}/{len(futures)}] {item.name} run {rep}: {status}', flush=True)
+            if results is None:
+                failed += 1
+            else:
+                item.samples.append((rep, results))
+    return failed
+
+
+def aggregate(item):
+    """{metric: statistics} over the runs of a build."""
+    values = {}
+    for _, results in sorted(item.samples):
+        for name, value in results.items():
+            values.setdefault(name, []).append(value)
+    return {name: summarize(samples) for name, samples in values.items()}
+
+
+def format_table(item, stats):
+    """Fixed-width table of one build."""
+    lines = [f'{item.name}  ({len(item.samples)}/{item.reps} runs)']
+    if not item.ok:
+        return '\n'.join(lines + ['  no build'])
+    if not stats:
+        return '\n'.join(lines + ['  no results'])
+    width = max(len('metric'), max(len(name) for name in stats)) + 2
+    lines.append(f'  {"metric":<{width}}{"mean":>12}{"+/-ci95":>10}{"cv%":>7}{"median":>10}{"min":>10}{"max":>10}')
+    for name, stat in stats.items():
+        lines.append(f'  {name:<{width}}{stat["mean"]:>12.1f}{stat["ci95"]:>10.1f}{stat["cv_percent"]:>7.2f}'
+                     f'{stat["median"]:>10g}{stat["min"]:>10}{stat["max"]:>10}')
+    return '\n'.join(lines)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Run the benchmarks repeatedly in parallel and aggregate')
+    parser.add_argument('--boards', nargs='+', default=['EH1'], choices=sorted(build_matrix.BOARD_TESTS))
+    parser.add_argument('--tests', nargs='+', help='benchmarks (default: all of each board)')
+    parser.add_argument('--toolchains', nargs='+', default=['gcc'], choices=build_matrix.TOOLCHAINS)
+    parser.add_argument('--opts', nargs='+', default=['s'], help='optimization levels (0 s 2 3 ...)')
+    parser.add_argument('--lto', nargs='+', type=int, default=[0], choices=[0, 1])
+    parser.add_argument('--save-restore', nargs='+', type=int, default=[0], choices=[0, 1])
+    parser.add_argument('--psp-save', nargs='+', default=['ldst'], choices=build_matrix.PSP_SAVES)
+    parser.add_argument('--reps', type=int, default=5, help='runs per build')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count() or 1, help='runs in flight')
+    parser.add_argument('--out', default='runs', help='output directory')
+    parser.add_argument('--sim-cmd', help='command starting one simulation - {job} {vpi_port} {gdb_port}')
+    parser.add_argument('--sim-wait', type=float, default=5, help='seconds to let the simulation start')
+    parser.add_argument('--gdb-port', type=int, default=3333, help='gdb port of job 0, job n uses +n')
+    parser.add_argument('--vpi-port', type=int, default=5555, help='jtag_vpi port of job 0, job n uses +n')
+    parser.add_argument('--hw', action='store_true', help='run on the board - forces a single job')
+    parser.add_argument('--timeout', type=float, default=600, help='seconds per run')
+    args = parser.parse_args()
+    if args.hw:
+        args.jobs = 1
+    if args.reps < 1 or args.jobs < 1:
+        parser.error('--reps and --jobs must be positive')
+    return args
+
+
+def main():
+    args = parse_args()
+    out = os.path.abspath(args.out)
+    matrix = build_matrix.variants(args.toolchains, args.opts, args.lto, args.save_restore,
+                                   args.psp_save)
+
+    builds = []
+    for board in args.boards:
+        tests = [test for test in (args.tests or build_matrix.BOARD_TESTS[board])
+                 if test in build_matrix.BOARD_TESTS[board]]
+        for test in tests:
+            for variant in build_matrix.board_variants(board, matrix):
+                item = Build(board, test, variant, args.reps, out)
+                print(f'> build {item.name} ...', flush=True)
+                if not build(item):
+                    print(f'> build {item.name}: failed', flush=True)
+                builds.append(item)
+
+    started = time.time()
+    failed = run_all(builds, args)
+    elapsed = time.time() - started
+
+    report = []
+    with open(os.path.join(out, 'samples.csv'), 'w', newline='') as samples_file, \
+            open(os.path.join(out, 'summary.csv'), 'w', newline='') as summary_file:
+        samples = csv.writer(samples_file)
+        samples.writerow(['board', 'test', 'variant', 'rep', 'metric', 'value'])
+        summary = csv.writer(summary_file)
+        fields = ['n', 'mean', 'ci95', 'stdev', 'cv_percent', 'median', 'min', 'max']
+        summary.writerow(['board', 'test', 'variant', 'metric'] + fields)
+        for item in builds:
+            key = [item.board, item.test, item.variant.name]
+            for rep, results in sorted(item.samples):
+                for name, value in results.items():
+                    samples.writerow(key + [rep, name, value])
+            stats = aggregate(item)
+            for name, stat in stats.items():
+                summary.writerow(key + [name] + [stat[field] for field in fields])
+            report.append(format_table(item, stats))
+
+    runs = sum(args.reps for item in builds if item.ok)
+    header = (f'{runs} runs, {failed} failed, {args.jobs} jobs, {elapsed:.0f} s\n'
+              f'mean +/- 95% confidence interval of the mean (Student t), cv - coefficient of variation\n')
+    text = header + '\n' + '\n\n'.join(report) + '\n'
+    with open(os.path.join(out, 'report.txt'), 'w') as report_file:
+        report_file.write(text)
+    print(text)
+    return 1 if failed or not all(item.ok for item in builds) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
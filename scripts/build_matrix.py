@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+
+# Embench-RT build matrix
+#
+# Build every benchmark of a board with each compiler, optimization level,
+# LTO, -msave-restore and port register save variant, run each build ('make run', by default
+# on the board simulation) and write one table comparing cycles and code
+# size across the variants.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Build, run and compare all toolchain/optimization variants of the benchmarks.
+
+Each variant is built in tree (make clean first), so variants run one at a
+time. Per variant the ELF, map, size report and run log are kept in
+OUT/<test>/<variant>/; OUT/report.txt holds the comparison tables and
+OUT/results.csv every metric of every variant.
+"""
+
+import argparse
+import csv
+import itertools
+import os
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import time
+
+import gdb_results
+import size_report
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# benchmarks each board can build
+BOARD_TESTS = {
+    'EH1': ['irq_latency', 'ctx_switch_os'],
+    'X300': ['ctx_switch'],
+    'VIRT': ['irq_latency', 'ctx_switch_os'],
+    'MPS2_AN385': ['irq_latency', 'ctx_switch_os'],
+    'MPS2_AN505': ['irq_latency', 'ctx_switch_os'],
+}
+
+# Cortex-M boards - no -msave-restore, no PSP_SAVE
+ARM_BOARDS = {'MPS2_AN385', 'MPS2_AN505'}
+
+TOOLCHAINS = ['gcc', 'clang']
+# optimization levels - -O<level>
+OPTS = ['0', 's', '2', '3']
+# register save of the ports - PSP_SAVE
+PSP_SAVES = ['ldst', 'zcmp', 'millicode']
+
+# results shown in the comparison table, the csv has all of them
+TABLE_METRICS = {
+    'ctx_switch': [r'^emBench - result$'],
+    'irq_latency': [r'^cycles from', r'\.cycles_between_entries$'],
+    'ctx_switch_os': [r'cycles$', r'\.avg_cycles$', r'^task churn\.cycles_per_task$'],
+}
+
+SIZE_COLUMNS = ['text', 'rodata', 'data', 'bss']
+
+
+class Variant:
+    """A single build configuration."""
+
+    def __init__(self, toolchain, opt, lto, save_restore, psp_save='ldst'):
+        self.toolchain = toolchain
+        self.opt = opt
+        self.lto = lto
+        self.save_restore = save_restore
+        self.psp_save = psp_save
+
+    @property
+    def name(self):
+        name = f'{self.toolchain}-O{self.opt}'
+        if self.lto:
+            name += '-lto'
+        if self.save_restore:
+            name += '-sr'
+        if self.psp_save != 'ldst':
+            name += f'-{self.psp_save}'
+        return name
+
+    def make_vars(self):
+        make_vars = [f'TOOLCHAIN={self.toolchain}', f'OPT=-O{self.opt}',
+                f'LTO={int(self.lto)}', f'SAVE_RESTORE={int(self.save_restore)}',
+                f'PSP_SAVE={self.psp_save}']
+        # Zcmp is rv32 only - selects rv32 on QEMU virt
+        if self.psp_save == 'zcmp':
+            make_vars.append('XLEN=32')
+        return make_vars
+
+
+def variants(toolchains, opts, lto, save_restore, psp_saves=('ldst',)):
+    """All combinations of the requested options."""
+    return [Variant(*combination)
+            for combination in itertools.product(toolchains, opts, lto, save_restore, psp_saves)]
+
+
+def board_variants(board, matrix):
+    """The variants a board can build."""
+    if board in ARM_BOARDS:
+        return [variant for variant in matrix if not variant.save_restore and variant.psp_save == 'ldst']
+    return matrix
+
+
+def make(args, log, timeout=None):
+    """Run make in the repository root, append its output to log."""
+    cmd = ['make', '--no-print-directory'] + args
+    log.write(f'$ {" ".join(cmd)}\n')
+    log.flush()
+    try:
+        proc = subprocess.run(cmd, cwd=ROOT, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                              universal_newlines=True, timeout=timeout)
+    except subprocess.TimeoutExpired as err:
+        log.write(f'timeout after {err.timeout} seconds\n')
+        return False, ''
+    log.write(proc.stdout)
+    return proc.returncode == 0, proc.stdout
+
+
+def build(board, test, variant, log):
+    """Clean build of one benchmark."""
+    make([f'BOARD={board}', 'clean'], log)
+    ok, _ = make([f'BOARD={board}', test] + variant.make_vars(), log)
+    return ok
+
+
+def run(board, test, variant, args, log):
+    """Run one benchmark, return its results or None."""
+    sim = None
+    if args.sim_cmd:
+        log.write(f'$ {args.sim_cmd}\n')
+        log.flush()
+        sim = subprocess.Popen(args.sim_cmd, shell=True, cwd=ROOT, stdout=log, stderr=subprocess.STDOUT,
+                               start_new_session=True)
+        time.sleep(args.sim_wait)
+    try:
+        make_args = [f'BOARD={board}', f'TEST={test}', 'run'] + variant.make_vars()
+        if not args.hw:
+            make_args.append('SIM=1')
+        ok, output = make(make_args, log, timeout=args.timeout)
+    finally:
+        if sim is not None:
+            os.killpg(sim.pid, signal.SIGTERM)
+            sim.wait()
+    if not ok:
+        return None
+    return gdb_results.flatten(gdb_results.parse_output(output))
+
+
+def keep_artifacts(test, out_dir):
+    """Copy the build outputs of a benchmark to out_dir."""
+    for ext in ('elf', 'map', 'size'):
+        path = os.path.join(ROOT, test, f'{test}.{ext}')
+        if os.path.exists(path):
+            shutil.copy(path, out_dir)
+
+
+def table_metrics(test, rows):
+    """Metrics of a benchmark shown in the table, in print order."""
+    patterns = [re.compile(pattern) for pattern in TABLE_METRICS.get(test, [r'.'])]
+    names = []
+    for row in rows:
+        for name in row['results']:
+            if name not in names and any(pattern.search(name) for pattern in patterns):
+                names.append(name)
+    return names
+
+
+def format_table(test, rows):
+    """Fixed-width table of one benchmark, variants as rows, '*' marks the best."""
+    metrics = table_metrics(test, rows)
+    columns = SIZE_COLUMNS + [f'M{index + 1}' for index in range(len(metrics))]
+    values = []
+    for row in rows:
+        line = [row['size'].get(col) for col in SIZE_COLUMNS]
+        line += [row['results'].get(metric) for metric in metrics]
+        values.append(line)
+
+    best = []
+    for index in range(len(columns)):
+        column = [line[index] for line in values if line[index] is not None]
+        best.append(min(column) if column else None)
+
+    width = max([len('variant')] + [len(row['variant']) for row in rows]) + 2
+    lines = [f'{test}', '', f'{"variant":<{width}}{"status":<10}' + ''.join(f'{col:>10}' for col in columns)]
+    for row, line in zip(rows, values):
+        cells = []
+        for index, value in enumerate(line):
+            if value is None:
+                cells.append(f'{"-":>10}')
+            else:
+                mark = '*' if value == best[index] and len(rows) > 1 else ' '
+                cells.append(f'{value:>9}{mark}')
+        lines.append(f'{row["variant"]:<{width}}{row["status"]:<10}' + ''.join(cells))
+    lines.append('')
+    lines.append('size in bytes (all components), M<n> in cpu cycles, * - lowest')
+    for index, metric in enumerate(metrics):
+        lines.append(f'  M{index + 1}: {metric}')
+    return '\n'.join(lines)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Build and run the benchmarks with every toolchain variant')
+    parser.add_argument('--board', default='EH1', choices=sorted(BOARD_TESTS))
+    parser.add_argument('--tests', nargs='+', help='benchmarks (default: all of the board)')
+    parser.add_argument('--toolchains', nargs='+', default=TOOLCHAINS, choices=TOOLCHAINS)
+    parser.add_argument('--opts', nargs='+', default=OPTS, help='optimization levels (0 s 2 3 ...)')
+    parser.add_argument('--lto', nargs='+', type=int, default=[0, 1], choices=[0, 1])
+    parser.add_argument('--save-restore', nargs='+', type=int, default=[0, 1], choices=[0, 1])
+    parser.add_argument('--psp-save', nargs='+', default=['ldst'], choices=PSP_SAVES,
+                        help='port register save (zcmp builds rv32 - runs on VIRT only)')
+    parser.add_argument('--out', default='matrix', help='output directory')
+    parser.add_argument('--sim-cmd', help='command starting the board simulation for each run')
+    parser.add_argument('--sim-wait', type=float, default=5, help='seconds to let the simulation start')
+    parser.add_argument('--hw', action='store_true', help='run on the board instead of the simulation')
+    parser.add_argument('--no-run', action='store_true', help='build only - compare code size')
+    parser.add_argument('--timeout', type=float, default=600, help='seconds per run')
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    tests = args.tests or BOARD_TESTS[args.board]
+    out = os.path.abspath(args.out)
+    matrix = board_variants(args.board, variants(args.toolchains, args.opts, args.lto, args.save_restore,
+                                                        args.psp_save))
+
+    report = []
+    with open(os.path.join(_mkdir(out), 'results.csv'), 'w', newline='') as csv_file:
+        writer = csv.writer(csv_file)
+        writer.writerow(['board', 'test', 'variant', 'metric', 'value'])
+        for test in tests:
+            rows = []
+            for variant in matrix:
+                out_dir = _mkdir(os.path.join(out, test, variant.name))
+                print(f'> {test}: {variant.name} ...', flush=True)
+                row = {'variant': variant.name, 'status': 'ok', 'size': {}, 'results': {}}
+                with open(os.path.join(out_dir, 'log.txt'), 'w') as log:
+                    if not build(args.board, test, variant, log):
+                        row['status'] = 'no build'
+                    else:
+                        keep_artifacts(test, out_dir)
+                        row['size'] = size_report.read_report(os.path.join(out_dir, f'{test}.size')).get('total', {})
+                        if not args.no_run:
+                            results = run(args.board, test, variant, args, log)
+                            if results is None:
+                                row['status'] = 'no run'
+                            else:
+                                row['results'] = results
+                                if any(value for name, value in results.items() if 'errors' in name):
+                                    row['status'] = 'errors'
+                for name, value in row['size'].items():
+                    writer.writerow([args.board, test, variant.name, f'size.{name}', value])
+                for name, value in row['results'].items():
+                    writer.writerow([args.board, test, variant.name, name, value])
+                rows.append(row)
+            report.append(format_table(test, rows))
+
+    text = f'board {args.board}\n\n' + '\n\n'.join(report) + '\n'
+    with open(os.path.join(out, 'report.txt'), 'w') as report_file:
+        report_file.write(text)
+    print(text)
+    return 0
+
+
+def _mkdir(path):
+    os.makedirs(path, exist_ok=True)
+    return path
+
+
+if __name__ == '__main__':
+    sys.exit(main())
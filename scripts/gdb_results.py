@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+
+# Embench-RT GDB results parser
+#
+# 'make run' prints each result as a label line followed by the GDB value:
+#
+#   > ctx_switch_os: event_set cycles ...
+#   $1 = 212
+#   > ctx_switch_os: task_create cycles ...
+#   $2 = {min_cycles = 180, max_cycles = 196, avg_cycles = 184}
+#
+# This module turns that output into {label: value} and flattens nested
+# values into scalar metrics for tables and comparisons.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Parse the results printed by the GDB run commands of the top level Makefile.
+"""
+
+import re
+import sys
+
+LABEL = re.compile(r'^> (?:(\w+): )?(.*?)\s*(?:\.\.\.)?\s*$')
+VALUE = re.compile(r'^\$\d+ = (.*)$')
+# 'info registers' output, possibly on the label line (emBench - result : ...)
+REGISTER = re.compile(r'(\w+)\s+0x[0-9a-fA-F]+\s+(-?\d+)\s*$')
+# labels that carry no result
+NO_RESULT = re.compile(r'(running|complete|Done)$')
+
+TOKEN = re.compile(r'\s*(<repeats (\d+) times>|[{}=,]|-?0x[0-9a-fA-F]+|-?\d+|\'(?:\\.|[^\'])*\'|"(?:\\.|[^"])*"|[\w.]+)')
+
+
+class ParseError(ValueError):
+    """Malformed GDB value."""
+
+
+def _tokenize(text):
+    tokens = []
+    pos = 0
+    text = text.rstrip()
+    while pos < len(text):
+        match = TOKEN.match(text, pos)
+        if not match:
+            raise ParseError(f'unexpected "{text[pos:pos + 16]}"')
+        tokens.append(match.group(1))
+        pos = match.end()
+    return tokens
+
+
+def _number(token):
+    return int(token, 16) if token.lstrip('-').startswith('0x') else int(token)
+
+
+def _parse_value(tokens, pos):
+    """Parse a value at tokens[pos], return (value, next position)."""
+    token = tokens[pos]
+    if token == '{':
+        return _parse_aggregate(tokens, pos + 1)
+    if re.match(r'-?(0x)?[0-9a-fA-F]+$', token):
+        value = _number(token)
+        pos += 1
+        # chars print as 65 'A'
+        if pos < len(tokens) and tokens[pos].startswith("'"):
+            pos += 1
+        return value, pos
+    # enums, strings, symbols - kept as text
+    return token, pos + 1
+
+
+def _parse_aggregate(tokens, pos):
+    """Parse a struct or array body after '{'."""
+    fields = {}
+    items = []
+    while tokens[pos] != '}':
+        if pos + 1 < len(tokens) and tokens[pos + 1] == '=':
+            name = tokens[pos]
+            value, pos = _parse_value(tokens, pos + 2)
+            fields[name] = value
+        else:
+            value, pos = _parse_value(tokens, pos)
+            count = 1
+            if pos < len(tokens) and tokens[pos].startswith('<repeats'):
+                count = int(re.search(r'\d+', tokens[pos]).group(0))
+                pos += 1
+            items.extend([value] * count)
+        if tokens[pos] == ',':
+            pos += 1
+    if fields and items:
+        raise ParseError('mixed struct and array')
+    return (fields if fields else items), pos + 1
+
+
+def parse_value(text):
+    """Parse a GDB print value into int, str, list or dict."""
+    tokens = _tokenize(text)
+    if not tokens:
+        raise ParseError('empty value')
+    value, pos = _parse_value(tokens, 0)
+    if pos != len(tokens):
+        raise ParseError(f'trailing "{" ".join(tokens[pos:])}"')
+    return value
+
+
+def parse_output(text):
+    """Return {label: value} from the output of 'make run', in print order."""
+    results = {}
+    label = None
+    for line in text.splitlines():
+        line = line.rstrip('\r')
+        if line.startswith('> '):
+            match = LABEL.match(line)
+            label = match.group(2) if match else line[2:]
+            # the value may follow the label on the same line
+            register = REGISTER.search(line)
+            if ' : ' in label and register:
+                label = label.split(' : ')[0].strip()
+                results[label] = int(register.group(2))
+                label = None
+            elif NO_RESULT.search(label):
+                label = None
+            continue
+        if label is None:
+            continue
+        match = VALUE.match(line)
+        if match:
+            try:
+                results[label] = parse_value(match.group(1))
+            except (ParseError, IndexError):
+                results[label] = match.group(1)
+            label = None
+            continue
+        register = REGISTER.match(line)
+        if register:
+            results[label] = int(register.group(2))
+            label = None
+    return results
+
+
+def flatten(results):
+    """Flatten nested values to {'label/path': number}; text values are dropped."""
+    flat = {}
+
+    def walk(prefix, value):
+        if isinstance(value, dict):
+            for name, item in value.items():
+                walk(f'{prefix}.{name}', item)
+        elif isinstance(value, list):
+            for index, item in enumerate(value):
+                walk(f'{prefix}[{index}]', item)
+        elif isinstance(value, int):
+            flat[prefix] = value
+
+    for label, value in results.items():
+        walk(label, value)
+    return flat
+
+
+def main():
+    text = open(sys.argv[1]).read() if len(sys.argv) > 1 else sys.stdin.read()
+    for name, value in flatten(parse_output(text)).items():
+        print(f'{name} = {value}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
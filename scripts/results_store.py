@@ -0,0 +1,337 @@
+#!/usr/bin/env python3
+
+# Embench-RT results store and regression check
+#
+# Keep the samples of repeated runs (scripts/bench_runner.py) per git
+# revision and compare two result sets metric by metric with a Mann-Whitney
+# U test, failing when a metric got significantly worse by more than a
+# threshold.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Store benchmark samples by revision and compare two result sets.
+
+Layout of the store:
+
+  STORE/<rev>/info.txt                         revision, date, toolchain versions
+  STORE/<rev>/<board>/<test>/<variant>.csv     rep,metric,value
+
+The variant name carries the toolchain and its options (gcc-Os-lto, ...).
+A result set given to 'compare' is either a stored revision or the output
+directory of bench_runner.py.
+
+  results_store.py store runs              store runs/samples.csv under HEAD
+  results_store.py list
+  results_store.py compare <base> <new>    exit 1 on a regression
+"""
+
+import argparse
+import csv
+import datetime
+import itertools
+import math
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# metrics where a larger value is better - everything else is a cost
+HIGHER_IS_BETTER = re.compile(r'(per_sec|per_kcycle|_percent|iterations)$')
+# error counters - any increase is a failure
+ERRORS = re.compile(r'errors')
+# above this many orderings the U distribution is approximated
+EXACT_LIMIT = 20000
+
+
+def git(*args):
+    return subprocess.run(['git'] + list(args), cwd=ROOT, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                          universal_newlines=True).stdout.strip()
+
+
+def current_rev():
+    """Short HEAD revision, '-dirty' with uncommitted changes to tracked files."""
+    rev = git('rev-parse', '--short', 'HEAD') or 'unknown'
+    if subprocess.run(['git', 'diff', '--quiet', 'HEAD'], cwd=ROOT).returncode != 0:
+        rev += '-dirty'
+    return rev
+
+
+def toolchain_versions():
+    """First version line of the compilers in the environment."""
+    versions = []
+    tools = []
+    if os.environ.get('RISCV'):
+        tools.append(os.path.join(os.environ['RISCV'], 'bin', 'riscv64-unknown-elf-gcc'))
+    if os.environ.get('LLVM'):
+        tools.append(os.path.join(os.environ['LLVM'], 'bin', 'clang'))
+    for tool in tools:
+        try:
+            output = subprocess.run([tool, '--version'], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                                    universal_newlines=True).stdout
+        except OSError:
+            continue
+        if output:
+            versions.append(output.splitlines()[0])
+    return versions
+
+
+#############################################################
+# Result sets - {(board, test, variant, metric): [samples]}
+#############################################################
+
+def read_runs(path):
+    """Samples of a bench_runner output directory."""
+    samples = {}
+    with open(os.path.join(path, 'samples.csv'), newline='') as csv_file:
+        for row in csv.DictReader(csv_file):
+            key = (row['board'], row['test'], row['variant'], row['metric'])
+            samples.setdefault(key, []).append(float(row['value']))
+    return samples
+
+
+def read_stored(path):
+    """Samples of a stored revision."""
+    samples = {}
+    for board in sorted(os.listdir(path)):
+        board_dir = os.path.join(path, board)
+        if not os.path.isdir(board_dir):
+            continue
+        for test in sorted(os.listdir(board_dir)):
+            for name in sorted(os.listdir(os.path.join(board_dir, test))):
+                if not name.endswith('.csv'):
+                    continue
+                with open(os.path.join(board_dir, test, name), newline='') as csv_file:
+                    for row in csv.DictReader(csv_file):
+                        key = (board, test, name[:-4], row['metric'])
+                        samples.setdefault(key, []).append(float(row['value']))
+    return samples
+
+
+def read_set(store, name):
+    """A result set by stored revision or runs directory."""
+    if os.path.isfile(os.path.join(name, 'samples.csv')):
+        return read_runs(name)
+    matches = [rev for rev in list_revs(store) if rev == name or rev.startswith(name)]
+    if len(matches) != 1:
+        sys.stderr.write(f'error: {name}: ' + ('ambiguous revision\n' if matches else 'no such revision or runs directory\n'))
+        sys.exit(2)
+    return read_stored(os.path.join(store, matches[0]))
+
+
+def list_revs(store):
+    if not os.path.isdir(store):
+        return []
+    return sorted(rev for rev in os.listdir(store) if os.path.isfile(os.path.join(store, rev, 'info.txt')))
+
+
+#############################################################
+# Mann-Whitney U test
+#############################################################
+
+def _ranks(values):
+    """Mid-ranks of values (1-based), ties share their average rank."""
+    order = sorted(range(len(values)), key=lambda index: values[index])
+    ranks = [0.0] * len(values)
+    start = 0
+    while start < len(order):
+        end = start
+        while end + 1 < len(order) and values[order[end + 1]] == values[order[start]]:
+            end += 1
+        for index in order[start:end + 1]:
+            ranks[index] = (start + end) / 2 + 1
+        start = end + 1
+    return ranks
+
+
+def _exact_p(u, n1, n2):
+    """Two-sided p of U by counting the orderings - no ties."""
+    # counts[k] - orderings of n1 x's among n2 y's with U == k, by dynamic programming
+    counts = {(0, 0): [1]}
+
+    def table(i, j):
+        if (i, j) in counts:
+            return counts[(i, j)]
+        result = [0] * (i * j + 1)
+        if i > 0:
+            for k, count in enumerate(table(i - 1, j)):
+                result[k + j] += count
+        if j > 0:
+            for k, count in enumerate(table(i, j - 1)):
+                result[k] += count
+        counts[(i, j)] = result
+        return result
+
+    dist = table(n1, n2)
+    total = sum(dist)
+    low = min(u, n1 * n2 - u)
+    tail = sum(dist[:int(math.floor(low)) + 1])
+    return min(1.0, 2.0 * tail / total)
+
+
+def mann_whitney(x, y):
+    """Two-sided Mann-Whitney U test, return (U of x, p)."""
+    n1, n2 = len(x), len(y)
+    ranks = _ranks(list(x) + list(y))
+    u = sum(ranks[:n1]) - n1 * (n1 + 1) / 2
+    combined = sorted(list(x) + list(y))
+    ties = [len(list(group)) for _, group in itertools.groupby(combined)]
+    if all(count == 1 for count in ties) and math.comb(n1 + n2, n1) <= EXACT_LIMIT:
+        return u, _exact_p(u, n1, n2)
+    n = n1 + n2
+    tie_term = sum(count ** 3 - count for count in ties) / (n * (n - 1))
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term)
+    if variance <= 0:
+        return u, 1.0
+    z = (abs(u - n1 * n2 / 2.0) - 0.5) / math.sqrt(variance)
+    return u, min(1.0, math.erfc(max(z, 0.0) / math.sqrt(2)))
+
+
+#############################################################
+# Comparison
+#############################################################
+
+def median(values):
+    values = sorted(values)
+    middle = len(values) // 2
+    return values[middle] if len(values) % 2 else (values[middle - 1] + values[middle]) / 2
+
+
+def compare_metric(metric, base, new, threshold, alpha):
+    """Verdict of one metric: 'regression', 'improvement' or ''."""
+    base_median, new_median = median(base), median(new)
+    if base_median:
+        change = 100.0 * (new_median - base_median) / abs(base_median)
+    else:
+        change = 0.0 if new_median == base_median else math.copysign(math.inf, new_median - base_median)
+    _, p = mann_whitney(base, new)
+
+    if ERRORS.search(metric):
+        return change, p, 'regression' if new_median > base_median else ''
+
+    worse = -change if HIGHER_IS_BETTER.search(metric) else change
+    # deterministic runs (a simulation) - every sample equal, no test needed
+    significant = p < alpha or (len(set(base)) == 1 and len(set(new)) == 1 and base_median != new_median)
+    if significant and worse > threshold:
+        return change, p, 'regression'
+    if significant and worse < -threshold:
+        return change, p, 'improvement'
+    return change, p, ''
+
+
+def compare(base, new, threshold, alpha, pattern, show_all):
+    """Comparison table lines and the number of regressions."""
+    keys = [key for key in base if key in new and pattern.search(key[3])]
+    lines = []
+    regressions = improvements = 0
+    width = max([len('metric')] + [len(key[3]) for key in keys]) + 2
+    current = None
+    for key in keys:
+        change, p, verdict = compare_metric(key[3], base[key], new[key], threshold, alpha)
+        regressions += verdict == 'regression'
+        improvements += verdict == 'improvement'
+        if not verdict and not show_all:
+            continue
+        if key[:3] != current:
+            current = key[:3]
+            lines += ['', '/'.join(current),
+                      f'  {"metric":<{width}}{"base":>12}{"new":>12}{"change%":>10}{"p":>9}  verdict']
+        lines.append(f'  {key[3]:<{width}}{median(base[key]):>12g}{median(new[key]):>12g}'
+                     f'{change:>+10.2f}{p:>9.4f}  {verdict}')
+    only_base = len([key for key in base if key not in new and pattern.search(key[3])])
+    only_new = len([key for key in new if key not in base and pattern.search(key[3])])
+    summary = [f'{len(keys)} metrics compared, {regressions} regressions, {improvements} improvements',
+               f'medians, change of the median, two-sided Mann-Whitney p; '
+               f'significant (p < {alpha}) and worse by more than {threshold}% is a regression']
+    if only_base or only_new:
+        summary.append(f'{only_base} metrics only in base, {only_new} only in new - not compared')
+    return summary + lines, regressions
+
+
+#############################################################
+# Commands
+#############################################################
+
+def cmd_store(args):
+    samples = read_runs(args.runs)
+    rev = args.rev or current_rev()
+    rev_dir = os.path.join(args.store, rev)
+    if os.path.isdir(rev_dir):
+        shutil.rmtree(rev_dir)
+    files = {}
+    with open(os.path.join(args.runs, 'samples.csv'), newline='') as csv_file:
+        for row in csv.DictReader(csv_file):
+            key = (row['board'], row['test'], row['variant'])
+            if key not in files:
+                path = os.path.join(rev_dir, *key[:2], f'{key[2]}.csv')
+                os.makedirs(os.path.dirname(path), exist_ok=True)
+                files[key] = open(path, 'w', newline='')
+                csv.writer(files[key]).writerow(['rep', 'metric', 'value'])
+            csv.writer(files[key]).writerow([row['rep'], row['metric'], row['value']])
+    for csv_file in files.values():
+        csv_file.close()
+    with open(os.path.join(rev_dir, 'info.txt'), 'w') as info:
+        info.write(f'rev {rev}\n')
+        info.write(f'commit {git("rev-parse", "HEAD")}\n')
+        info.write(f'subject {git("log", "-1", "--format=%s")}\n')
+        info.write(f'date {datetime.datetime.now().isoformat(timespec="seconds")}\n')
+        for version in toolchain_versions():
+            info.write(f'toolchain {version}\n')
+    print(f'stored {len(samples)} metrics of {len(files)} builds as {rev}')
+    return 0
+
+
+def cmd_list(args):
+    for rev in list_revs(args.store):
+        info = {}
+        with open(os.path.join(args.store, rev, 'info.txt')) as info_file:
+            for line in info_file:
+                name, _, value = line.rstrip('\n').partition(' ')
+                info.setdefault(name, value)
+        print(f'{rev:<20}{info.get("date", ""):<22}{info.get("subject", "")}')
+    return 0
+
+
+def cmd_compare(args):
+    base = read_set(args.store, args.base)
+    new = read_set(args.store, args.new)
+    lines, regressions = compare(base, new, args.threshold, args.alpha, re.compile(args.metrics), args.all)
+    print(f'base {args.base}, new {args.new}')
+    print('\n'.join(lines))
+    return 1 if regressions else 0
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Store benchmark results by revision and compare them')
+    parser.add_argument('--store', default=os.path.join(ROOT, 'results'), help='results store directory')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    store = commands.add_parser('store', help='store the samples of a bench_runner.py output directory')
+    store.add_argument('runs', help='bench_runner.py output directory')
+    store.add_argument('--rev', help='revision name (default: git HEAD, -dirty if modified)')
+    store.set_defaults(func=cmd_store)
+
+    list_cmd = commands.add_parser('list', help='list the stored revisions')
+    list_cmd.set_defaults(func=cmd_list)
+
+    comp = commands.add_parser('compare', help='compare two result sets, exit 1 on a regression')
+    comp.add_argument('base', help='stored revision (or prefix) or runs directory')
+    comp.add_argument('new', help='stored revision (or prefix) or runs directory')
+    comp.add_argument('--threshold', type=float, default=2.0, help='regression threshold in percent')
+    comp.add_argument('--alpha', type=float, default=0.05, help='significance level')
+    comp.add_argument('--metrics', default='.', help='regex of the metrics to compare')
+    comp.add_argument('--all', action='store_true', help='show unchanged metrics as well')
+    comp.set_defaults(func=cmd_compare)
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+
+# Embench-RT score
+#
+# Normalize every performance metric of a candidate result set against a
+# reference platform and combine the ratios with geometric means, per
+# category and overall, in the way Embench scores its suite.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Score a result set against a reference result set.
+
+Both sets are a stored revision or a bench_runner.py output directory
+(see results_store.py). Each set is narrowed to one board and variant;
+the metrics of the two are matched by benchmark and name.
+
+Every matched metric becomes a ratio - reference median / candidate median
+for costs, the inverse for metrics where more is better - so 1.0 is the
+reference and larger is better. A category score is the geometric mean of
+its ratios and the overall score the geometric mean of the category scores,
+so a category with many metrics does not outweigh one with few.
+
+The cycle counts of QEMU mps2 are SysTick counts at the board clock, not
+instructions as on QEMU virt; they are scaled to instructions (COUNT_SCALE)
+so boards compare the same way.
+
+Spread is given two ways:
+  metrics - geometric standard deviation of the ratios of a category
+  reps    - range and geometric standard deviation of the score computed
+            from repetition i of every metric (median of the reference); a
+            repetition with a zero sample in any metric is left out
+
+The breakdown lists each ratio with its effect on the overall score, the
+factor by which the overall score changes because of that metric alone,
+so a score change can be traced to the metrics behind it.
+"""
+
+import argparse
+import csv
+import math
+import os
+import re
+import sys
+
+import results_store
+
+# categories - first match of 'test:metric' wins, the table order is the
+# report order; metrics matching no category are not scored
+CATEGORIES = [
+    ('irq_latency', re.compile(r'^irq_latency:cycles from')),
+    ('irq_throughput', re.compile(r'^irq_latency:(back to back|external interrupt dispatch|background loop)')),
+    ('jitter', re.compile(r'interrupts masked|\.jitter_cycles$')),
+    ('context_switch', re.compile(r'^ctx_switch:|^ctx_switch_os:(yield cycles|syscall task_yield|pmp - |'
+                                  r'task first dispatch)')),
+    ('crypto', re.compile(r'cycles_per_byte')),
+    ('primitives', re.compile(r'^ctx_switch_os:')),
+]
+
+# performance metrics - cycle counts and rates
+PERFORMANCE = re.compile(r'cycle|emBench - result')
+# benchmark parameters and counts that only describe a result
+NOT_PERFORMANCE = re.compile(r'(period_cycles|total_cycles|histogram|num_of_\w+|errors|stack)')
+HIGHER_IS_BETTER = results_store.HIGHER_IS_BETTER
+
+# instructions per count of the cycle counter - QEMU mps2 counts SysTick at
+# the 25/20MHz sysclk (40/50ns) and runs an instruction every 32ns
+# (-icount shift=5); VIRT counts an instruction, the other boards a cycle
+COUNT_SCALE = {'MPS2_AN385': 40 / 32, 'MPS2_AN505': 50 / 32}
+# metrics in counts and per count of the cycle counter
+COUNTS = re.compile(r'cycle')
+PER_COUNT = re.compile(r'per_kcycle$')
+
+
+def derive_jitter(samples):
+    """Add max_cycles - min_cycles of every aggregate that has both."""
+    derived = {}
+    for key, values in samples.items():
+        if not key[3].endswith('.max_cycles'):
+            continue
+        prefix = key[3][:-len('.max_cycles')]
+        low = samples.get(key[:3] + (prefix + '.min_cycles',))
+        if low and len(low) == len(values):
+            derived[key[:3] + (prefix + '.jitter_cycles',)] = [high - min_ for high, min_ in zip(values, low)]
+    samples.update(derived)
+    return samples
+
+
+def select(samples, board, variant, what):
+    """{(test, metric): samples} of one board and variant of a result set."""
+    builds = sorted({key[:3:2] for key in samples})
+    boards = sorted({key[0] for key in samples})
+    variants = sorted({key[2] for key in samples if board is None or key[0] == board})
+    if board is None:
+        if len(boards) != 1:
+            sys.exit(f'error: {what}: several boards ({" ".join(boards)}) - choose one')
+        board = boards[0]
+    if variant is None:
+        if len(variants) != 1:
+            sys.exit(f'error: {what}: several variants ({" ".join(variants)}) - choose one')
+        variant = variants[0]
+    selected = {(key[1], key[3]): values for key, values in samples.items() if key[0] == board and key[2] == variant}
+    if not selected:
+        sys.exit(f'error: {what}: no results of {board}/{variant} ({len(builds)} builds in the set)')
+    return board, variant, selected
+
+
+def scale_counts(samples, board):
+    """The cycle counts of a board in instructions, see COUNT_SCALE."""
+    scale = COUNT_SCALE.get(board, 1.0)
+    scaled = {}
+    for key, values in samples.items():
+        factor = 1.0 / scale if PER_COUNT.search(key[1]) else scale if COUNTS.search(key[1]) else 1.0
+        scaled[key] = [value * factor for value in values]
+    return scaled
+
+
+def category(test, metric):
+    name = f'{test}:{metric}'
+    if not PERFORMANCE.search(metric) and not HIGHER_IS_BETTER.search(metric):
+        return None
+    if NOT_PERFORMANCE.search(metric):
+        return None
+    for category_name, pattern in CATEGORIES:
+        if pattern.search(name):
+            return category_name
+    return None
+
+
+def ratio(metric, reference, candidate):
+    """Normalized score of a value, larger is better."""
+    if HIGHER_IS_BETTER.search(metric):
+        return candidate / reference
+    return reference / candidate
+
+
+def geomean(values):
+    return math.exp(sum(math.log(value) for value in values) / len(values))
+
+
+def geo_stdev(values):
+    """Geometric standard deviation (population), 1.0 without spread."""
+    mean = sum(math.log(value) for value in values) / len(values)
+    return math.exp(math.sqrt(sum((math.log(value) - mean) ** 2 for value in values) / len(values)))
+
+
+def score(reference, candidate, pattern):
+    """Scored metrics by category, the metrics left out and the scores."""
+    metrics = {}
+    skipped = []
+    for key in sorted(candidate):
+        test, metric = key
+        name = category(test, metric)
+        if name is None or key not in reference or not pattern.search(f'{test}:{metric}'):
+            continue
+        ref, new = results_store.median(reference[key]), results_store.median(candidate[key])
+        if ref <= 0 or new <= 0:
+            skipped.append((name, key, ref, new))
+            continue
+        # by repetition - None where the sample has no ratio
+        reps = [ratio(metric, ref, value) if value > 0 else None for value in candidate[key]]
+        metrics.setdefault(name, []).append((key, ref, new, ratio(metric, ref, new), reps))
+
+    # repetition i scores sample i of every metric - a repetition with a
+    # sample without a ratio is left out as a whole
+    items = [item for name in metrics for item in metrics[name]]
+    num_of_reps = min((len(item[4]) for item in items), default=0)
+    valid_reps = [rep for rep in range(num_of_reps) if all(item[4][rep] is not None for item in items)]
+
+    categories = {}
+    for name, _ in CATEGORIES:
+        if name not in metrics:
+            continue
+        ratios = [item[3] for item in metrics[name]]
+        reps = [geomean([item[4][rep] for item in metrics[name]]) for rep in valid_reps]
+        categories[name] = {'score': geomean(ratios), 'metrics_gsd': geo_stdev(ratios), 'reps': reps}
+
+    overall = None
+    if categories:
+        reps = [geomean([item['reps'][rep] for item in categories.values()]) for rep in range(len(valid_reps))]
+        overall = {'score': geomean([item['score'] for item in categories.values()]), 'reps': reps}
+    return metrics, skipped, categories, overall
+
+
+def format_report(what, metrics, skipped, categories, overall):
+    lines = [what, '']
+    if overall is None:
+        return lines + ['no metric in common - nothing scored']
+
+    def reps_text(reps):
+        if not reps:
+            return ''
+        return f'{min(reps):>8.3f}{max(reps):>8.3f}{geo_stdev(reps):>8.3f}{len(reps):>6}'
+
+    lines.append(f'{"category":<16}{"score":>8}{"metrics":>9}{"gsd":>8}   {"rep min":>8}{"max":>8}{"gsd":>8}{"reps":>6}')
+    for name, item in categories.items():
+        lines.append(f'{name:<16}{item["score"]:>8.3f}{len(metrics[name]):>9}{item["metrics_gsd"]:>8.3f}   '
+                     f'{reps_text(item["reps"])}')
+    lines.append(f'{"overall":<16}{overall["score"]:>8.3f}{"":>17}   {reps_text(overall["reps"])}')
+    lines += ['', 'score - geometric mean of reference/candidate (inverse when more is better), '
+              'larger is better, reference 1.0',
+              'gsd - geometric standard deviation; reps - score of repetition i of every metric', '']
+
+    # per metric - its ratio and its own effect on the overall score
+    width = max(len(f'{key[0]}:{key[1]}') for items in metrics.values() for key, *_ in items) + 2
+    lines.append(f'  {"metric":<{width}}{"reference":>12}{"candidate":>12}{"ratio":>9}{"overall x":>11}')
+    for name in categories:
+        lines.append(name)
+        for key, ref, new, value, _ in metrics[name]:
+            effect = value ** (1.0 / (len(metrics[name]) * len(categories)))
+            lines.append(f'  {key[0] + ":" + key[1]:<{width}}{ref:>12g}{new:>12g}{value:>9.3f}{effect:>11.4f}')
+    if skipped:
+        lines += ['', f'{len(skipped)} metrics not scored - zero median:']
+        lines += [f'  {key[0]}:{key[1]} ({ref:g}, {new:g})' for _, key, ref, new in skipped]
+    return lines
+
+
+def write_csv(path, metrics, categories, overall):
+    with open(path, 'w', newline='') as csv_file:
+        writer = csv.writer(csv_file)
+        writer.writerow(['category', 'test', 'metric', 'reference', 'candidate', 'ratio'])
+        for name in categories:
+            for key, ref, new, value, _ in metrics[name]:
+                writer.writerow([name, key[0], key[1], ref, new, value])
+        for name, item in categories.items():
+            writer.writerow([name, '', 'score', '', '', item['score']])
+        writer.writerow(['overall', '', 'score', '', '', overall['score']])
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Score a result set against a reference platform')
+    parser.add_argument('--store', default=os.path.join(results_store.ROOT, 'results'), help='results store directory')
+    parser.add_argument('reference', help='reference - stored revision (or prefix) or runs directory')
+    parser.add_argument('candidate', help='candidate - stored revision (or prefix) or runs directory')
+    parser.add_argument('--board', help='board of the candidate (default: the only one)')
+    parser.add_argument('--variant', help='variant of the candidate (default: the only one)')
+    parser.add_argument('--ref-board', help='board of the reference (default: the only one)')
+    parser.add_argument('--ref-variant', help='variant of the reference (default: the only one)')
+    parser.add_argument('--metrics', default='.', help='regex of the test:metric names to score')
+    parser.add_argument('--csv', help='write the ratios and scores as CSV')
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    reference = derive_jitter(results_store.read_set(args.store, args.reference))
+    candidate = derive_jitter(results_store.read_set(args.store, args.candidate))
+    ref_board, ref_variant, reference = select(reference, args.ref_board, args.ref_variant, args.reference)
+    board, variant, candidate = select(candidate, args.board, args.variant, args.candidate)
+    reference = scale_counts(reference, ref_board)
+    candidate = scale_counts(candidate, board)
+
+    metrics, skipped, categories, overall = score(reference, candidate, re.compile(args.metrics))
+    what = (f'candidate {args.candidate} {board}/{variant}, '
+            f'reference {args.reference} {ref_board}/{ref_variant}')
+    for name in sorted({ref_board, board} & set(COUNT_SCALE)):
+        what += f'\n{name} cycle counts x {COUNT_SCALE[name]:g} - in instructions'
+    print('\n'.join(format_report(what, metrics, skipped, categories, overall)))
+    if args.csv and overall is not None:
+        write_csv(args.csv, metrics, categories, overall)
+    return 0 if overall is not None else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
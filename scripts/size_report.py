@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+
+# Embench-RT size report
+#
+# Extract the code/data footprint of each benchmark component from the
+# GNU ld (or lld) map file written at link time (-Wl,-Map=...). Only input sections
+# kept in the final ELF are counted, so the numbers reflect the linked
+# image after --gc-sections.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Report .text/.rodata/.data/.bss sizes per benchmark component.
+
+Components are given as NAME=OBJ[,OBJ...]; input sections of objects not
+listed in any component (libc, libgcc, ...) are reported as 'other'.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+SECTION_CLASSES = (
+    ('text', ('.text', '.init', '.fini')),
+    ('rodata', ('.rodata', '.srodata', '.rdata')),
+    ('data', ('.data', '.sdata')),
+    ('bss', ('.bss', '.sbss', 'COMMON', '.scommon')),
+)
+
+COLUMNS = [name for name, _ in SECTION_CLASSES]
+
+INPUT_SECTION = re.compile(r'^ (\S+)\s+0x[0-9a-fA-F]+\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+INPUT_SECTION_NAME = re.compile(r'^ (\S+)$')
+INPUT_SECTION_SIZE = re.compile(r'^\s+0x[0-9a-fA-F]+\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+# lld: VMA LMA Size Align, then object:(section) in the 'In' column
+LLD_HEADER = re.compile(r'^\s+VMA\s+LMA\s+Size\s+Align\s+Out\s+In\s+Symbol')
+LLD_INPUT_SECTION = re.compile(r'^\s*[0-9a-fA-F]+\s+[0-9a-fA-F]+\s+([0-9a-fA-F]+)\s+\d+\s+(\S.*):\(([^)]*)\)$')
+
+
+def classify(section):
+    """Return the size column of an input section, None if not counted."""
+    for name, prefixes in SECTION_CLASSES:
+        for prefix in prefixes:
+            if section == prefix or section.startswith(prefix + '.'):
+                return name
+    return None
+
+
+def parse_lld_map(lines):
+    """Yield (section, size, object) for every input section of an lld map."""
+    for line in lines:
+        match = LLD_INPUT_SECTION.match(line)
+        if match:
+            yield match.group(3), int(match.group(1), 16), match.group(2).strip()
+
+
+def parse_map(path):
+    """Yield (section, size, object) for every input section in the map."""
+    with open(path) as mapfile:
+        lines = mapfile.read().splitlines()
+
+    if lines and LLD_HEADER.match(lines[0]):
+        yield from parse_lld_map(lines[1:])
+        return
+
+    # Discarded sections are listed before the memory map proper
+    try:
+        start = lines.index('Linker script and memory map')
+    except ValueError:
+        start = 0
+
+    pending = None
+    for line in lines[start:]:
+        if pending is not None:
+            match = INPUT_SECTION_SIZE.match(line)
+            if match:
+                yield pending, int(match.group(1), 16), match.group(2).strip()
+            pending = None
+            continue
+        match = INPUT_SECTION.match(line)
+        if match:
+            yield match.group(1), int(match.group(2), 16), match.group(3).strip()
+            continue
+        # Long section names wrap the address/size/object to the next line
+        match = INPUT_SECTION_NAME.match(line)
+        if match:
+            pending = match.group(1)
+
+
+def parse_components(specs):
+    """Map object path (and basename) to component name."""
+    components = []
+    owners = {}
+    for spec in specs:
+        if '=' not in spec:
+            raise ValueError(f'bad component "{spec}", expected NAME=OBJ[,OBJ...]')
+        name, objs = spec.split('=', 1)
+        if name not in components:
+            components.append(name)
+        for obj in objs.split(','):
+            if obj:
+                owners[os.path.normpath(obj)] = name
+                owners[os.path.basename(obj)] = name
+    return components, owners
+
+
+def component_sizes(mapfile, specs):
+    """Return ([component names], {component: {column: bytes}})."""
+    components, owners = parse_components(specs)
+    components.append('other')
+    sizes = {name: dict.fromkeys(COLUMNS, 0) for name in components}
+
+    for section, size, obj in parse_map(mapfile):
+        column = classify(section)
+        if column is None or size == 0:
+            continue
+        owner = owners.get(os.path.normpath(obj), owners.get(os.path.basename(obj), 'other'))
+        sizes[owner][column] += size
+
+    return components, sizes
+
+
+def format_report(components, sizes):
+    """Format the sizes as a fixed-width table with a total row."""
+    rows = [f'{"component":<12}' + ''.join(f'{col:>10}' for col in COLUMNS)]
+    total = dict.fromkeys(COLUMNS, 0)
+    for name in components:
+        rows.append(f'{name:<12}' + ''.join(f'{sizes[name][col]:>10}' for col in COLUMNS))
+        for col in COLUMNS:
+            total[col] += sizes[name][col]
+    rows.append(f'{"total":<12}' + ''.join(f'{total[col]:>10}' for col in COLUMNS))
+    return '\n'.join(rows)
+
+
+def read_report(path):
+    """Read a report written by this script back into {component: {column: bytes}}."""
+    sizes = {}
+    with open(path) as report:
+        header = report.readline().split()
+        for line in report:
+            fields = line.split()
+            if len(fields) == len(header):
+                sizes[fields[0]] = dict(zip(header[1:], (int(field) for field in fields[1:])))
+    return sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Per component footprint from a GNU ld map file')
+    parser.add_argument('--map', required=True, help='linker map file')
+    parser.add_argument('components', nargs='*', help='NAME=OBJ[,OBJ...]')
+    args = parser.parse_args()
+
+    try:
+        components, sizes = component_sizes(args.map, args.components)
+    except (OSError, ValueError) as err:
+        print(f'size_report: {err}', file=sys.stderr)
+        return 1
+
+    print(format_report(components, sizes))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
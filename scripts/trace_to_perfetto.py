@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+
+# Embench-RT kernel trace converter
+#
+# 'make run TRACE=1' dumps the ctx_switch_os trace ring buffer (g_trace) as
+# raw memory; this turns it into Chrome trace event JSON, which opens in
+# chrome://tracing and https://ui.perfetto.dev.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Convert a ctx_switch_os trace dump to Chrome/Perfetto trace JSON.
+
+Per task there are two tracks: '<task>' with the kernel primitives it
+called (nested call/return slices) and '<task> state' with the running
+slices and block/unblock instants. The 'kernel' track holds the
+context_switch entry stub and the 'isr' track the interrupt handlers.
+Task names come from the ELF symbols (--elf) when given. The event
+layout follows the register width - the ELF class when --elf is given,
+--xlen otherwise.
+"""
+
+import argparse
+import bisect
+import json
+import os
+import struct
+import subprocess
+import sys
+
+# context-switch-latency-trace.h
+HEADER = struct.Struct('<4I')
+# timestamp, info, task pointer - rv64 pointers are 8 bytes wide
+EVENTS = {32: struct.Struct('<3I'), 64: struct.Struct('<IIQ')}
+
+SWITCH_OUT, SWITCH_IN, CALL, RETURN, BLOCK, UNBLOCK, ISR_ENTER, ISR_EXIT, PSP_ENTER, PSP_EXIT = range(1, 11)
+
+PRIMITIVES = {
+    1: 'event_get',
+    2: 'event_set',
+    3: 'semaphore_take',
+    4: 'semaphore_give',
+    5: 'queue_receive',
+    6: 'queue_send',
+    7: 'queue_send_batch',
+    8: 'task_yield',
+    9: 'task_create',
+    10: 'task_delete',
+}
+
+PID = 1
+TID_KERNEL = 1
+TID_ISR = 2
+TID_TASKS = 10
+
+
+def elf_xlen(elf):
+    """Register width of an ELF - its class, byte 4 of the identification."""
+    with open(elf, 'rb') as elf_file:
+        ident = elf_file.read(5)
+    return 64 if ident[4] == 2 else 32
+
+
+def read_dump(path, xlen):
+    """Header fields and the events in the order they were written."""
+    with open(path, 'rb') as dump:
+        data = dump.read()
+    event = EVENTS[xlen]
+    index, size, task_cb_size, clock_hz = HEADER.unpack_from(data, 0)
+    events = [event.unpack_from(data, HEADER.size + i * event.size) for i in range(size)]
+    if index > size:
+        start = index % size
+        events = events[start:] + events[:start]
+    else:
+        events = events[:index]
+    return index, size, task_cb_size, clock_hz, events
+
+
+class Symbols:
+    """Data symbols of an ELF, to name task control blocks."""
+
+    def __init__(self, elf, nm, task_cb_size):
+        self.task_cb_size = task_cb_size
+        self.symbols = []
+        if not elf:
+            return
+        output = subprocess.run([nm, '-S', '--defined-only', elf], stdout=subprocess.PIPE,
+                                universal_newlines=True, check=True).stdout
+        for line in output.splitlines():
+            fields = line.split()
+            if len(fields) == 4 and fields[2].lower() in 'bdgs':
+                self.symbols.append((int(fields[0], 16), int(fields[1], 16), fields[3]))
+        self.symbols.sort()
+        self.addresses = [symbol[0] for symbol in self.symbols]
+
+    def name(self, address):
+        if self.symbols:
+            pos = bisect.bisect_right(self.addresses, address) - 1
+            if pos >= 0:
+                start, size, name = self.symbols[pos]
+                offset = address - start
+                if offset < size:
+                    if size > self.task_cb_size and self.task_cb_size:
+                        return f'{name}[{offset // self.task_cb_size}]'
+                    return name
+        return f'task 0x{address:08x}'
+
+
+def convert(events, clock_hz, symbols):
+    """Chrome trace events of the dumped events."""
+    scale = 1e6 / clock_hz
+    out = []
+    tasks = {}
+    running = {}
+    calls = {}
+    open_stub = {}
+
+    def track(task):
+        """(call track, state track) of a task."""
+        if task not in tasks:
+            name = symbols.name(task)
+            tid = TID_TASKS + 2 * len(tasks)
+            tasks[task] = tid
+            out.append({'ph': 'M', 'name': 'thread_name', 'pid': PID, 'tid': tid, 'args': {'name': name}})
+            out.append({'ph': 'M', 'name': 'thread_name', 'pid': PID, 'tid': tid + 1, 'args': {'name': f'{name} state'}})
+            out.append({'ph': 'M', 'name': 'thread_sort_index', 'pid': PID, 'tid': tid, 'args': {'sort_index': tid}})
+            out.append({'ph': 'M', 'name': 'thread_sort_index', 'pid': PID, 'tid': tid + 1, 'args': {'sort_index': tid + 1}})
+        return tasks[task], tasks[task] + 1
+
+    def slice_(name, tid, begin, end, args=None):
+        event = {'ph': 'X', 'name': name, 'pid': PID, 'tid': tid, 'ts': begin * scale, 'dur': (end - begin) * scale}
+        if args:
+            event['args'] = args
+        out.append(event)
+
+    out.append({'ph': 'M', 'name': 'process_name', 'pid': PID, 'args': {'name': 'ctx_switch_os'}})
+    out.append({'ph': 'M', 'name': 'thread_name', 'pid': PID, 'tid': TID_KERNEL, 'args': {'name': 'kernel'}})
+    out.append({'ph': 'M', 'name': 'thread_name', 'pid': PID, 'tid': TID_ISR, 'args': {'name': 'isr'}})
+
+    # unwrap the 32 bit cycle counter
+    base = 0
+    previous = None
+    last = 0
+    for timestamp, info, task in events:
+        if previous is not None and timestamp < previous:
+            base += 1 << 32
+        previous = timestamp
+        now = base + timestamp
+        last = now
+        kind, ident, value = info & 0xFF, (info >> 8) & 0xFF, info >> 16
+        primitive = PRIMITIVES.get(ident, f'primitive {ident}')
+
+        if kind in (PSP_ENTER, ISR_ENTER):
+            open_stub[kind] = (now, value)
+        elif kind in (PSP_EXIT, ISR_EXIT):
+            enter = PSP_ENTER if kind == PSP_EXIT else ISR_ENTER
+            if enter in open_stub:
+                begin, irq = open_stub.pop(enter)
+                if kind == PSP_EXIT:
+                    slice_('context_switch', TID_KERNEL, begin, now)
+                else:
+                    slice_(f'irq {irq}', TID_ISR, begin, now)
+        elif task == 0:
+            continue
+        elif kind == SWITCH_IN:
+            running[task] = now
+        elif kind == SWITCH_OUT:
+            if task in running:
+                slice_('running', track(task)[1], running.pop(task), now)
+        elif kind == CALL:
+            calls.setdefault(task, []).append((ident, now))
+        elif kind == RETURN:
+            stack = calls.get(task, [])
+            if stack and stack[-1][0] == ident:
+                _, begin = stack.pop()
+                slice_(primitive, track(task)[0], begin, now)
+        elif kind in (BLOCK, UNBLOCK):
+            name = f'block in {primitive}' if kind == BLOCK else f'unblock by {primitive}'
+            out.append({'ph': 'i', 'name': name, 'pid': PID, 'tid': track(task)[1], 'ts': now * scale, 's': 't'})
+
+    # still running or inside a call when the trace ends
+    for task, begin in running.items():
+        slice_('running', track(task)[1], begin, last, {'unfinished': True})
+    for task, stack in calls.items():
+        for ident, begin in stack:
+            slice_(PRIMITIVES.get(ident, f'primitive {ident}'), track(task)[0], begin, last, {'unfinished': True})
+    return out, len(tasks)
+
+
+def default_nm():
+    riscv = os.environ.get('RISCV')
+    if riscv:
+        return os.path.join(riscv, 'bin', 'riscv64-unknown-elf-nm')
+    return 'nm'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert a ctx_switch_os trace dump to Chrome/Perfetto JSON')
+    parser.add_argument('dump', help='raw g_trace dump (make run TRACE=1)')
+    parser.add_argument('-o', '--output', help='JSON output (default: dump name with .json)')
+    parser.add_argument('--elf', help='benchmark ELF - task names')
+    parser.add_argument('--nm', default=default_nm(), help='nm of the target toolchain')
+    parser.add_argument('--xlen', type=int, default=32, choices=sorted(EVENTS),
+                        help='register width of the target without --elf')
+    args = parser.parse_args()
+
+    xlen = elf_xlen(args.elf) if args.elf else args.xlen
+    index, size, task_cb_size, clock_hz, events = read_dump(args.dump, xlen)
+    symbols = Symbols(args.elf, args.nm, task_cb_size)
+    trace, num_of_tasks = convert(events, clock_hz, symbols)
+
+    output = args.output or os.path.splitext(args.dump)[0] + '.json'
+    with open(output, 'w') as json_file:
+        json.dump({'traceEvents': trace, 'displayTimeUnit': 'ns',
+                   'otherData': {'core_clock_hz': clock_hz, 'events_written': index, 'buffer_size': size}},
+                  json_file)
+    dropped = max(index - size, 0)
+    print(f'{len(events)} events ({dropped} overwritten), {num_of_tasks} tasks -> {output}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())